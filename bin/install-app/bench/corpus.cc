@@ -0,0 +1,709 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <format>
+#include <print>
+#include <span>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include <archive.h>
+#include <archive_entry.h>
+#include "corpus.hh"
+#include "units.hh"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr uint64_t MiB = 1024 * 1024;
+    constexpr size_t CHUNK = 64 * 1024;
+    constexpr size_t CONTENT_SIZE = 16 * MiB;
+
+    struct EntrySpec
+    {
+        std::string path;
+        mode_t mode = 0644;
+        uint64_t size = 0;
+        bool directory = false;
+        std::string symlink;
+        /* data regions of a sparse file as (offset, length); empty for dense files */
+        std::vector<std::pair<uint64_t, uint64_t>> regions;
+        std::string_view magic;
+        uint64_t seed = 0;
+    };
+
+    constexpr std::string_view ELF_MAGIC("\x7f" "ELF\x02\x01\x01\x00", 8);
+    constexpr std::string_view PNG_MAGIC("\x89PNG\r\n\x1a\n", 8);
+    constexpr std::string_view SVG_MAGIC = "<svg xmlns=\"http://www.w3.org/2000/svg\">\n";
+
+    uint64_t splitmix(uint64_t &state)
+    {
+        auto z = (state += 0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
+
+    /* content every file is cut from: mostly word-like text with a quarter of the 4 KiB pages random,
+     * which compresses at roughly the ratio of a typical application bundle. it is larger than xz's
+     * default dictionary so huge files do not collapse into back-references to their own start */
+    const std::string &content_block()
+    {
+        static const std::string block = [] {
+            constexpr std::array<std::string_view, 16> words = { "install", "archive", "library", "config",
+                "resource", "shared", "object", "symbol", "offset", "section", "version", "locale", "theme",
+                "module", "plugin", "binary" };
+
+            std::string out;
+            out.reserve(CONTENT_SIZE);
+            uint64_t state = 42;
+            while (out.size() < CONTENT_SIZE)
+            {
+                auto page_end = out.size() + 4096;
+                if (splitmix(state) % 4 == 0)
+                {
+                    while (out.size() < page_end)
+                        out += static_cast<char>(splitmix(state));
+                    continue;
+                }
+
+                while (out.size() < page_end)
+                {
+                    auto value = splitmix(state);
+                    out += words[value % words.size()];
+                    out += (value >> 8) % 8 == 0 ? '\n' : ' ';
+                }
+                out.resize(page_end);
+            }
+            out.resize(CONTENT_SIZE);
+            return out;
+        }();
+        return block;
+    }
+
+    uint64_t scaled(uint64_t value, double scale)
+    {
+        return std::max<uint64_t>(1, static_cast<uint64_t>(std::llround(static_cast<double>(value) * scale)));
+    }
+
+    class Planner
+    {
+    public:
+        Planner(std::string_view root, uint64_t seed) :
+            root(root), state(seed)
+        {
+            directory("");
+        }
+
+        void directory(std::string_view path)
+        {
+            entries.push_back({ .path = join(path), .mode = 0755, .directory = true });
+        }
+
+        EntrySpec &file(std::string_view path, uint64_t size, mode_t mode = 0644, std::string_view magic = {})
+        {
+            entries.push_back({ .path = join(path), .mode = mode, .size = size, .magic = magic,
+                    .seed = splitmix(state) });
+            return entries.back();
+        }
+
+        void symlink(std::string_view path, std::string_view target)
+        {
+            entries.push_back({ .path = join(path), .mode = 0777, .symlink = std::string(target) });
+        }
+
+        uint64_t random(uint64_t bound)
+        {
+            return splitmix(state) % bound;
+        }
+
+        std::vector<EntrySpec> entries;
+
+    private:
+        std::string join(std::string_view path) const
+        {
+            return path.empty() ? std::format("{}/", root) : std::format("{}/{}", root, path);
+        }
+
+        std::string root;
+        uint64_t state;
+    };
+
+    std::vector<EntrySpec> plan(CorpusShape shape, double scale)
+    {
+        auto root = std::format("{}-1.0", shape_name(shape));
+        Planner planner(root, static_cast<uint64_t>(shape) + 1);
+
+        switch (shape)
+        {
+            case CorpusShape::TINY:
+            {
+                auto files = scaled(100000, scale);
+                for (uint64_t i = 0; i < files; ++i)
+                {
+                    if (i % 1000 == 0)
+                        planner.directory(std::format("d{:04}", i / 1000));
+                    planner.file(std::format("d{:04}/f{:06}.txt", i / 1000, i), 64 + planner.random(960));
+                }
+                break;
+            }
+            case CorpusShape::HUGE:
+            {
+                planner.directory("bin");
+                planner.file("bin/huge", 4 * MiB, 0755, ELF_MAGIC);
+                planner.directory("data");
+                for (int i = 0; i < 3; ++i)
+                    planner.file(std::format("data/blob-{}.bin", i), scaled(256 * MiB, scale));
+                break;
+            }
+            case CorpusShape::DEEP:
+            {
+                auto branches = scaled(16, scale);
+                for (uint64_t branch = 0; branch < branches; ++branch)
+                {
+                    auto path = std::format("branch-{:02}", branch);
+                    for (int level = 0; level < 64; ++level)
+                    {
+                        path += std::format("/level-{:02}", level);
+                        planner.directory(path);
+                        for (int i = 0; i < 4; ++i)
+                            planner.file(std::format("{}/node-{}.conf", path, i), 512 + planner.random(3584));
+                    }
+                }
+                break;
+            }
+            case CorpusShape::SPARSE:
+            {
+                planner.directory("images");
+                auto files = scaled(8, scale);
+                for (uint64_t i = 0; i < files; ++i)
+                {
+                    auto &spec = planner.file(std::format("images/disk-{}.img", i), 64 * MiB);
+                    for (uint64_t offset = 0; offset < spec.size; offset += 4 * MiB)
+                        spec.regions.emplace_back(offset, 64 * 1024);
+                }
+                break;
+            }
+            case CorpusShape::MIXED:
+            {
+                planner.directory("bin");
+                planner.file("bin/mixed", 8 * MiB, 0755, ELF_MAGIC);
+                for (uint64_t i = 0; i < scaled(8, scale); ++i)
+                    planner.file(std::format("bin/mixed-helper-{}", i), MiB, 0755, ELF_MAGIC);
+                planner.file("bin/mixed.sh", 2048, 0755, "#!/bin/sh\n");
+
+                planner.directory("lib");
+                for (uint64_t i = 0; i < scaled(24, scale); ++i)
+                {
+                    planner.file(std::format("lib/libmixed{}.so.1", i), 2 * MiB, 0755, ELF_MAGIC);
+                    planner.symlink(std::format("lib/libmixed{}.so", i), std::format("libmixed{}.so.1", i));
+                }
+
+                planner.directory("share");
+                planner.directory("share/icons");
+                planner.directory("share/icons/hicolor");
+                for (auto size : { 16, 32, 48, 64, 128, 256, 512 })
+                {
+                    auto dir = std::format("share/icons/hicolor/{0}x{0}", size);
+                    planner.directory(dir);
+                    planner.directory(dir + "/apps");
+                    planner.file(dir + "/apps/mixed.png", static_cast<uint64_t>(size * size) * 4, 0644, PNG_MAGIC);
+                }
+                planner.directory("share/pixmaps");
+                planner.file("share/pixmaps/mixed.svg", 16 * 1024, 0644, SVG_MAGIC);
+
+                planner.directory("resources");
+                for (uint64_t i = 0; i < scaled(200, scale); ++i)
+                    planner.file(std::format("resources/pack-{:03}.dat", i), 64 * 1024);
+                break;
+            }
+        }
+
+        return std::move(planner.entries);
+    }
+
+    std::unexpected<std::string> archive_failure(archive *a, std::string_view what)
+    {
+        auto message = archive_error_string(a);
+        return std::unexpected(std::format("{}: {}", what, message ? message : "unknown error"));
+    }
+
+    std::expected<void, std::string> write_data(archive *a, const EntrySpec &spec)
+    {
+        static const std::string zeros(CHUNK, '\0');
+        const auto &block = content_block();
+        auto position = spec.seed % block.size();
+
+        auto emit = [&](const char *data, size_t size) -> std::expected<void, std::string> {
+            if (archive_write_data(a, data, size) < 0)
+                return archive_failure(a, std::format("Failed to write {}", spec.path));
+            return {};
+        };
+
+        auto emit_content = [&](uint64_t size) -> std::expected<void, std::string> {
+            while (size > 0)
+            {
+                auto length = std::min<uint64_t>({ size, CHUNK, block.size() - position });
+                if (auto written = emit(block.data() + position, length); !written)
+                    return written;
+                position = (position + length) % block.size();
+                size -= length;
+            }
+            return {};
+        };
+
+        auto emit_zeros = [&](uint64_t size) -> std::expected<void, std::string> {
+            while (size > 0)
+            {
+                auto length = std::min<uint64_t>(size, CHUNK);
+                if (auto written = emit(zeros.data(), length); !written)
+                    return written;
+                size -= length;
+            }
+            return {};
+        };
+
+        auto magic = std::min<uint64_t>(spec.magic.size(), spec.size);
+        if (auto written = emit(spec.magic.data(), magic); !written)
+            return written;
+
+        if (spec.regions.empty())
+            return emit_content(spec.size - magic);
+
+        /* writers take the logical contents; tar formats drop the holes again through the sparse map */
+        uint64_t offset = magic;
+        for (auto [start, length] : spec.regions)
+        {
+            if (start + length <= offset)
+                continue;
+            start = std::max(start, offset);
+            if (auto written = emit_zeros(start - offset); !written)
+                return written;
+            if (auto written = emit_content(std::min(length, spec.size - start)); !written)
+                return written;
+            offset = std::min(start + length, spec.size);
+        }
+        return emit_zeros(spec.size - offset);
+    }
+
+    std::expected<void, std::string> write_entries(archive *a, std::span<const EntrySpec> entries,
+            std::string_view prefix, bool sparse)
+    {
+        archive_entry *entry = archive_entry_new();
+        if (!entry)
+            return std::unexpected("Failed to create archive entry");
+
+        for (const auto &spec : entries)
+        {
+            archive_entry_clear(entry);
+            archive_entry_copy_pathname(entry, std::format("{}{}", prefix, spec.path).c_str());
+            archive_entry_set_perm(entry, spec.mode);
+            archive_entry_set_mtime(entry, 1700000000, 0);
+            archive_entry_set_uid(entry, 0);
+            archive_entry_set_gid(entry, 0);
+            archive_entry_set_size(entry, 0);
+
+            if (spec.directory)
+                archive_entry_set_filetype(entry, AE_IFDIR);
+            else if (!spec.symlink.empty())
+            {
+                archive_entry_set_filetype(entry, AE_IFLNK);
+                archive_entry_copy_symlink(entry, spec.symlink.c_str());
+            }
+            else
+            {
+                archive_entry_set_filetype(entry, AE_IFREG);
+                archive_entry_set_size(entry, static_cast<la_int64_t>(spec.size));
+                if (sparse)
+                {
+                    for (auto [offset, length] : spec.regions)
+                        archive_entry_sparse_add_entry(entry, static_cast<la_int64_t>(offset),
+                                static_cast<la_int64_t>(length));
+                }
+            }
+
+            if (archive_write_header(a, entry) < ARCHIVE_WARN)
+            {
+                archive_entry_free(entry);
+                return archive_failure(a, std::format("Failed to write header for {}", spec.path));
+            }
+
+            if (spec.size > 0 && !spec.directory && spec.symlink.empty())
+            {
+                if (auto written = write_data(a, spec); !written)
+                {
+                    archive_entry_free(entry);
+                    return written;
+                }
+            }
+        }
+
+        archive_entry_free(entry);
+        return {};
+    }
+
+    /* tar variants carry sparse maps through pax headers; zip and cpio store sparse files densely */
+    std::expected<void, std::string> write_tar(const fs::path &path, std::span<const EntrySpec> entries,
+            CorpusFormat format, std::string_view prefix = {})
+    {
+        archive *a = archive_write_new();
+        if (!a)
+            return std::unexpected("Failed to create archive writer");
+
+        archive_write_set_format_pax_restricted(a);
+        switch (format)
+        {
+            case CorpusFormat::TAR_GZ:
+                archive_write_add_filter_gzip(a);
+                break;
+            case CorpusFormat::TAR_BZ2:
+                archive_write_add_filter_bzip2(a);
+                break;
+            case CorpusFormat::TAR_XZ:
+                archive_write_add_filter_xz(a);
+                archive_write_set_filter_option(a, "xz", "threads", "0");
+                break;
+            default:
+                break;
+        }
+        archive_write_set_bytes_in_last_block(a, 1);
+
+        std::expected<void, std::string> result;
+        if (archive_write_open_filename(a, path.c_str()) != ARCHIVE_OK)
+            result = archive_failure(a, std::format("Failed to create {}", path.string()));
+        else
+            result = write_entries(a, entries, prefix, true);
+
+        if (archive_write_close(a) != ARCHIVE_OK && result)
+            result = archive_failure(a, std::format("Failed to finish {}", path.string()));
+        archive_write_free(a);
+        return result;
+    }
+
+    std::expected<void, std::string> write_zip(const fs::path &path, std::span<const EntrySpec> entries)
+    {
+        archive *a = archive_write_new();
+        if (!a)
+            return std::unexpected("Failed to create archive writer");
+
+        archive_write_set_format_zip(a);
+
+        std::expected<void, std::string> result;
+        if (archive_write_open_filename(a, path.c_str()) != ARCHIVE_OK)
+            result = archive_failure(a, std::format("Failed to create {}", path.string()));
+        else
+            result = write_entries(a, entries, {}, false);
+
+        if (archive_write_close(a) != ARCHIVE_OK && result)
+            result = archive_failure(a, std::format("Failed to finish {}", path.string()));
+        archive_write_free(a);
+        return result;
+    }
+
+    /* `debian-binary`, `control.tar.gz` and `data.tar.xz` inside an ar archive. the members are built as
+     * temporary files next to the output because ar needs their sizes up front */
+    std::expected<void, std::string> write_deb(const fs::path &path, std::span<const EntrySpec> entries,
+            std::string_view package)
+    {
+        auto control_path = fs::path(path).concat(".control.tmp");
+        auto data_path = fs::path(path).concat(".data.tmp");
+
+        auto control_text = std::format("Package: {}\nVersion: 1.0\nArchitecture: amd64\nMaintainer: bench\n"
+                                        "Description: synthetic benchmark package\n", package);
+
+        auto cleanup = [&] {
+            std::error_code ec;
+            fs::remove(control_path, ec);
+            fs::remove(data_path, ec);
+        };
+
+        /* the control member is tiny and written directly rather than through `write_data` */
+        {
+            archive *a = archive_write_new();
+            archive_write_set_format_pax_restricted(a);
+            archive_write_add_filter_gzip(a);
+            archive_entry *entry = archive_entry_new();
+            bool ok = archive_write_open_filename(a, control_path.c_str()) == ARCHIVE_OK;
+
+            archive_entry_set_pathname(entry, "./");
+            archive_entry_set_filetype(entry, AE_IFDIR);
+            archive_entry_set_perm(entry, 0755);
+            ok = ok && archive_write_header(a, entry) == ARCHIVE_OK;
+
+            archive_entry_clear(entry);
+            archive_entry_set_pathname(entry, "./control");
+            archive_entry_set_filetype(entry, AE_IFREG);
+            archive_entry_set_perm(entry, 0644);
+            archive_entry_set_size(entry, static_cast<la_int64_t>(control_text.size()));
+            ok = ok && archive_write_header(a, entry) == ARCHIVE_OK;
+            ok = ok && archive_write_data(a, control_text.data(), control_text.size()) >= 0;
+            ok = archive_write_close(a) == ARCHIVE_OK && ok;
+
+            archive_entry_free(entry);
+            if (!ok)
+            {
+                auto failure = archive_failure(a, "Failed to write control.tar.gz");
+                archive_write_free(a);
+                cleanup();
+                return failure;
+            }
+            archive_write_free(a);
+        }
+
+        if (auto written = write_tar(data_path, entries, CorpusFormat::TAR_XZ, "./"); !written)
+        {
+            cleanup();
+            return written;
+        }
+
+        archive *a = archive_write_new();
+        archive_write_set_format_ar_bsd(a);
+
+        std::expected<void, std::string> result;
+        if (archive_write_open_filename(a, path.c_str()) != ARCHIVE_OK)
+            result = archive_failure(a, std::format("Failed to create {}", path.string()));
+
+        archive_entry *entry = archive_entry_new();
+        std::vector<char> buffer(CHUNK);
+        auto add_member = [&](std::string_view name, const fs::path &source, std::string_view inline_data) {
+            if (!result)
+                return;
+
+            std::error_code ec;
+            auto size = source.empty() ? inline_data.size() : fs::file_size(source, ec);
+            archive_entry_clear(entry);
+            archive_entry_copy_pathname(entry, std::string(name).c_str());
+            archive_entry_set_filetype(entry, AE_IFREG);
+            archive_entry_set_perm(entry, 0644);
+            archive_entry_set_mtime(entry, 1700000000, 0);
+            archive_entry_set_size(entry, static_cast<la_int64_t>(size));
+            if (ec || archive_write_header(a, entry) != ARCHIVE_OK)
+            {
+                result = archive_failure(a, std::format("Failed to add {}", name));
+                return;
+            }
+
+            if (source.empty())
+            {
+                archive_write_data(a, inline_data.data(), inline_data.size());
+                return;
+            }
+
+            int fd = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+            ssize_t n = 0;
+            while (fd >= 0 && (n = read(fd, buffer.data(), buffer.size())) > 0)
+                archive_write_data(a, buffer.data(), static_cast<size_t>(n));
+            if (fd < 0 || n < 0)
+                result = std::unexpected(std::format("Failed to read {}", source.string()));
+            if (fd >= 0)
+                close(fd);
+        };
+
+        add_member("debian-binary", {}, "2.0\n");
+        add_member("control.tar.gz", control_path, {});
+        add_member("data.tar.xz", data_path, {});
+
+        archive_entry_free(entry);
+        if (archive_write_close(a) != ARCHIVE_OK && result)
+            result = archive_failure(a, std::format("Failed to finish {}", path.string()));
+        archive_write_free(a);
+        cleanup();
+        return result;
+    }
+
+    void put_be16(std::string &out, uint16_t value)
+    {
+        out += static_cast<char>(value >> 8);
+        out += static_cast<char>(value);
+    }
+
+    void put_be32(std::string &out, uint32_t value)
+    {
+        put_be16(out, static_cast<uint16_t>(value >> 16));
+        put_be16(out, static_cast<uint16_t>(value));
+    }
+
+    /* lead, an empty signature header and an empty main header followed by a gzip cpio payload. that is
+     * as much of the rpm container as extraction looks at */
+    std::expected<void, std::string> write_rpm(const fs::path &path, std::span<const EntrySpec> entries,
+            std::string_view package)
+    {
+        std::string header;
+        header += "\xed\xab\xee\xdb";
+        header += '\x03';
+        header += '\x00';
+        put_be16(header, 0);
+        put_be16(header, 1);
+        auto name = std::format("{}-1.0", package).substr(0, 65);
+        header += name;
+        header.append(66 - name.size(), '\0');
+        put_be16(header, 1);
+        put_be16(header, 5);
+        header.append(16, '\0');
+
+        for (int i = 0; i < 2; ++i)
+        {
+            header += "\x8e\xad\xe8\x01";
+            put_be32(header, 0);
+            put_be32(header, 0);
+            put_be32(header, 0);
+        }
+
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return std::unexpected(std::format("Failed to create {}", path.string()));
+        if (write(fd, header.data(), header.size()) != static_cast<ssize_t>(header.size()))
+        {
+            close(fd);
+            return std::unexpected(std::format("Failed to write {}", path.string()));
+        }
+
+        archive *a = archive_write_new();
+        archive_write_set_format_cpio_newc(a);
+        archive_write_add_filter_gzip(a);
+
+        std::expected<void, std::string> result;
+        if (archive_write_open_fd(a, fd) != ARCHIVE_OK)
+            result = archive_failure(a, std::format("Failed to create {}", path.string()));
+        else
+            result = write_entries(a, entries, "./", false);
+
+        if (archive_write_close(a) != ARCHIVE_OK && result)
+            result = archive_failure(a, std::format("Failed to finish {}", path.string()));
+        archive_write_free(a);
+        close(fd);
+        return result;
+    }
+
+    std::expected<void, std::string> write_archive(const fs::path &path, std::span<const EntrySpec> entries,
+            CorpusFormat format, std::string_view package)
+    {
+        switch (format)
+        {
+            case CorpusFormat::TAR:
+            case CorpusFormat::TAR_GZ:
+            case CorpusFormat::TAR_BZ2:
+            case CorpusFormat::TAR_XZ:
+                return write_tar(path, entries, format);
+            case CorpusFormat::ZIP:
+                return write_zip(path, entries);
+            case CorpusFormat::DEB:
+                return write_deb(path, entries, package);
+            case CorpusFormat::RPM:
+                return write_rpm(path, entries, package);
+        }
+        return std::unexpected("Unknown format");
+    }
+}
+
+std::string_view shape_name(CorpusShape shape)
+{
+    switch (shape)
+    {
+        case CorpusShape::TINY:
+            return "tiny";
+        case CorpusShape::HUGE:
+            return "huge";
+        case CorpusShape::DEEP:
+            return "deep";
+        case CorpusShape::SPARSE:
+            return "sparse";
+        case CorpusShape::MIXED:
+            return "mixed";
+    }
+    return "unknown";
+}
+
+std::string_view corpus_format_name(CorpusFormat format)
+{
+    switch (format)
+    {
+        case CorpusFormat::TAR:
+            return "tar";
+        case CorpusFormat::TAR_GZ:
+            return "tar.gz";
+        case CorpusFormat::TAR_BZ2:
+            return "tar.bz2";
+        case CorpusFormat::TAR_XZ:
+            return "tar.xz";
+        case CorpusFormat::ZIP:
+            return "zip";
+        case CorpusFormat::DEB:
+            return "deb";
+        case CorpusFormat::RPM:
+            return "rpm";
+    }
+    return "unknown";
+}
+
+std::string_view corpus_format_extension(CorpusFormat format)
+{
+    return corpus_format_name(format);
+}
+
+std::expected<CorpusShape, std::string> parse_shape(std::string_view name)
+{
+    for (auto shape : { CorpusShape::TINY, CorpusShape::HUGE, CorpusShape::DEEP, CorpusShape::SPARSE,
+             CorpusShape::MIXED })
+    {
+        if (shape_name(shape) == name)
+            return shape;
+    }
+    return std::unexpected(std::format("Unknown shape: {}", name));
+}
+
+std::expected<CorpusFormat, std::string> parse_corpus_format(std::string_view name)
+{
+    for (auto format : { CorpusFormat::TAR, CorpusFormat::TAR_GZ, CorpusFormat::TAR_BZ2, CorpusFormat::TAR_XZ,
+             CorpusFormat::ZIP, CorpusFormat::DEB, CorpusFormat::RPM })
+    {
+        if (corpus_format_name(format) == name)
+            return format;
+    }
+    return std::unexpected(std::format("Unknown format: {}", name));
+}
+
+std::expected<std::vector<fs::path>, std::string> generate_corpus(const CorpusOptions &options)
+{
+    std::error_code ec;
+    fs::create_directories(options.out_dir, ec);
+    if (ec)
+        return std::unexpected(std::format("Failed to create {}: {}", options.out_dir.string(), ec.message()));
+
+    std::vector<fs::path> archives;
+    for (auto shape : options.shapes)
+    {
+        auto entries = plan(shape, options.scale);
+        uint64_t bytes = 0;
+        for (const auto &entry : entries)
+            bytes += entry.size;
+
+        for (auto format : options.formats)
+        {
+            auto path = options.out_dir / std::format("{}-1.0.{}", shape_name(shape), corpus_format_extension(format));
+            /* archives appear under their final name only once complete, so an interrupted run is never
+             * mistaken for a corpus entry */
+            auto partial = fs::path(path).concat(".partial");
+
+            if (auto written = write_archive(partial, entries, format, shape_name(shape)); !written)
+            {
+                fs::remove(partial, ec);
+                return std::unexpected(written.error());
+            }
+
+            fs::rename(partial, path, ec);
+            if (ec)
+                return std::unexpected(std::format("Failed to rename {}: {}", partial.string(), ec.message()));
+
+            std::println("{:<22} {:>8} entries {:>11} -> {:>11}", path.filename().string(), entries.size(),
+                    human_bytes(bytes), human_bytes(fs::file_size(path, ec)));
+            archives.push_back(std::move(path));
+        }
+    }
+
+    return archives;
+}
@@ -0,0 +1,51 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* archive shapes that stress different parts of the installer */
+enum class CorpusShape
+{
+    TINY,
+    HUGE,
+    DEEP,
+    SPARSE,
+    MIXED
+};
+
+/* one value per `ArchiveFormat` the installer understands */
+enum class CorpusFormat
+{
+    TAR,
+    TAR_GZ,
+    TAR_BZ2,
+    TAR_XZ,
+    ZIP,
+    DEB,
+    RPM
+};
+
+struct CorpusOptions
+{
+    std::filesystem::path out_dir = "corpus";
+    /* multiplies every file count and size, so `0.01` gives a corpus that builds in seconds */
+    double scale = 1.0;
+    std::vector<CorpusShape> shapes;
+    std::vector<CorpusFormat> formats;
+};
+
+std::string_view shape_name(CorpusShape shape);
+std::string_view corpus_format_name(CorpusFormat format);
+std::string_view corpus_format_extension(CorpusFormat format);
+std::expected<CorpusShape, std::string> parse_shape(std::string_view name);
+std::expected<CorpusFormat, std::string> parse_corpus_format(std::string_view name);
+
+/* writes `<shape>-1.0.<ext>` for every shape and format combination and returns the archive paths.
+ * contents are generated from a fixed seed, so the same options always give the same archives */
+std::expected<std::vector<std::filesystem::path>, std::string> generate_corpus(const CorpusOptions &options);
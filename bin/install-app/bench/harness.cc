@@ -0,0 +1,490 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <optional>
+#include <print>
+#include <sstream>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include "harness.hh"
+#include "json.hh"
+#include "process.hh"
+#include "scratch.hh"
+#include "units.hh"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr std::string_view ARCHIVE_SUFFIXES[] = { ".tar", ".tar.gz", ".tgz", ".tar.bz2", ".tar.xz", ".zip",
+        ".deb", ".rpm" };
+
+    struct Sample
+    {
+        double wall_seconds = 0;
+        std::string format;
+        uint64_t bytes = 0;
+        uint64_t files = 0;
+        std::map<std::string, double> phases;
+        uint64_t allocations = 0;
+        std::map<std::string, uint64_t> phase_allocations;
+    };
+
+    bool is_archive(const fs::path &path)
+    {
+        auto name = path.filename().string();
+        return std::ranges::any_of(ARCHIVE_SUFFIXES, [&](std::string_view suffix) { return name.ends_with(suffix); });
+    }
+
+    void clear_directory(const fs::path &path)
+    {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+        fs::create_directories(path, ec);
+    }
+
+    std::optional<JsonValue> read_json(const fs::path &path)
+    {
+        std::ifstream file(path);
+        if (!file)
+            return std::nullopt;
+
+        std::stringstream text;
+        text << file.rdbuf();
+        return json_parse(text.str());
+    }
+
+    std::expected<Sample, std::string> install_once(const BenchOptions &options, const fs::path &archive,
+            const fs::path &root, const fs::path &report)
+    {
+        auto wall = run_command({ options.install_app.string(), "-f", "--no-link", "--no-history", "--no-progress",
+                "-d", (root / "opt").string(), "-b", (root / "bin").string(), "--timings-json", report.string(),
+                "--mem-stats", archive.string() });
+        if (!wall)
+            return std::unexpected(wall.error());
+
+        auto doc = read_json(report);
+        if (!doc)
+            return std::unexpected(std::format("Failed to parse {}", report.string()));
+
+        Sample sample{ .wall_seconds = *wall };
+        if (auto value = doc->find("format"))
+            sample.format = value->string();
+        if (auto value = doc->find("bytes"))
+            sample.bytes = static_cast<uint64_t>(value->number());
+        if (auto value = doc->find("files"))
+            sample.files = static_cast<uint64_t>(value->number());
+
+        auto timings = doc->find("timings");
+        auto phases = timings ? timings->find("phases") : nullptr;
+        if (phases && phases->array())
+        {
+            for (const auto &phase : *phases->array())
+            {
+                auto name = phase.find("name");
+                auto wall_ms = phase.find("wall_ms");
+                if (name && wall_ms)
+                    sample.phases[std::string(name->string())] += wall_ms->number() / 1000.0;
+                auto allocations = phase.find("allocations");
+                if (name && allocations)
+                    sample.phase_allocations[std::string(name->string())] += static_cast<uint64_t>(allocations->number());
+            }
+        }
+        auto total = timings ? timings->find("total") : nullptr;
+        if (auto allocations = total ? total->find("allocations") : nullptr)
+            sample.allocations = static_cast<uint64_t>(allocations->number());
+
+        return sample;
+    }
+
+    std::expected<Sample, std::string> extract_once(std::string_view tool, const fs::path &archive,
+            const fs::path &root)
+    {
+        std::vector<std::string> argv;
+        if (tool == "unzip")
+            argv = { "unzip", "-q", "-o", archive.string(), "-d", root.string() };
+        else
+            argv = { std::string(tool), "-xf", archive.string(), "-C", root.string() };
+
+        auto wall = run_command(argv);
+        if (!wall)
+            return std::unexpected(wall.error());
+        return Sample{ .wall_seconds = *wall };
+    }
+
+    /* runs `once` with the page cache in the requested state and returns the timed samples. every run
+     * starts from an empty output directory on a filesystem with no writeback pending */
+    template<typename Run>
+    std::expected<std::vector<Sample>, std::string> sample_runs(const BenchOptions &options, CacheState cache,
+            const fs::path &archive, const fs::path &root, Run once)
+    {
+        std::vector<Sample> samples;
+        int total = options.runs + (cache == CacheState::WARM ? 1 : 0);
+
+        for (int run = 0; run < total; ++run)
+        {
+            clear_directory(root);
+            sync_filesystem(root);
+            if (cache == CacheState::COLD)
+                evict_file(archive);
+
+            auto sample = once();
+            if (!sample)
+                return std::unexpected(sample.error());
+
+            if (cache == CacheState::COLD)
+                evict_tree(root);
+            clear_directory(root);
+
+            /* the first warm run only primes the cache */
+            if (cache == CacheState::WARM && run == 0)
+                continue;
+            samples.push_back(std::move(*sample));
+        }
+
+        return samples;
+    }
+
+    template<typename T>
+    T median(std::vector<T> values)
+    {
+        if (values.empty())
+            return 0;
+        std::ranges::sort(values);
+        auto mid = values.size() / 2;
+        return values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+    }
+
+    std::string result_key(std::string_view archive, std::string_view filesystem, std::string_view cache)
+    {
+        return std::format("{} {} {}", archive, filesystem, cache);
+    }
+
+    class TempDirOverride
+    {
+    public:
+        explicit TempDirOverride(const fs::path &path)
+        {
+            if (auto current = std::getenv("TMPDIR"))
+                saved = current;
+            setenv("TMPDIR", path.c_str(), 1);
+        }
+
+        TempDirOverride(const TempDirOverride &) = delete;
+        TempDirOverride &operator=(const TempDirOverride &) = delete;
+
+        ~TempDirOverride()
+        {
+            if (saved)
+                setenv("TMPDIR", saved->c_str(), 1);
+            else
+                unsetenv("TMPDIR");
+        }
+
+    private:
+        std::optional<std::string> saved;
+    };
+}
+
+double BenchResult::mb_per_second() const
+{
+    return wall_seconds > 0 ? static_cast<double>(bytes) / wall_seconds / 1e6 : 0;
+}
+
+double BenchResult::files_per_second() const
+{
+    return wall_seconds > 0 ? static_cast<double>(files) / wall_seconds : 0;
+}
+
+std::string_view cache_name(CacheState cache)
+{
+    return cache == CacheState::COLD ? "cold" : "warm";
+}
+
+std::expected<CacheState, std::string> parse_cache(std::string_view name)
+{
+    if (name == "cold")
+        return CacheState::COLD;
+    if (name == "warm")
+        return CacheState::WARM;
+    return std::unexpected(std::format("Unknown cache state: {}", name));
+}
+
+std::expected<std::vector<BenchResult>, std::string> run_benchmarks(const BenchOptions &options)
+{
+    std::error_code ec;
+    std::vector<fs::path> archives;
+    for (const auto &entry : fs::directory_iterator(options.corpus_dir, ec))
+    {
+        if (entry.is_regular_file() && is_archive(entry.path()))
+            archives.push_back(entry.path());
+    }
+    if (ec)
+        return std::unexpected(std::format("Failed to read {}: {}", options.corpus_dir.string(), ec.message()));
+    if (archives.empty())
+        return std::unexpected(std::format("No archives in {}; run `generate` first", options.corpus_dir.string()));
+    std::ranges::sort(archives);
+
+    auto work = options.work_dir;
+    bool owned = work.empty();
+    if (owned)
+    {
+        auto pattern = (fs::temp_directory_path() / "install-app-bench.XXXXXX").string();
+        if (!mkdtemp(pattern.data()))
+            return std::unexpected(std::format("Failed to create a work directory: {}", std::strerror(errno)));
+        work = pattern;
+    }
+
+    std::vector<ScratchFilesystem> filesystems;
+    for (const auto &kind : options.filesystems)
+    {
+        auto scratch = ScratchFilesystem::create(kind, work, options.filesystem_size);
+        if (scratch)
+            filesystems.push_back(std::move(*scratch));
+        else
+            std::println(stderr, "{}: skipped: {}", kind, scratch.error());
+    }
+    if (filesystems.empty())
+        filesystems.push_back(*ScratchFilesystem::create("work", work, 0));
+
+    std::vector<std::string> tools;
+    if (options.baselines)
+    {
+        for (auto tool : { "bsdtar", "unzip" })
+        {
+            if (find_program(tool))
+                tools.emplace_back(tool);
+        }
+    }
+
+    std::vector<BenchResult> results;
+    std::optional<std::string> failure;
+    for (const auto &scratch : filesystems)
+    {
+        auto root = scratch.root() / "install";
+        auto temp = scratch.root() / "tmp";
+        auto report = work / "timings.json";
+        fs::create_directories(temp, ec);
+        TempDirOverride temp_override(temp);
+
+        for (const auto &archive : archives)
+        {
+            for (auto cache : options.caches)
+            {
+                BenchResult result{ .archive = archive.filename().string(), .filesystem = scratch.kind(),
+                    .cache = cache, .archive_bytes = fs::file_size(archive, ec) };
+                std::println(stderr, "{} on {}, {} cache", result.archive, result.filesystem, cache_name(cache));
+
+                auto samples = sample_runs(options, cache, archive, root,
+                        [&] { return install_once(options, archive, root, report); });
+                if (!samples)
+                {
+                    failure = std::format("{}: {}", result.archive, samples.error());
+                    break;
+                }
+
+                std::vector<double> walls;
+                std::map<std::string, std::vector<double>> phases;
+                std::vector<uint64_t> allocations;
+                std::map<std::string, std::vector<uint64_t>> phase_allocations;
+                for (const auto &sample : *samples)
+                {
+                    result.format = sample.format;
+                    result.bytes = sample.bytes;
+                    result.files = sample.files;
+                    walls.push_back(sample.wall_seconds);
+                    for (const auto &[name, seconds] : sample.phases)
+                        phases[name].push_back(seconds);
+                    allocations.push_back(sample.allocations);
+                    for (const auto &[name, count] : sample.phase_allocations)
+                        phase_allocations[name].push_back(count);
+                }
+
+                result.wall_seconds = median(std::move(walls));
+                for (auto &[name, seconds] : phases)
+                    result.phases[name] = median(std::move(seconds));
+                result.allocations = median(std::move(allocations));
+                for (auto &[name, counts] : phase_allocations)
+                    result.phase_allocations[name] = median(std::move(counts));
+
+                for (const auto &tool : tools)
+                {
+                    /* unzip only reads zip, and bsdtar on a zip is already covered by unzip's number */
+                    if ((tool == "unzip") != (result.format == "zip"))
+                        continue;
+
+                    auto reference = sample_runs(options, cache, archive, root,
+                            [&] { return extract_once(tool, archive, root); });
+                    if (!reference)
+                    {
+                        std::println(stderr, "{}: {} baseline skipped: {}", result.archive, tool, reference.error());
+                        continue;
+                    }
+
+                    std::vector<double> times;
+                    for (const auto &sample : *reference)
+                        times.push_back(sample.wall_seconds);
+                    result.baselines[tool] = median(std::move(times));
+                }
+
+                results.push_back(std::move(result));
+            }
+            if (failure)
+                break;
+        }
+
+        fs::remove_all(temp, ec);
+        if (failure)
+            break;
+    }
+
+    /* unmount before removing the work directory the mountpoints live in */
+    filesystems.clear();
+    if (owned)
+        fs::remove_all(work, ec);
+    if (failure)
+        return std::unexpected(*failure);
+    return results;
+}
+
+void print_results(std::span<const BenchResult> results)
+{
+    std::println("{:<22} {:<6} {:<5} {:>10} {:>10} {:>9} {:>9} {:>11} {:>9} {:>9} {:>10} {:>9}", "archive", "fs",
+            "cache", "size", "unpacked", "wall s", "MB/s", "files/s", "extract", "copy", "allocs", "baseline");
+
+    for (const auto &result : results)
+    {
+        auto phase = [&](std::string_view name) {
+            auto it = result.phases.find(std::string(name));
+            return it == result.phases.end() ? 0.0 : it->second;
+        };
+
+        std::string baseline = "-";
+        if (!result.baselines.empty())
+        {
+            const auto &[tool, seconds] = *result.baselines.begin();
+            baseline = std::format("{:.2f}x", result.wall_seconds / seconds);
+        }
+
+        std::println("{:<22} {:<6} {:<5} {:>10} {:>10} {:>9.3f} {:>9.1f} {:>11.0f} {:>9.3f} {:>9.3f} {:>10} {:>9}",
+                result.archive, result.filesystem, cache_name(result.cache), human_bytes(result.archive_bytes),
+                human_bytes(result.bytes), result.wall_seconds, result.mb_per_second(), result.files_per_second(),
+                phase("extract"), phase("copy"), result.allocations, baseline);
+    }
+
+    std::println("\n(baseline is install-app wall time relative to bsdtar, or unzip for zip archives)");
+}
+
+std::string results_json(std::span<const BenchResult> results, const BenchOptions &options)
+{
+    auto object = [](const std::map<std::string, double> &values) {
+        std::string out = "{";
+        for (const auto &[name, seconds] : values)
+            out += std::format("{}\"{}\":{:.6f}", out.size() > 1 ? "," : "", json_escape(name), seconds);
+        return out + "}";
+    };
+    auto counts = [](const std::map<std::string, uint64_t> &values) {
+        std::string out = "{";
+        for (const auto &[name, count] : values)
+            out += std::format("{}\"{}\":{}", out.size() > 1 ? "," : "", json_escape(name), count);
+        return out + "}";
+    };
+
+    auto out = std::format("{{\"runs\":{},\"results\":[", options.runs);
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const auto &result = results[i];
+        out += std::format("{}\n{{\"archive\":\"{}\",\"format\":\"{}\",\"filesystem\":\"{}\",\"cache\":\"{}\","
+                           "\"archive_bytes\":{},\"bytes\":{},\"files\":{},\"wall_seconds\":{:.6f},"
+                           "\"mb_per_second\":{:.3f},\"files_per_second\":{:.3f},\"phases\":{},\"allocations\":{},"
+                           "\"phase_allocations\":{},\"baselines\":{}}}",
+                i ? "," : "", json_escape(result.archive), json_escape(result.format), json_escape(result.filesystem),
+                cache_name(result.cache), result.archive_bytes, result.bytes, result.files, result.wall_seconds,
+                result.mb_per_second(), result.files_per_second(), object(result.phases), result.allocations,
+                counts(result.phase_allocations), object(result.baselines));
+    }
+    return out + "\n]}\n";
+}
+
+std::expected<size_t, std::string> check_regressions(std::span<const BenchResult> results, const fs::path &baseline,
+        double tolerance)
+{
+    auto doc = read_json(baseline);
+    auto stored = doc ? doc->find("results") : nullptr;
+    if (!stored || !stored->array())
+        return std::unexpected(std::format("Failed to read baseline {}", baseline.string()));
+
+    std::map<std::string, double> expected;
+    std::map<std::string, std::map<std::string, uint64_t>> expected_allocations;
+    for (const auto &entry : *stored->array())
+    {
+        auto field = [&](std::string_view key) {
+            auto value = entry.find(key);
+            return value ? value->string() : std::string_view();
+        };
+        auto key = result_key(field("archive"), field("filesystem"), field("cache"));
+        auto wall = entry.find("wall_seconds");
+        if (wall)
+            expected[key] = wall->number();
+        /* baselines recorded before allocations were counted have none, and are compared on time alone */
+        auto phases = entry.find("phase_allocations");
+        if (phases && phases->object())
+        {
+            for (const auto &[name, count] : *phases->object())
+                expected_allocations[key][name] = static_cast<uint64_t>(count.number());
+        }
+    }
+
+    /* a couple of milliseconds is process start-up jitter, not a regression, however small the archive */
+    constexpr double NOISE_SECONDS = 0.002;
+    /* nor are a few hundred allocations, which the C library and thread start-up vary by; a new one
+     * per entry in the extract loop is one per file of the archive, far more */
+    constexpr uint64_t NOISE_ALLOCATIONS = 256;
+
+    size_t compared = 0;
+    size_t regressions = 0;
+    for (const auto &result : results)
+    {
+        auto it = expected.find(result_key(result.archive, result.filesystem, cache_name(result.cache)));
+        if (it == expected.end() || it->second <= 0)
+            continue;
+
+        compared++;
+        auto ratio = result.wall_seconds / it->second;
+        if (ratio > 1 + tolerance && result.wall_seconds - it->second > NOISE_SECONDS)
+        {
+            regressions++;
+            std::println("REGRESSION {} on {}, {} cache: {:.3f}s against {:.3f}s (+{:.1f}%)", result.archive,
+                    result.filesystem, cache_name(result.cache), result.wall_seconds, it->second, (ratio - 1) * 100);
+        }
+
+        auto stored_allocations = expected_allocations.find(it->first);
+        if (stored_allocations == expected_allocations.end())
+            continue;
+        for (const auto &[name, count] : result.phase_allocations)
+        {
+            auto before = stored_allocations->second.find(name);
+            if (before == stored_allocations->second.end())
+                continue;
+            auto limit = static_cast<double>(before->second) * (1 + tolerance);
+            if (static_cast<double>(count) > limit && count > before->second + NOISE_ALLOCATIONS)
+            {
+                regressions++;
+                std::println("REGRESSION {} on {}, {} cache: {} phase made {} allocations against {} (+{})",
+                        result.archive, result.filesystem, cache_name(result.cache), name, count, before->second,
+                        count - before->second);
+            }
+        }
+    }
+
+    std::println("{} of {} results compared against {} are more than {:.0f}% slower or allocate more",
+            regressions, compared, baseline.string(), tolerance * 100);
+    return regressions;
+}
@@ -0,0 +1,73 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* cold runs drop the archive from the page cache and write back and evict the previous run's output
+ * first; warm runs follow an untimed run that leaves the archive cached */
+enum class CacheState
+{
+    COLD,
+    WARM
+};
+
+struct BenchOptions
+{
+    std::filesystem::path corpus_dir = "corpus";
+    std::filesystem::path install_app = "install-app";
+    /* scratch space for installs and filesystem images; a fresh directory under the system temp dir when
+     * empty */
+    std::filesystem::path work_dir;
+    int runs = 3;
+    bool baselines = true;
+    std::vector<CacheState> caches = { CacheState::COLD, CacheState::WARM };
+    /* `tmpfs`, `ext4` and `btrfs` are mounted under the work directory when possible and skipped
+     * otherwise; `work` installs into the work directory itself and is the fallback if none mount */
+    std::vector<std::string> filesystems = { "tmpfs", "ext4", "btrfs" };
+    uint64_t filesystem_size = 8ull << 30;
+};
+
+/* medians over the runs of one archive on one filesystem and cache state */
+struct BenchResult
+{
+    std::string archive;
+    std::string format;
+    std::string filesystem;
+    CacheState cache = CacheState::WARM;
+    uint64_t archive_bytes = 0;
+    uint64_t bytes = 0;
+    uint64_t files = 0;
+    double wall_seconds = 0;
+    std::map<std::string, double> phases;
+    /* heap allocations of the whole install and of each phase, from `--mem-stats` */
+    uint64_t allocations = 0;
+    std::map<std::string, uint64_t> phase_allocations;
+    /* tool name (`bsdtar`, `unzip`) to the seconds it took to extract the same archive */
+    std::map<std::string, double> baselines;
+
+    double mb_per_second() const;
+    double files_per_second() const;
+};
+
+std::string_view cache_name(CacheState cache);
+std::expected<CacheState, std::string> parse_cache(std::string_view name);
+
+/* installs every archive in the corpus end-to-end with `install-app` and, when available, extracts it
+ * with the reference tools for comparison */
+std::expected<std::vector<BenchResult>, std::string> run_benchmarks(const BenchOptions &options);
+void print_results(std::span<const BenchResult> results);
+std::string results_json(std::span<const BenchResult> results, const BenchOptions &options);
+
+/* compares against a `results_json` file and prints every result whose wall time, or the allocation
+ * count of any of its phases, is more than `tolerance` (a fraction) over the stored one. returns the
+ * number of regressions */
+std::expected<size_t, std::string> check_regressions(std::span<const BenchResult> results,
+        const std::filesystem::path &baseline, double tolerance);
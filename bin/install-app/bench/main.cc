@@ -0,0 +1,284 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <charconv>
+#include <cstdlib>
+#include <fstream>
+#include <print>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <unistd.h>
+#include "corpus.hh"
+#include "harness.hh"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    void print_usage(std::string_view program_name)
+    {
+        std::println("Usage: {} <command> [OPTIONS]\n", program_name);
+        std::println("Commands:");
+        std::println("    generate               Write the synthetic archive corpus");
+        std::println("    run                    Install every corpus archive and report throughput\n");
+        std::println("Generate options:");
+        std::println("    -o, --out <dir>        Corpus directory. Default: corpus");
+        std::println("    --scale <factor>       Multiply file counts and sizes. Default: 1.0");
+        std::println("    --shapes <list>        Comma separated subset of tiny,huge,deep,sparse,mixed");
+        std::println("    --formats <list>       Comma separated subset of tar,tar.gz,tar.bz2,tar.xz,zip,deb,rpm\n");
+        std::println("Run options:");
+        std::println("    -c, --corpus <dir>     Corpus directory. Default: corpus");
+        std::println("    --install-app <path>   install-app binary. Default: next to this program, then PATH");
+        std::println("    --work <dir>           Scratch directory for installs. Default: a temporary directory");
+        std::println("    --runs <n>             Runs per archive; medians are reported. Default: 3");
+        std::println("    --no-baselines         Don't compare against bsdtar and unzip");
+        std::println("    --cache <list>         Comma separated subset of cold,warm. Default: cold,warm");
+        std::println("    --filesystems <list>   Comma separated subset of tmpfs,ext4,btrfs,work. Default: tmpfs,ext4,btrfs");
+        std::println("    --fs-size <MiB>        Size of the tmpfs and loop images. Default: 8192");
+        std::println("    --json <path>          Write the results as JSON, e.g. a new file under bench/baselines");
+        std::println("    --check <path>         Fail if any result is slower or allocates more than this stored JSON baseline");
+        std::println("    --tolerance <percent>  Slowdown and allocation growth allowed by --check. Default: 5");
+    }
+
+    std::vector<std::string_view> split(std::string_view list)
+    {
+        std::vector<std::string_view> items;
+        while (!list.empty())
+        {
+            auto end = list.find(',');
+            items.push_back(list.substr(0, end));
+            if (end == std::string_view::npos)
+                break;
+            list.remove_prefix(end + 1);
+        }
+        return items;
+    }
+
+    /* exit status ctest treats as a skipped test */
+    constexpr int EXIT_SKIPPED = 77;
+
+    template<typename T>
+    bool parse_number(std::string_view value, T &out)
+    {
+        auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), out);
+        return ec == std::errc() && end == value.data() + value.size();
+    }
+
+    fs::path default_install_app()
+    {
+        std::error_code ec;
+        auto sibling = fs::read_symlink("/proc/self/exe", ec).parent_path() / "install-app";
+        if (!ec && access(sibling.c_str(), X_OK) == 0)
+            return sibling;
+        return "install-app";
+    }
+
+    int generate(std::span<char *> args)
+    {
+        CorpusOptions options;
+
+        for (size_t i = 0; i < args.size(); ++i)
+        {
+            std::string_view arg = args[i];
+            bool has_value = i + 1 < args.size();
+
+            if ((arg == "-o" || arg == "--out") && has_value)
+                options.out_dir = args[++i];
+            else if (arg == "--scale" && has_value)
+            {
+                std::string_view value = args[++i];
+                if (!parse_number(value, options.scale) || options.scale <= 0)
+                {
+                    std::println(stderr, "Invalid scale: {}", value);
+                    return 1;
+                }
+            }
+            else if (arg == "--shapes" && has_value)
+            {
+                for (auto name : split(args[++i]))
+                {
+                    auto shape = parse_shape(name);
+                    if (!shape)
+                    {
+                        std::println(stderr, "{}", shape.error());
+                        return 1;
+                    }
+                    options.shapes.push_back(*shape);
+                }
+            }
+            else if (arg == "--formats" && has_value)
+            {
+                for (auto name : split(args[++i]))
+                {
+                    auto format = parse_corpus_format(name);
+                    if (!format)
+                    {
+                        std::println(stderr, "{}", format.error());
+                        return 1;
+                    }
+                    options.formats.push_back(*format);
+                }
+            }
+            else
+            {
+                std::println(stderr, "Unknown or incomplete option: {}", arg);
+                return 1;
+            }
+        }
+
+        if (options.shapes.empty())
+            options.shapes = { CorpusShape::TINY, CorpusShape::HUGE, CorpusShape::DEEP, CorpusShape::SPARSE,
+                CorpusShape::MIXED };
+        if (options.formats.empty())
+            options.formats = { CorpusFormat::TAR, CorpusFormat::TAR_GZ, CorpusFormat::TAR_BZ2, CorpusFormat::TAR_XZ,
+                CorpusFormat::ZIP, CorpusFormat::DEB, CorpusFormat::RPM };
+
+        auto archives = generate_corpus(options);
+        if (!archives)
+        {
+            std::println(stderr, "{}", archives.error());
+            return 1;
+        }
+        return 0;
+    }
+
+    int run(std::span<char *> args)
+    {
+        BenchOptions options;
+        options.install_app = default_install_app();
+        fs::path json_path;
+        fs::path check_path;
+        double tolerance = 5;
+
+        for (size_t i = 0; i < args.size(); ++i)
+        {
+            std::string_view arg = args[i];
+            bool has_value = i + 1 < args.size();
+
+            if ((arg == "-c" || arg == "--corpus") && has_value)
+                options.corpus_dir = args[++i];
+            else if (arg == "--install-app" && has_value)
+                options.install_app = args[++i];
+            else if (arg == "--work" && has_value)
+                options.work_dir = args[++i];
+            else if (arg == "--runs" && has_value)
+            {
+                std::string_view value = args[++i];
+                if (!parse_number(value, options.runs) || options.runs < 1)
+                {
+                    std::println(stderr, "Invalid run count: {}", value);
+                    return 1;
+                }
+            }
+            else if (arg == "--cache" && has_value)
+            {
+                options.caches.clear();
+                for (auto name : split(args[++i]))
+                {
+                    auto cache = parse_cache(name);
+                    if (!cache)
+                    {
+                        std::println(stderr, "{}", cache.error());
+                        return 1;
+                    }
+                    options.caches.push_back(*cache);
+                }
+            }
+            else if (arg == "--filesystems" && has_value)
+            {
+                options.filesystems.clear();
+                for (auto name : split(args[++i]))
+                    options.filesystems.emplace_back(name);
+            }
+            else if (arg == "--fs-size" && has_value)
+            {
+                std::string_view value = args[++i];
+                uint64_t mib = 0;
+                if (!parse_number(value, mib) || mib == 0)
+                {
+                    std::println(stderr, "Invalid filesystem size: {}", value);
+                    return 1;
+                }
+                options.filesystem_size = mib << 20;
+            }
+            else if (arg == "--check" && has_value)
+                check_path = args[++i];
+            else if (arg == "--tolerance" && has_value)
+            {
+                std::string_view value = args[++i];
+                if (!parse_number(value, tolerance) || tolerance < 0)
+                {
+                    std::println(stderr, "Invalid tolerance: {}", value);
+                    return 1;
+                }
+            }
+            else if (arg == "--no-baselines")
+                options.baselines = false;
+            else if (arg == "--json" && has_value)
+                json_path = args[++i];
+            else
+            {
+                std::println(stderr, "Unknown or incomplete option: {}", arg);
+                return 1;
+            }
+        }
+
+        std::error_code ec;
+        if (!check_path.empty() && !fs::exists(check_path, ec))
+        {
+            std::println(stderr, "No baseline at {}; record one with --json", check_path.string());
+            return EXIT_SKIPPED;
+        }
+
+        auto results = run_benchmarks(options);
+        if (!results)
+        {
+            std::println(stderr, "{}", results.error());
+            return 1;
+        }
+
+        print_results(*results);
+
+        if (!json_path.empty())
+        {
+            std::ofstream file(json_path);
+            file << results_json(*results, options);
+            if (!file)
+            {
+                std::println(stderr, "Failed to write {}", json_path.string());
+                return 1;
+            }
+        }
+
+        if (!check_path.empty())
+        {
+            auto regressions = check_regressions(*results, check_path, tolerance / 100);
+            if (!regressions)
+            {
+                std::println(stderr, "{}", regressions.error());
+                return 1;
+            }
+            return *regressions == 0 ? 0 : 1;
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::span<char *> args(argv, argc);
+    if (args.size() < 2 || std::string_view(args[1]) == "-h" || std::string_view(args[1]) == "--help")
+    {
+        print_usage(args[0]);
+        return args.size() < 2 ? 1 : 0;
+    }
+
+    std::string_view command = args[1];
+    if (command == "generate")
+        return generate(args.subspan(2));
+    if (command == "run")
+        return run(args.subspan(2));
+
+    std::println(stderr, "Unknown command: {}", command);
+    return 1;
+}
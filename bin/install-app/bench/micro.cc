@@ -0,0 +1,284 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <array>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unistd.h>
+#include <zlib.h>
+#include <benchmark/benchmark.h>
+#include "app.hh"
+#include "archive.hh"
+#include "crc32.hh"
+#include "inflate.hh"
+#include "memstats.hh"
+#include "paths.hh"
+#include "sha256.hh"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr std::array<std::string_view, 12> ARCHIVE_NAMES = { "firefox-128.0.tar.bz2", "node-v20.11.1-linux-x64.tar.xz",
+        "jetbrains-toolbox-2.2.1.tar.gz", "clion-2024.1.tgz", "code_1.87.2-1709912201_amd64.deb",
+        "zig-linux-x86_64-0.11.0.tar.xz", "android-studio-2023.2.1.24-linux.tar.gz", "Obsidian-1.5.8.zip",
+        "discord-0.0.45.tar.gz", "postman-linux-x64.tar", "google-chrome-stable-122.0.x86_64.rpm", "README.md" };
+
+    /* entry names as they appear in a typical application tarball */
+    std::vector<std::string> entry_names(size_t count)
+    {
+        constexpr std::array<std::string_view, 8> dirs = { "bin", "lib", "lib/x86_64-linux-gnu", "share/icons/hicolor/48x48/apps",
+            "resources/app/node_modules/lodash", "share/locale/de/LC_MESSAGES", "plugins/platforms", "jbr/lib/server" };
+        constexpr std::array<std::string_view, 8> files = { "app", "libssl.so.3", "libglib-2.0.so.0", "app.png",
+            "package.json", "app.mo", "libqxcb.so", "libjvm.so" };
+
+        std::vector<std::string> names;
+        names.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+            names.push_back(std::format("app-1.0/{}/{}{}", dirs[i % dirs.size()], i, files[(i / 3) % files.size()]));
+        return names;
+    }
+
+    /* reports heap allocations per iteration alongside the timings */
+    class AllocationCounter
+    {
+    public:
+        explicit AllocationCounter(benchmark::State &state) :
+            state(state)
+        {
+            memstats::enable();
+            start = memstats::snapshot();
+        }
+
+        ~AllocationCounter()
+        {
+            auto end = memstats::snapshot();
+            memstats::disable();
+            state.counters["allocs"] = benchmark::Counter(static_cast<double>(end.allocations - start.allocations),
+                    benchmark::Counter::kAvgIterations);
+            state.counters["alloc_bytes"] = benchmark::Counter(
+                    static_cast<double>(end.allocated_bytes - start.allocated_bytes), benchmark::Counter::kAvgIterations);
+        }
+
+    private:
+        benchmark::State &state;
+        memstats::Snapshot start;
+    };
+
+    void BM_DetectFormat(benchmark::State &state)
+    {
+        std::vector<fs::path> paths(ARCHIVE_NAMES.begin(), ARCHIVE_NAMES.end());
+        size_t i = 0;
+
+        AllocationCounter counter(state);
+        for (auto _ : state)
+            benchmark::DoNotOptimize(detect_format(paths[i++ % paths.size()]));
+    }
+    BENCHMARK(BM_DetectFormat);
+
+    void BM_DetectAppName(benchmark::State &state)
+    {
+        std::vector<fs::path> paths(ARCHIVE_NAMES.begin(), ARCHIVE_NAMES.end());
+        size_t i = 0;
+
+        AllocationCounter counter(state);
+        for (auto _ : state)
+            benchmark::DoNotOptimize(detect_app_name(paths[i++ % paths.size()]));
+    }
+    BENCHMARK(BM_DetectAppName);
+
+    void BM_IsValidExecutable(benchmark::State &state)
+    {
+        std::vector<fs::path> paths;
+        for (const auto &name : entry_names(256))
+            paths.emplace_back(name);
+        size_t i = 0;
+
+        AllocationCounter counter(state);
+        for (auto _ : state)
+            benchmark::DoNotOptimize(is_valid_executable(paths[i++ % paths.size()]));
+    }
+    BENCHMARK(BM_IsValidExecutable);
+
+    void BM_EntryPath(benchmark::State &state)
+    {
+        auto names = entry_names(1024);
+        EntryPaths paths("/tmp/install-app-12345");
+        size_t i = 0;
+
+        AllocationCounter counter(state);
+        for (auto _ : state)
+            benchmark::DoNotOptimize(paths.resolve(names[i++ % names.size()]));
+    }
+    BENCHMARK(BM_EntryPath);
+
+    /* one symlink in the tree makes every entry's directory subject to the escape check */
+    void BM_EntryPathWithSymlinks(benchmark::State &state)
+    {
+        auto names = entry_names(1024);
+        EntryPaths paths("/tmp/install-app-12345");
+        (void)paths.resolve("app-1.0/lib/libfoo.so");
+        (void)paths.add_symlink("libfoo.so.1");
+        size_t i = 0;
+
+        AllocationCounter counter(state);
+        for (auto _ : state)
+            benchmark::DoNotOptimize(paths.resolve(names[i++ % names.size()]));
+    }
+    BENCHMARK(BM_EntryPathWithSymlinks);
+
+    /* `range(0)` is how many of the candidate locations are probed before the icon is found; 0 means
+     * there is no icon at all */
+    void BM_FindIcon(benchmark::State &state)
+    {
+        constexpr std::array<std::string_view, 10> candidates = { "bin/app.svg", "bin/app.png", "share/icons/app.svg",
+            "share/icons/app.png", "share/pixmaps/app.svg", "share/pixmaps/app.png", "icon.svg", "icon.png",
+            "app.svg", "app.png" };
+
+        auto root = fs::temp_directory_path() / std::format("install-app-microbench-{}", getpid());
+        fs::create_directories(root);
+        if (auto hit = state.range(0); hit > 0)
+        {
+            auto icon = root / candidates[static_cast<size_t>(hit) - 1];
+            fs::create_directories(icon.parent_path());
+            std::ofstream(icon) << "icon";
+        }
+
+        {
+            AllocationCounter counter(state);
+            for (auto _ : state)
+                benchmark::DoNotOptimize(find_icon(root, "app"));
+        }
+
+        fs::remove_all(root);
+    }
+    BENCHMARK(BM_FindIcon)->Arg(1)->Arg(6)->Arg(0);
+
+    /* 16 MiB of tar-like content: repetitive text with some incompressible pages mixed in */
+    const std::vector<std::byte> &inflate_input()
+    {
+        static const std::vector<std::byte> data = [] {
+            std::vector<std::byte> out(16 * 1024 * 1024);
+            uint64_t state = 0x9e3779b97f4a7c15;
+            auto names = entry_names(4096);
+            size_t i = 0;
+            for (size_t page = 0; page < out.size(); page += 4096)
+            {
+                auto end = std::min(page + 4096, out.size());
+                if (page / 4096 % 4 == 3)
+                {
+                    for (size_t j = page; j < end; ++j)
+                    {
+                        state = state * 6364136223846793005 + 1442695040888963407;
+                        out[j] = static_cast<std::byte>(state >> 56);
+                    }
+                    continue;
+                }
+                for (size_t j = page; j < end;)
+                {
+                    const auto &name = names[i++ % names.size()];
+                    auto n = std::min(name.size(), end - j);
+                    std::memcpy(out.data() + j, name.data(), n);
+                    j += n;
+                }
+            }
+            return out;
+        }();
+        return data;
+    }
+
+    std::vector<std::byte> gzip(std::span<const std::byte> data)
+    {
+        z_stream stream = {};
+        deflateInit2(&stream, 6, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+        std::vector<std::byte> out(deflateBound(&stream, data.size()));
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<std::byte *>(data.data()));
+        stream.avail_in = static_cast<uInt>(data.size());
+        stream.next_out = reinterpret_cast<Bytef *>(out.data());
+        stream.avail_out = static_cast<uInt>(out.size());
+        deflate(&stream, Z_FINISH);
+        out.resize(stream.total_out);
+        deflateEnd(&stream);
+        return out;
+    }
+
+    /* `range(0)` is the backend. every run is checked byte for byte against the original, so a
+     * backend that decodes differently from zlib fails rather than looking fast */
+    void BM_InflateGzip(benchmark::State &state)
+    {
+        auto backend = static_cast<inflater::Backend>(state.range(0));
+        if (!inflater::available(backend))
+        {
+            state.SkipWithError("backend not built in");
+            return;
+        }
+
+        const auto &data = inflate_input();
+        auto compressed = gzip(data);
+        state.SetLabel(std::string(inflater::backend_name(backend)));
+
+        for (auto _ : state)
+        {
+            auto decoded = inflater::decode_gzip(compressed, data.size(), backend);
+            if (!decoded || decoded->size != data.size() || std::memcmp(decoded->data.get(), data.data(), data.size()) != 0)
+            {
+                state.SkipWithError("decoded output differs");
+                return;
+            }
+        }
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * data.size()));
+    }
+    BENCHMARK(BM_InflateGzip)
+        ->Arg(static_cast<int64_t>(inflater::Backend::ZLIB))
+        ->Arg(static_cast<int64_t>(inflater::Backend::LIBDEFLATE));
+
+    /* `range(0)` is the implementation and `range(1)` the buffer size: a decoded inflate chunk, and a
+     * whole block. the result is checked against zlib's `crc32()` first */
+    void BM_Crc32(benchmark::State &state)
+    {
+        auto with = static_cast<crc::Implementation>(state.range(0));
+        if (!crc::available(with))
+        {
+            state.SkipWithError("not supported by this CPU");
+            return;
+        }
+
+        std::span<const std::byte> data(inflate_input().data(), static_cast<size_t>(state.range(1)));
+        auto expected = static_cast<uint32_t>(
+                ::crc32(0, reinterpret_cast<const Bytef *>(data.data()), static_cast<uInt>(data.size())));
+        if (crc::crc32(with, 0, data) != expected)
+        {
+            state.SkipWithError("checksum differs from zlib");
+            return;
+        }
+        state.SetLabel(std::string(crc::implementation_name(with)));
+
+        for (auto _ : state)
+            benchmark::DoNotOptimize(crc::crc32(with, 0, data));
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * data.size()));
+    }
+    BENCHMARK(BM_Crc32)->ArgsProduct({ { static_cast<int64_t>(crc::Implementation::PORTABLE),
+            static_cast<int64_t>(crc::Implementation::PCLMUL), static_cast<int64_t>(crc::Implementation::VPCLMUL) },
+        { 64 * 1024, 1024 * 1024 } });
+
+    /* what the manifest costs per extracted byte */
+    void BM_Sha256(benchmark::State &state)
+    {
+        std::span<const std::byte> data(inflate_input().data(), static_cast<size_t>(state.range(0)));
+        state.SetLabel(std::string(Sha256::implementation()));
+
+        for (auto _ : state)
+        {
+            Sha256 hasher;
+            hasher.update(data);
+            benchmark::DoNotOptimize(hasher.finish());
+        }
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * data.size()));
+    }
+    BENCHMARK(BM_Sha256)->Arg(64 * 1024)->Arg(1024 * 1024);
+}
+
+BENCHMARK_MAIN();
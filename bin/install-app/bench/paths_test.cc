@@ -0,0 +1,145 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <format>
+#include <print>
+#include <source_location>
+#include <string_view>
+#include "paths.hh"
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool ok, std::string_view what, std::source_location where = std::source_location::current())
+    {
+        if (ok)
+            return;
+        std::println(stderr, "{}:{}: {}", where.file_name(), where.line(), what);
+        ++failures;
+    }
+
+    /* resolves `name` and checks that it is accepted as `relative` */
+    void accepts(EntryPaths &paths, std::string_view name, std::string_view relative,
+                 std::source_location where = std::source_location::current())
+    {
+        auto resolved = paths.resolve(name);
+        check(resolved.has_value(), std::format("'{}' refused: {}", name, resolved ? "" : resolved.error()), where);
+        if (resolved)
+            check(paths.relative() == relative, std::format("'{}' resolved to '{}'", name, paths.relative()), where);
+    }
+
+    void refuses(EntryPaths &paths, std::string_view name, std::string_view error,
+                 std::source_location where = std::source_location::current())
+    {
+        auto resolved = paths.resolve(name);
+        check(!resolved && resolved.error() == error,
+              std::format("'{}': expected \"{}\", got \"{}\"", name, error, resolved ? "accepted" : resolved.error()), where);
+    }
+
+    void symlink(EntryPaths &paths, std::string_view name, std::string_view target, std::string_view error = {},
+                 std::source_location where = std::source_location::current())
+    {
+        accepts(paths, name, name, where);
+        auto added = paths.add_symlink(target);
+        auto got = added ? std::string_view("accepted") : added.error();
+        check(error.empty() ? added.has_value() : !added && added.error() == error,
+              std::format("symlink '{}' -> '{}': expected \"{}\", got \"{}\"", name, target,
+                          error.empty() ? "accepted" : error, got), where);
+    }
+
+    void names()
+    {
+        EntryPaths paths("/dest");
+        accepts(paths, "app-1.0/bin/app", "app-1.0/bin/app");
+        accepts(paths, "./app-1.0//lib/./libfoo.so/", "app-1.0/lib/libfoo.so");
+        check(std::string_view(*paths.resolve("a/b")) == "/dest/a/b", "resolved path is not below the root");
+
+        /* absolute names are kept in the tree rather than refused */
+        accepts(paths, "/etc/passwd", "etc/passwd");
+        accepts(paths, "//etc/./passwd", "etc/passwd");
+
+        refuses(paths, "../escape", "contains '..'");
+        refuses(paths, "app-1.0/../../escape", "contains '..'");
+        refuses(paths, "/../etc/passwd", "contains '..'");
+        refuses(paths, "app-1.0/bin/..", "contains '..'");
+    }
+
+    void symlinks()
+    {
+        EntryPaths paths("/dest");
+        symlink(paths, "app/lib64", "lib");
+        symlink(paths, "app/bin/tool", "../lib/tool");
+        symlink(paths, "app/up", "./../app/lib");
+
+        symlink(paths, "app/etc", "/etc", "points to an absolute path");
+        symlink(paths, "app/out", "../../etc", "points outside the extraction directory");
+        symlink(paths, "app/out", "lib/../../..", "points outside the extraction directory");
+        symlink(paths, "app/empty", "", "has an empty target");
+        symlink(paths, "app/via", "lib64/x", "points through another symlink");
+        accepts(paths, "./", "");
+        check(!paths.add_symlink("app"), "a symlink replacing the extraction directory was accepted");
+
+        /* the link itself may be replaced, but nothing may be written below it */
+        accepts(paths, "app/lib64", "app/lib64");
+        refuses(paths, "app/lib64/libfoo.so", "would be written through a symlink");
+        refuses(paths, "app/lib64/sub/libfoo.so", "would be written through a symlink");
+        accepts(paths, "app/lib/libfoo.so", "app/lib/libfoo.so");
+
+        /* a directory already written into is checked again once it has become a symlink */
+        accepts(paths, "app/share/a", "app/share/a");
+        symlink(paths, "app/share", "lib");
+        refuses(paths, "app/share/b", "would be written through a symlink");
+    }
+
+    void hardlinks()
+    {
+        EntryPaths paths("/dest");
+        symlink(paths, "app/lib64", "lib");
+
+        auto link = paths.resolve_link("/app/lib/libfoo.so");
+        check(link && std::string_view(*link) == "/dest/app/lib/libfoo.so", "hardlink target not resolved below the root");
+        check(paths.relative_link() == "app/lib/libfoo.so", "wrong relative hardlink target");
+
+        auto refused = [&](std::string_view target, std::string_view error,
+                           std::source_location where = std::source_location::current()) {
+            auto resolved = paths.resolve_link(target);
+            check(!resolved && resolved.error() == error,
+                  std::format("hardlink '{}': expected \"{}\", got \"{}\"", target, error,
+                              resolved ? "accepted" : resolved.error()), where);
+        };
+        refused("../etc/passwd", "contains '..'");
+        refused("app/../../etc/passwd", "contains '..'");
+        refused("./", "links to the extraction directory");
+        refused("app/lib64/libfoo.so", "links through a symlink");
+
+        /* resolving a target leaves the entry path alone */
+        accepts(paths, "app/bin/tool", "app/bin/tool");
+        check(paths.resolve_link("app/lib/libfoo.so").has_value(), "hardlink target refused");
+        check(paths.relative() == "app/bin/tool", "resolving a hardlink target changed the entry path");
+    }
+
+    void rebase()
+    {
+        EntryPaths paths("/dest");
+        symlink(paths, "lib64", "lib");
+        refuses(paths, "lib64/libfoo.so", "would be written through a symlink");
+
+        /* everything extracted so far was moved into `top`, its symlinks with it */
+        paths.rebase("top");
+        accepts(paths, "lib64/libfoo.so", "lib64/libfoo.so");
+        refuses(paths, "top/lib64/libfoo.so", "would be written through a symlink");
+        check(!paths.resolve_link("top/lib64/libfoo.so"), "hardlink through a rebased symlink accepted");
+    }
+}
+
+int main()
+{
+    names();
+    symlinks();
+    hardlinks();
+    rebase();
+
+    if (failures)
+        std::println(stderr, "{} check(s) failed", failures);
+    return failures ? 1 : 0;
+}
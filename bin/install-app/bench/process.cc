@@ -0,0 +1,69 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "process.hh"
+
+extern char **environ;
+
+namespace fs = std::filesystem;
+
+std::optional<fs::path> find_program(std::string_view name)
+{
+    auto path = std::getenv("PATH");
+    if (!path)
+        return std::nullopt;
+
+    std::string_view dirs = path;
+    while (!dirs.empty())
+    {
+        auto end = dirs.find(':');
+        auto candidate = fs::path(dirs.substr(0, end)) / name;
+        if (access(candidate.c_str(), X_OK) == 0)
+            return candidate;
+        if (end == std::string_view::npos)
+            break;
+        dirs.remove_prefix(end + 1);
+    }
+
+    return std::nullopt;
+}
+
+std::expected<double, std::string> run_command(const std::vector<std::string> &argv)
+{
+    std::vector<char *> args;
+    for (const auto &arg : argv)
+        args.push_back(const_cast<char *>(arg.c_str()));
+    args.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = 0;
+    int err = posix_spawnp(&pid, args[0], &actions, nullptr, args.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (err != 0)
+        return std::unexpected(std::format("Failed to run {}: {}", argv[0], std::strerror(err)));
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+    {
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return std::unexpected(std::format("{} exited with status {}", argv[0],
+                WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status)));
+    return elapsed;
+}
@@ -0,0 +1,16 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <expected>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* runs `argv` with stdin and output redirected to /dev/null and returns its wall time in seconds.
+ * anything but a zero exit status is an error */
+std::expected<double, std::string> run_command(const std::vector<std::string> &argv);
+
+std::optional<std::filesystem::path> find_program(std::string_view name);
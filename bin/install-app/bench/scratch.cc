@@ -0,0 +1,132 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <format>
+#include <system_error>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mount.h>
+#include "process.hh"
+#include "scratch.hh"
+
+namespace fs = std::filesystem;
+
+std::expected<ScratchFilesystem, std::string> ScratchFilesystem::create(std::string_view kind, const fs::path &parent,
+        uint64_t size)
+{
+    if (kind == "work")
+        return ScratchFilesystem("work", parent, {}, false);
+
+    if (kind != "tmpfs" && kind != "ext4" && kind != "btrfs")
+        return std::unexpected(std::format("Unknown filesystem: {}", kind));
+
+    std::error_code ec;
+    auto mountpoint = parent / std::format("{}.mnt", kind);
+    fs::create_directories(mountpoint, ec);
+    if (ec)
+        return std::unexpected(std::format("Failed to create {}: {}", mountpoint.string(), ec.message()));
+
+    if (kind == "tmpfs")
+    {
+        auto mounted = run_command({ "mount", "-t", "tmpfs", "-o", std::format("size={}", size), "tmpfs",
+                mountpoint.string() });
+        if (!mounted)
+        {
+            fs::remove(mountpoint, ec);
+            return std::unexpected(mounted.error());
+        }
+        return ScratchFilesystem(std::string(kind), mountpoint, {}, true);
+    }
+
+    /* the image is sparse, so only what the runs actually write takes up space */
+    auto image = parent / std::format("{}.img", kind);
+    int fd = open(image.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    bool sized = fd >= 0 && ftruncate(fd, static_cast<off_t>(size)) == 0;
+    if (fd >= 0)
+        close(fd);
+
+    auto fail = [&](std::string message) -> std::unexpected<std::string> {
+        fs::remove(image, ec);
+        fs::remove(mountpoint, ec);
+        return std::unexpected(std::move(message));
+    };
+
+    if (!sized)
+        return fail(std::format("Failed to create {}", image.string()));
+
+    auto made = kind == "ext4" ? run_command({ "mkfs.ext4", "-q", "-F", image.string() })
+                               : run_command({ "mkfs.btrfs", "-q", "-f", image.string() });
+    if (!made)
+        return fail(made.error());
+
+    auto mounted = run_command({ "mount", "-o", "loop", image.string(), mountpoint.string() });
+    if (!mounted)
+        return fail(mounted.error());
+
+    return ScratchFilesystem(std::string(kind), mountpoint, image, true);
+}
+
+ScratchFilesystem::ScratchFilesystem(std::string kind, fs::path root, fs::path image, bool mounted) :
+    name(std::move(kind)), mountpoint(std::move(root)), image(std::move(image)), mounted(mounted)
+{
+}
+
+ScratchFilesystem::ScratchFilesystem(ScratchFilesystem &&other) noexcept :
+    name(std::move(other.name)), mountpoint(std::move(other.mountpoint)), image(std::move(other.image)),
+    mounted(std::exchange(other.mounted, false))
+{
+}
+
+ScratchFilesystem::~ScratchFilesystem()
+{
+    if (!mounted)
+        return;
+
+    std::error_code ec;
+    if (umount2(mountpoint.c_str(), MNT_DETACH) == 0)
+        fs::remove(mountpoint, ec);
+    if (!image.empty())
+        fs::remove(image, ec);
+}
+
+const std::string &ScratchFilesystem::kind() const
+{
+    return name;
+}
+
+const fs::path &ScratchFilesystem::root() const
+{
+    return mountpoint;
+}
+
+void evict_file(const fs::path &path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0)
+        return;
+
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+void evict_tree(const fs::path &path)
+{
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(path, ec); !ec && it != fs::recursive_directory_iterator();
+            it.increment(ec))
+    {
+        if (it->is_regular_file(ec) && !it->is_symlink(ec))
+            evict_file(it->path());
+    }
+}
+
+void sync_filesystem(const fs::path &path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    syncfs(fd);
+    close(fd);
+}
@@ -0,0 +1,40 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+/* a directory to install into: the plain work directory, or a tmpfs or loop-mounted ext4/btrfs image
+ * created under it. mounting needs root and the mkfs tools, so callers treat failure as "unavailable" */
+class ScratchFilesystem
+{
+public:
+    static std::expected<ScratchFilesystem, std::string> create(std::string_view kind,
+            const std::filesystem::path &parent, uint64_t size);
+
+    ScratchFilesystem(ScratchFilesystem &&other) noexcept;
+    ScratchFilesystem &operator=(ScratchFilesystem &&) = delete;
+    ~ScratchFilesystem();
+
+    const std::string &kind() const;
+    const std::filesystem::path &root() const;
+
+private:
+    ScratchFilesystem(std::string kind, std::filesystem::path root, std::filesystem::path image, bool mounted);
+
+    std::string name;
+    std::filesystem::path mountpoint;
+    std::filesystem::path image;
+    bool mounted = false;
+};
+
+/* drops `path` from the page cache. dirty pages are written back first, since DONTNEED skips them */
+void evict_file(const std::filesystem::path &path);
+/* writes back and evicts every regular file below `path` */
+void evict_tree(const std::filesystem::path &path);
+/* flushes the filesystem holding `path` so writeback from one run does not land in the next */
+void sync_filesystem(const std::filesystem::path &path);
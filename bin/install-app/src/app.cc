@@ -0,0 +1,127 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <string_view>
+#include <sys/stat.h>
+#include "app.hh"
+#include "log.hh"
+#include "lookup.hh"
+
+namespace fs = std::filesystem;
+
+std::string detect_app_name(const fs::path &archive_file)
+{
+    /* `app-1.0.tar.gz.001` is named for the archive it is a piece of */
+    auto filename = names::filename(archive_file);
+    filename.remove_suffix(names::volume_suffix(filename).size());
+    auto name = fs::path(filename).stem().string();
+
+    if (name.ends_with(".tar"))
+        name = name.substr(0, name.length() - 4);
+
+    auto dash_pos = name.find_last_of('-');
+    if (dash_pos != std::string::npos)
+    {
+        auto version_part = name.substr(dash_pos + 1);
+        if (!version_part.empty() && std::isdigit(version_part[0]))
+            name = name.substr(0, dash_pos);
+    }
+
+    return name;
+}
+
+bool is_valid_executable(const fs::path &path)
+{
+    static constexpr auto excluded_extensions = perfect_set({
+        ".so", ".a", ".o", ".la", ".dylib", ".dll",
+        ".sh", ".bash", ".zsh", ".fish", ".py", ".pl", ".rb",
+        ".txt", ".md", ".xml", ".json", ".conf", ".cfg"
+    });
+
+    auto filename = names::filename(path);
+    if (filename.starts_with("."))
+        return false;
+
+    return !excluded_extensions.contains(names::extension(filename));
+}
+
+std::vector<fs::path> find_executables(const fs::path &dir, size_t max_results)
+{
+    std::vector<fs::path> executables;
+
+    try
+    {
+        for (const auto &entry : fs::recursive_directory_iterator(dir))
+        {
+            if (entry.is_regular_file())
+            {
+                auto perms = entry.status().permissions();
+                if ((perms & fs::perms::owner_exec) == fs::perms::owner_exec)
+                {
+                    if (is_valid_executable(entry.path()))
+                    {
+                        executables.push_back(entry.path());
+                        if (executables.size() >= max_results)
+                            break;
+                    }
+                }
+            }
+        }
+    }
+    catch (const fs::filesystem_error &e)
+    {
+        warn("Filesystem error: {}", e.what());
+    }
+
+    return executables;
+}
+
+std::optional<fs::path> find_icon(const fs::path &install_dir, const std::string &app_name)
+{
+    struct Candidate
+    {
+        std::string_view dir;
+        /* the app name when empty */
+        std::string_view stem;
+        std::string_view extension;
+    };
+
+    static constexpr std::array<Candidate, 10> candidates = { {
+        { "bin/", "", ".svg" },
+        { "bin/", "", ".png" },
+        { "share/icons/", "", ".svg" },
+        { "share/icons/", "", ".png" },
+        { "share/pixmaps/", "", ".svg" },
+        { "share/pixmaps/", "", ".png" },
+        { "", "icon", ".svg" },
+        { "", "icon", ".png" },
+        { "", "", ".svg" },
+        { "", "", ".png" },
+    } };
+
+    /* every candidate is built in the same buffer and probed with a plain `stat`; only a hit becomes
+     * a `path` */
+    std::string candidate;
+    candidate.reserve(install_dir.native().size() + 1 + std::string_view("share/pixmaps/.svg").size() +
+            std::max<size_t>(app_name.size(), 4));
+    candidate = install_dir.native();
+    if (!candidate.ends_with('/'))
+        candidate += '/';
+    auto root_length = candidate.size();
+
+    for (const auto &[dir, stem, extension] : candidates)
+    {
+        candidate.resize(root_length);
+        candidate += dir;
+        candidate += stem.empty() ? std::string_view(app_name) : stem;
+        candidate += extension;
+
+        struct stat st;
+        if (stat(candidate.c_str(), &st) == 0)
+            return fs::path(std::move(candidate));
+    }
+
+    return std::nullopt;
+}
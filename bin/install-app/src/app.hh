@@ -0,0 +1,14 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+/* strips the archive extensions and a trailing `-<version>` from the file name */
+std::string detect_app_name(const std::filesystem::path &archive_file);
+bool is_valid_executable(const std::filesystem::path &path);
+std::vector<std::filesystem::path> find_executables(const std::filesystem::path &dir, size_t max_results = 20);
+std::optional<std::filesystem::path> find_icon(const std::filesystem::path &install_dir, const std::string &app_name);
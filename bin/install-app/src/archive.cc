@@ -0,0 +1,1703 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <format>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <archive.h>
+#include <archive_entry.h>
+#include "archive.hh"
+#include "crc32.hh"
+#include "inflate.hh"
+#include "input.hh"
+#include "launch.hh"
+#include "log.hh"
+#include "lookup.hh"
+#include "makeself.hh"
+#include "memstats.hh"
+#include "paths.hh"
+#include "profile.hh"
+#include "progress.hh"
+#include "trace.hh"
+#include "zip.hh"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    /* what a sparse file reads as in its holes */
+    constexpr std::array<std::byte, 64 * 1024> ZEROS = {};
+    /* below this a plain write out of the mapping is as cheap as opening the file a second time */
+    constexpr uint64_t COPY_RANGE_MIN = 256 * 1024;
+    /* how much of a streamed archive launch-first extraction holds back while it looks for what the app
+     * needs to start */
+    constexpr uint64_t SPILL_LIMIT = 256 * 1024 * 1024;
+
+    void hash_zeros(Sha256 &hasher, uint64_t count)
+    {
+        for (; count > 0; count -= std::min<uint64_t>(count, ZEROS.size()))
+            hasher.update(std::span(ZEROS).first(std::min<uint64_t>(count, ZEROS.size())));
+    }
+
+    /* a later entry for the same path replaces the earlier one on disk, so only the last is kept.
+     * hardlinks carry no data of their own and take the digest of whatever their target ended up as */
+    void settle_files(std::vector<ManifestFile> &files, const std::vector<std::pair<size_t, std::string>> &hardlinks)
+    {
+        std::unordered_map<std::string_view, size_t> last;
+        for (size_t i = 0; i < files.size(); ++i)
+            last[files[i].path] = i;
+
+        for (const auto &[index, target] : hardlinks)
+        {
+            if (auto it = last.find(target); it != last.end() && it->second != index)
+            {
+                files[index].size = files[it->second].size;
+                files[index].digest = files[it->second].digest;
+            }
+        }
+
+        std::vector<bool> keep(files.size());
+        for (const auto &[path, index] : last)
+            keep[index] = true;
+
+        size_t kept = 0;
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            if (!keep[i])
+                continue;
+            if (kept != i)
+                files[kept] = std::move(files[i]);
+            ++kept;
+        }
+        files.resize(kept);
+    }
+
+    /* per-format extraction policies. each registers only the libarchive readers its format needs, so
+     * libarchive does not bid every format and filter it knows against the input, and says which of the
+     * fast paths below apply. `extract()` picks one with a single switch and everything after that is
+     * resolved at compile time */
+    struct FormatPolicy
+    {
+        /* decode gzip ahead of libarchive with `inflater` */
+        static constexpr bool GUNZIP = false;
+        /* read zip through its central directory instead of libarchive */
+        static constexpr bool ZIP_DIRECTORY = false;
+        /* let the kernel copy file data straight out of an uncompressed archive */
+        static constexpr bool COPY_RANGE = false;
+        /* the archive starts somewhere inside the file, after a script that is not read as one */
+        static constexpr bool PAYLOAD_OFFSET = false;
+    };
+
+    struct TarFormat : FormatPolicy
+    {
+        static constexpr bool COPY_RANGE = true;
+
+        static void readers(archive *a)
+        {
+            archive_read_support_format_tar(a);
+        }
+    };
+
+    struct TarGzFormat : FormatPolicy
+    {
+        static constexpr bool GUNZIP = true;
+
+        static void readers(archive *a)
+        {
+            archive_read_support_format_tar(a);
+        }
+    };
+
+    struct TarBz2Format : FormatPolicy
+    {
+        static void readers(archive *a)
+        {
+            archive_read_support_format_tar(a);
+            archive_read_support_filter_bzip2(a);
+        }
+    };
+
+    struct TarXzFormat : FormatPolicy
+    {
+        static void readers(archive *a)
+        {
+            archive_read_support_format_tar(a);
+            archive_read_support_filter_xz(a);
+        }
+    };
+
+    struct ZipFormat : FormatPolicy
+    {
+        static constexpr bool ZIP_DIRECTORY = true;
+
+        static void readers(archive *a)
+        {
+            archive_read_support_format_zip(a);
+        }
+    };
+
+    struct DebFormat : FormatPolicy
+    {
+        static void readers(archive *a)
+        {
+            archive_read_support_format_ar(a);
+        }
+    };
+
+    struct RpmFormat : FormatPolicy
+    {
+        /* the payload is a cpio archive compressed with whatever the package was built with */
+        static void readers(archive *a)
+        {
+            archive_read_support_filter_rpm(a);
+            archive_read_support_format_cpio(a);
+            archive_read_support_filter_gzip(a);
+            archive_read_support_filter_bzip2(a);
+            archive_read_support_filter_xz(a);
+            archive_read_support_filter_lzma(a);
+            archive_read_support_filter_zstd(a);
+        }
+    };
+
+    /* the tarball after a self-extracting script. gzip is makeself's default and goes through
+     * `inflater`; the rest are libarchive filters */
+    struct MakeselfFormat : FormatPolicy
+    {
+        static constexpr bool GUNZIP = true;
+        static constexpr bool PAYLOAD_OFFSET = true;
+
+        static void readers(archive *a)
+        {
+            archive_read_support_format_tar(a);
+            archive_read_support_filter_bzip2(a);
+            archive_read_support_filter_xz(a);
+            archive_read_support_filter_zstd(a);
+        }
+    };
+
+    /* everything libarchive knows, for files whose name does not match what they hold */
+    struct AnyFormat : FormatPolicy
+    {
+        static void readers(archive *a)
+        {
+            archive_read_support_format_all(a);
+            archive_read_support_filter_all(a);
+        }
+    };
+
+    /* what a nested member's reader has taken from the outer archive, kept until the reader inside has
+     * read its first header. up to then the member may still turn out not to be an archive, and is
+     * written out as it is from this copy; from then on it is one, and the copy is dropped */
+    struct MemberTee
+    {
+        std::vector<std::byte> data;
+        /* the outer archive has no more of the member */
+        bool ended = false;
+        bool opened = false;
+        /* the outermost paths the reader inside wrote that were not there before, to be removed again
+         * if it fails part way */
+        std::vector<fs::path> created;
+        std::unordered_set<std::string> existing;
+    };
+
+    struct ExtractJob
+    {
+        const fs::path &archive_path;
+        const fs::path &dest_path;
+        std::vector<ManifestFile> *files;
+        Sha256 *archive_hash;
+        const NestedArchives *nested = nullptr;
+        /* how many archives this one is inside of */
+        int depth = 0;
+        LaunchPlan *launch = nullptr;
+        /* set for the archive inside a member */
+        MemberTee *member = nullptr;
+    };
+
+    std::expected<ExtractStats, std::string> extract_stream(const ExtractJob &job, std::unique_ptr<InputSource> input);
+
+    /* entries as libarchive reads them. entry sources follow libarchive's return codes, so the
+     * extraction loop is the same for all of them */
+    class LibarchiveEntries
+    {
+    public:
+        LibarchiveEntries(archive *a, const InputSource &source) :
+            a(a), source(source)
+        {
+        }
+
+        int next(archive_entry *&entry)
+        {
+            return archive_read_next_header(a, &entry);
+        }
+
+        int read_block(const void *&buffer, size_t &size, int64_t &offset)
+        {
+            la_int64_t at = 0;
+            auto r = archive_read_data_block(a, &buffer, &size, &at);
+            offset = at;
+            return r;
+        }
+
+        int skip()
+        {
+            return archive_read_data_skip(a);
+        }
+
+        std::string_view error() const
+        {
+            auto message = archive_error_string(a);
+            return message ? message : "unknown error";
+        }
+
+        uint64_t position() const
+        {
+            return source.position();
+        }
+
+    private:
+        archive *a;
+        const InputSource &source;
+    };
+
+    /* entries straight from a mapped zip file's central directory. stored data is handed out of the
+     * mapping as it is, deflated data is decoded by `inflater` in one call unless the entry is huge, and
+     * every entry's CRC is checked with `crc::crc32` */
+    class ZipEntries
+    {
+    public:
+        ZipEntries(std::span<const std::byte> file, std::vector<zip::Entry> entries) :
+            file(file), entries(std::move(entries)), entry(archive_entry_new())
+        {
+            if (!entry)
+                throw std::bad_alloc();
+        }
+
+        ZipEntries(const ZipEntries &) = delete;
+        ZipEntries &operator=(const ZipEntries &) = delete;
+
+        ~ZipEntries()
+        {
+            archive_entry_free(entry);
+        }
+
+        /* hands out what `plan` wants ahead of directory order, looking again whenever it wants more */
+        void prioritise(LaunchPlan &launch)
+        {
+            plan = &launch;
+            taken.assign(entries.size(), false);
+        }
+
+        int next(archive_entry *&out)
+        {
+            auto chosen = pick();
+            if (!chosen)
+                return ARCHIVE_EOF;
+
+            current = &entries[*chosen];
+            auto data = zip::entry_data(file, *current);
+            if (!data)
+                return fail(data.error(), ARCHIVE_FATAL);
+            compressed = *data;
+            produced = 0;
+            checksum = 0;
+            done = false;
+            corrupt = false;
+            stream.reset();
+
+            archive_entry_clear(entry);
+            name.assign(current->name);
+            archive_entry_copy_pathname(entry, name.c_str());
+            archive_entry_set_mode(entry, current->mode);
+            archive_entry_set_mtime(entry, current->mtime, 0);
+
+            switch (current->mode & S_IFMT)
+            {
+                case S_IFREG:
+                    archive_entry_set_size(entry, static_cast<la_int64_t>(current->size));
+                    break;
+                case S_IFLNK:
+                {
+                    /* the target is the entry's data */
+                    const void *target;
+                    size_t size;
+                    int64_t offset;
+                    if (current->size > 4096 || read_block(target, size, offset) != ARCHIVE_OK ||
+                            read_block(target, size, offset) != ARCHIVE_EOF)
+                        return fail(std::format("{}: unusable symlink target", name), ARCHIVE_FAILED);
+                    archive_entry_copy_symlink(entry, std::string(static_cast<const char *>(target), size).c_str());
+                    archive_entry_set_size(entry, 0);
+                    done = true;
+                    break;
+                }
+                default:
+                    archive_entry_set_size(entry, 0);
+                    done = true;
+                    break;
+            }
+
+            out = entry;
+            return ARCHIVE_OK;
+        }
+
+        int read_block(const void *&buffer, size_t &size, int64_t &offset)
+        {
+            /* like libarchive, the data is handed out and the mismatch reported after it */
+            if (corrupt)
+            {
+                corrupt = false;
+                return fail(std::format("{}: CRC mismatch", name), ARCHIVE_WARN);
+            }
+            if (done || current->size == 0)
+            {
+                done = true;
+                return ARCHIVE_EOF;
+            }
+
+            offset = static_cast<int64_t>(produced);
+            std::span<const std::byte> block;
+            if (current->method == zip::STORED)
+            {
+                if (compressed.size() != current->size)
+                    return fail(std::format("{}: stored size mismatch", name), ARCHIVE_FAILED);
+                block = compressed;
+            }
+            else if (current->size <= WHOLE_ENTRY_LIMIT)
+            {
+                reserve(current->size);
+                std::span<std::byte> out(decoded.get(), current->size);
+                if (auto result = inflater::decode_raw(compressed, out); !result)
+                    return fail(std::format("{}: {}", name, result.error()), ARCHIVE_FAILED);
+                block = out;
+            }
+            else
+            {
+                auto streamed = stream_block();
+                if (!streamed)
+                    return fail(std::format("{}: {}", name, streamed.error()), ARCHIVE_FAILED);
+                block = *streamed;
+            }
+
+            produced += block.size();
+            checksum = crc::crc32(checksum, block);
+            if (produced >= current->size)
+            {
+                done = true;
+                corrupt = produced != current->size || checksum != current->crc;
+            }
+
+            buffer = block.data();
+            size = block.size();
+            return ARCHIVE_OK;
+        }
+
+        std::string_view error() const
+        {
+            return failure;
+        }
+
+        uint64_t position() const
+        {
+            return current ? current->header_offset + current->compressed_size : 0;
+        }
+
+    private:
+        /* larger entries stream through zlib a block at a time, so memory stays bounded */
+        static constexpr uint64_t WHOLE_ENTRY_LIMIT = 64 * 1024 * 1024;
+        static constexpr size_t STREAM_BLOCK = 1024 * 1024;
+
+        int fail(std::string message, int code)
+        {
+            failure = std::move(message);
+            done = true;
+            return code;
+        }
+
+        std::optional<size_t> pick()
+        {
+            if (plan && !plan->ready() && plan->generation() != generation)
+            {
+                generation = plan->generation();
+                for (auto i = index; i < entries.size(); ++i)
+                {
+                    if (!taken[i] && plan->wants(plan->strip(entries[i].name)))
+                    {
+                        taken[i] = true;
+                        urgent.push_back(i);
+                    }
+                }
+            }
+
+            if (!urgent.empty())
+            {
+                auto i = urgent.front();
+                urgent.pop_front();
+                return i;
+            }
+
+            while (index < taken.size() && taken[index])
+                ++index;
+            if (index == entries.size())
+                return std::nullopt;
+            return index++;
+        }
+
+        void reserve(size_t size)
+        {
+            if (size <= capacity)
+                return;
+            decoded = std::make_unique_for_overwrite<std::byte[]>(size);
+            capacity = size;
+        }
+
+        std::expected<std::span<const std::byte>, std::string> stream_block()
+        {
+            if (!stream)
+                stream = std::make_unique<inflater::RawStream>();
+            reserve(STREAM_BLOCK);
+
+            std::span<std::byte> out(decoded.get(), STREAM_BLOCK);
+            size_t written = 0;
+            bool finished = false;
+            while (written < out.size() && !finished)
+            {
+                auto result = stream->decode(compressed, out.subspan(written), finished);
+                if (!result)
+                    return std::unexpected(result.error());
+                written += *result;
+            }
+            if (finished && produced + written != current->size)
+                return std::unexpected("Failed to decompress: size mismatch");
+            return std::span<const std::byte>(out.first(written));
+        }
+
+        std::span<const std::byte> file;
+        std::vector<zip::Entry> entries;
+        archive_entry *entry;
+        size_t index = 0;
+        const zip::Entry *current = nullptr;
+        std::string name;
+        std::span<const std::byte> compressed;
+        uint64_t produced = 0;
+        uint32_t checksum = 0;
+        bool done = false;
+        bool corrupt = false;
+        std::unique_ptr<inflater::RawStream> stream;
+        std::unique_ptr<std::byte[]> decoded;
+        size_t capacity = 0;
+        std::string failure;
+        LaunchPlan *plan = nullptr;
+        /* entries handed out ahead of their turn, and those still waiting for it */
+        std::vector<bool> taken;
+        std::deque<size_t> urgent;
+        uint64_t generation = UINT64_MAX;
+    };
+
+    /* launch-first extraction of an archive that can only be read front to back. entries the launch plan
+     * does not want are held in memory, up to SPILL_LIMIT in all, while the ones it does go straight
+     * through, so that the app can start long before the reader gets to the end. what is held is handed
+     * out in archive order once the plan is ready, or at the end of the archive; a library that turns out
+     * to be wanted after it was held is handed out first. a hardlink, or a second entry for a held path,
+     * waits until everything held before it is out */
+    template <typename Entries>
+    class SpillEntries
+    {
+    public:
+        SpillEntries(Entries &entries, LaunchPlan &plan) :
+            entries(entries), plan(plan)
+        {
+        }
+
+        int next(archive_entry *&out)
+        {
+            current.reset();
+
+            if (plan.generation() != generation && !held.empty())
+            {
+                generation = plan.generation();
+                std::stable_partition(held.begin(), held.end(), [&](const Held &entry) { return wanted(entry); });
+            }
+            if (!held.empty() && (flushing || ended != ARCHIVE_OK || plan.ready() || wanted(held.front())))
+                return emit(out);
+            flushing = false;
+
+            if (pending)
+            {
+                out = std::exchange(pending, nullptr);
+                return ARCHIVE_OK;
+            }
+            if (ended != ARCHIVE_OK)
+                return ended;
+
+            while (true)
+            {
+                auto r = entries.next(out);
+                if (r == ARCHIVE_FAILED)
+                    return r;
+                if (r != ARCHIVE_OK)
+                {
+                    ended = r;
+                    return held.empty() ? r : emit(out);
+                }
+
+                if (!holdable(out))
+                {
+                    auto name = archive_entry_pathname(out);
+                    if (!held.empty() && (archive_entry_hardlink(out) || (name && held_names.contains(name))))
+                    {
+                        pending = out;
+                        flushing = true;
+                        return emit(out);
+                    }
+                    return ARCHIVE_OK;
+                }
+                hold(out);
+            }
+        }
+
+        int read_block(const void *&buffer, size_t &size, int64_t &offset)
+        {
+            if (!current)
+                return entries.read_block(buffer, size, offset);
+            if (current->sent || current->data.empty())
+                return current->status;
+
+            current->sent = true;
+            buffer = current->data.data();
+            size = current->data.size();
+            offset = 0;
+            return ARCHIVE_OK;
+        }
+
+        int skip()
+        {
+            return current ? ARCHIVE_OK : entries.skip();
+        }
+
+        std::string_view error() const
+        {
+            return current && current->status != ARCHIVE_EOF ? std::string_view(current->failure) : entries.error();
+        }
+
+        uint64_t position() const
+        {
+            return entries.position();
+        }
+
+    private:
+        struct Held
+        {
+            std::unique_ptr<archive_entry, decltype(&archive_entry_free)> entry{ nullptr, archive_entry_free };
+            std::vector<std::byte> data;
+            /* what reading the data ended with */
+            int status = ARCHIVE_EOF;
+            std::string failure;
+            bool sent = false;
+        };
+
+        bool wanted(const Held &entry)
+        {
+            return plan.wants(plan.strip(archive_entry_pathname(entry.entry.get())));
+        }
+
+        bool holdable(archive_entry *entry)
+        {
+            auto name = archive_entry_pathname(entry);
+            if (plan.ready() || !name || archive_entry_filetype(entry) != AE_IFREG || archive_entry_hardlink(entry) ||
+                    !archive_entry_size_is_set(entry) || archive_entry_sparse_count(entry) != 0)
+                return false;
+
+            auto size = archive_entry_size(entry);
+            if (size < 0 || static_cast<uint64_t>(size) > SPILL_LIMIT - held_bytes)
+                return false;
+
+            /* one outside the top-level directory is dealt with by the extraction loop as soon as it comes */
+            bool outside = false;
+            auto relative = plan.strip(name, outside);
+            return !outside && !plan.wants(relative);
+        }
+
+        void hold(archive_entry *entry)
+        {
+            Held &out = held.emplace_back();
+            out.entry.reset(archive_entry_clone(entry));
+            out.data.reserve(static_cast<size_t>(archive_entry_size(entry)));
+            while (true)
+            {
+                const void *buffer;
+                size_t size;
+                int64_t offset;
+                auto r = entries.read_block(buffer, size, offset);
+                if (r == ARCHIVE_EOF)
+                    break;
+                if (r != ARCHIVE_OK)
+                {
+                    out.status = r;
+                    out.failure = entries.error();
+                    break;
+                }
+                if (static_cast<uint64_t>(offset) > out.data.size())
+                    out.data.resize(static_cast<size_t>(offset));
+                auto bytes = static_cast<const std::byte *>(buffer);
+                out.data.insert(out.data.end(), bytes, bytes + size);
+            }
+
+            held_bytes += out.data.size();
+            held_names.emplace(archive_entry_pathname(entry));
+        }
+
+        int emit(archive_entry *&out)
+        {
+            current.emplace(std::move(held.front()));
+            held.pop_front();
+            held_bytes -= current->data.size();
+            held_names.erase(held_names.find(archive_entry_pathname(current->entry.get())));
+            out = current->entry.get();
+            return ARCHIVE_OK;
+        }
+
+        Entries &entries;
+        LaunchPlan &plan;
+        std::deque<Held> held;
+        std::unordered_multiset<std::string> held_names;
+        uint64_t held_bytes = 0;
+        std::optional<Held> current;
+        /* read from `entries` while what was held before it is still being handed out */
+        archive_entry *pending = nullptr;
+        bool flushing = false;
+        /* the code `entries` ended with, once it has */
+        int ended = ARCHIVE_OK;
+        uint64_t generation = UINT64_MAX;
+    };
+
+    /* writes `data`, which is mapped from offset `from` of `in`, to the start of `out`. the kernel copies
+     * it when it can, sharing extents on filesystems that support that */
+    bool copy_mapped(int in, int64_t from, std::span<const std::byte> data, int out)
+    {
+        auto at = static_cast<loff_t>(from);
+        uint64_t copied = 0;
+        while (copied < data.size())
+        {
+            auto n = copy_file_range(in, &at, out, nullptr, data.size() - copied, 0);
+            if (n <= 0)
+                break;
+            copied += static_cast<uint64_t>(n);
+        }
+
+        /* filesystems and kernels that cannot copy ranges get an ordinary write out of the mapping */
+        while (copied < data.size())
+        {
+            auto n = pwrite(out, data.data() + copied, data.size() - copied, static_cast<off_t>(copied));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            copied += static_cast<uint64_t>(n);
+        }
+        return copied == data.size();
+    }
+
+    /* an uncompressed tar on a mapping hands out data blocks that point straight into the file, so the
+     * first block shows where an entry's data starts. the kernel then copies the whole entry into place,
+     * sharing extents on filesystems that can, and libarchive skips over it. returns false, having
+     * written nothing that the ordinary path would not overwrite, when that does not work out */
+    bool copy_range(const InputSource &source, archive_entry *entry, const void *first, int64_t offset)
+    {
+        auto file = source.contents();
+        if (!file || source.descriptor() < 0 || offset != 0 || archive_entry_sparse_count(entry) != 0 ||
+                !archive_entry_size_is_set(entry))
+            return false;
+
+        auto size = static_cast<uint64_t>(archive_entry_size(entry));
+        auto start = static_cast<const std::byte *>(first);
+        if (size < COPY_RANGE_MIN || start < file->data() || start >= file->data() + file->size() ||
+                size > static_cast<uint64_t>(file->data() + file->size() - start))
+            return false;
+
+        int out = open(archive_entry_pathname(entry), O_WRONLY | O_CLOEXEC);
+        if (out < 0)
+            return false;
+
+        auto copied = copy_mapped(source.descriptor(), start - file->data(), std::span(start, size), out);
+        close(out);
+        return copied;
+    }
+
+    /* past this, a member that looks like an archive is written out like any other file */
+    constexpr int NESTED_DEPTH_MAX = 4;
+
+    /* BINARY is one file on its own, however it is compressed, so it never has members to unpack */
+    bool has_members(ArchiveFormat format)
+    {
+        return format != ArchiveFormat::BINARY && format != ArchiveFormat::UNKNOWN;
+    }
+
+    bool wants_nested(const ExtractJob &job, std::string_view member)
+    {
+        if (!job.nested || job.depth >= NESTED_DEPTH_MAX)
+            return false;
+        if (job.nested->by_name && has_members(detect_format(fs::path(member))))
+            return true;
+
+        std::string name(member);
+        return std::ranges::any_of(job.nested->patterns,
+                [&](const std::string &pattern) { return fnmatch(pattern.c_str(), name.c_str(), 0) == 0; });
+    }
+
+    /* one member's data, as the input of the reader for the archive inside it. positions are those of
+     * the outer archive's own input, so progress carries on across the nesting. until that reader has
+     * read a header, everything taken from the outer archive is also kept in `tee`, `first` included */
+    template <typename Entries>
+    class MemberSource final : public InputSource
+    {
+    public:
+        MemberSource(Entries &entries, archive_entry *entry, std::span<const std::byte> first, MemberTee &tee) :
+            entries(entries), tee(tee), block(first),
+            length(archive_entry_size_is_set(entry) ? std::optional(archive_entry_size(entry)) : std::nullopt)
+        {
+            tee.data.assign(first.begin(), first.end());
+        }
+
+        std::expected<std::span<const std::byte>, std::string> read() override
+        {
+            if (block.empty() && !finished)
+            {
+                const void *buffer;
+                size_t size;
+                int64_t offset;
+                auto r = entries.read_block(buffer, size, offset);
+                if (r == ARCHIVE_EOF)
+                {
+                    finished = true;
+                    tee.ended = true;
+                }
+                else if (r != ARCHIVE_OK)
+                    return std::unexpected(std::string(entries.error()));
+                else
+                {
+                    block = std::span(static_cast<const std::byte *>(buffer), size);
+                    at = static_cast<uint64_t>(offset);
+                    if (!tee.opened)
+                    {
+                        tee.data.resize(std::max<uint64_t>(tee.data.size(), at));
+                        tee.data.insert(tee.data.end(), block.begin(), block.end());
+                    }
+                }
+            }
+
+            /* holes in a sparse member read as zeros */
+            if (!block.empty() && at > produced)
+            {
+                auto zeros = std::span(ZEROS).first(std::min<uint64_t>(at - produced, ZEROS.size()));
+                produced += zeros.size();
+                return zeros;
+            }
+
+            auto out = block;
+            produced += out.size();
+            at += out.size();
+            block = {};
+            return out;
+        }
+
+        std::expected<uint64_t, std::string> seek(int64_t, int) override
+        {
+            return std::unexpected("Cannot seek in an archive member");
+        }
+
+        bool seekable() const override
+        {
+            return false;
+        }
+
+        std::optional<uint64_t> size() const override
+        {
+            return length;
+        }
+
+        uint64_t position() const override
+        {
+            return entries.position();
+        }
+
+        std::string_view kind() const override
+        {
+            return "member";
+        }
+
+    private:
+        Entries &entries;
+        MemberTee &tee;
+        std::span<const std::byte> block;
+        std::optional<uint64_t> length;
+        uint64_t at = 0;
+        uint64_t produced = 0;
+        bool finished = false;
+    };
+
+    archive *open_disk_writer()
+    {
+        archive *ext = archive_write_disk_new();
+        if (ext)
+            archive_write_disk_set_options(
+                ext, ARCHIVE_EXTRACT_TIME | ARCHIVE_EXTRACT_PERM | ARCHIVE_EXTRACT_ACL | ARCHIVE_EXTRACT_FFLAGS);
+        return ext;
+    }
+
+    template <typename Policy, typename Entries>
+    std::expected<ExtractStats, std::string> extract_entries(Entries &entries, const InputSource &source,
+            const ExtractJob &job)
+    {
+        archive *ext = open_disk_writer();
+        if (!ext)
+            return std::unexpected("Failed to create archive objects");
+
+        auto files = job.files;
+        ExtractStats stats;
+        EntryPaths paths(job.dest_path);
+        std::vector<std::pair<size_t, std::string>> hardlinks;
+
+        /* launch-first extraction leaves out the top-level directory as it goes, and a streamed archive's
+         * is only a guess from its first entry. when a later entry shows the guess wrong, what is on disk
+         * is moved back into that directory, as an ordinary install would have left it */
+        auto restore_top = [&]() -> std::expected<std::string, std::string> {
+            auto top = job.launch->drop_prefix();
+            archive_write_close(ext);
+            archive_write_free(ext);
+            ext = open_disk_writer();
+            if (!ext)
+                return std::unexpected("Failed to create archive objects");
+
+            std::error_code ec;
+            auto aside = job.dest_path;
+            aside += ".install-app-top";
+            fs::rename(job.dest_path, aside, ec);
+            if (!ec)
+                fs::create_directory(job.dest_path, ec);
+            if (!ec)
+                fs::rename(aside, job.dest_path / top, ec);
+            if (ec)
+                return std::unexpected(std::format("Failed to move the extracted files into {}: {}",
+                        (job.dest_path / top).string(), ec.message()));
+
+            paths.rebase(top);
+            if (files)
+            {
+                for (auto &file : *files)
+                    file.path.insert(0, top + "/");
+            }
+            for (auto &[index, target] : hardlinks)
+                target.insert(0, top + "/");
+            return top;
+        };
+        /* inside a member, what this reader writes is noted down by its outermost new path, so that all
+         * of it can be taken away again when the archive turns out damaged part way through */
+        auto note_created = [&](std::string_view relative) {
+            auto &member = *job.member;
+            auto at = job.dest_path;
+            for (const auto &part : fs::path(relative))
+            {
+                at /= part;
+                if (member.existing.contains(at.string()))
+                    continue;
+                std::error_code ec;
+                member.existing.insert(at.string());
+                if (!fs::exists(fs::symlink_status(at, ec)))
+                {
+                    member.created.push_back(at);
+                    return;
+                }
+            }
+        };
+
+        std::string failure;
+        archive_entry *entry = {};
+        int r;
+        while (true)
+        {
+            auto header_start = trace::enabled() ? trace::now() : 0;
+            {
+                memstats::Attribute charge(memstats::decompression);
+                r = entries.next(entry);
+            }
+
+            if (r != ARCHIVE_OK)
+            {
+                /* a member with no header to read is no archive, and is written out as it is instead. one
+                 * that breaks off later is a damaged archive, which the member's reader undoes */
+                if (job.member && (r == ARCHIVE_FATAL || (r != ARCHIVE_EOF && !job.member->opened)))
+                {
+                    failure = entries.error();
+                    break;
+                }
+                if (r != ARCHIVE_EOF)
+                    warn("Archive read header: {}", entries.error());
+                if (r == ARCHIVE_FAILED)
+                    continue;
+                break;
+            }
+
+            /* the member is an archive, so its copy is no longer needed */
+            if (job.member && !job.member->opened)
+            {
+                job.member->opened = true;
+                std::vector<std::byte>().swap(job.member->data);
+            }
+
+            const char *current_file = archive_entry_pathname(entry);
+            auto entry_id = trace::begin_entry(current_file);
+            if (header_start != 0)
+                trace::record(TraceKind::HEADER, header_start, trace::now(), entry_id);
+
+            std::string_view name = current_file ? current_file : "";
+            if (job.launch && current_file)
+            {
+                bool outside = false;
+                name = job.launch->strip(name, outside);
+                if (outside)
+                {
+                    auto top = restore_top();
+                    if (!top)
+                    {
+                        failure = top.error();
+                        break;
+                    }
+                    warn("{} is outside {}/, which was taken for the archive's only directory; moved what was "
+                         "extracted so far back into it", current_file, *top);
+                    name = job.launch->strip(current_file);
+                }
+            }
+
+            auto full_path = current_file ? paths.resolve(name) : std::unexpected("has no usable name");
+            if (full_path && archive_entry_filetype(entry) == AE_IFLNK)
+            {
+                auto target = archive_entry_symlink(entry);
+                if (auto checked = paths.add_symlink(target ? target : ""); !checked)
+                    full_path = std::unexpected(checked.error());
+            }
+            if (!full_path)
+            {
+                warn("Skipping {}: {}", current_file ? current_file : "entry", full_path.error());
+                continue;
+            }
+            archive_entry_set_pathname(entry, *full_path);
+
+            /* hardlink targets are archive paths too and would otherwise resolve against the working directory */
+            auto hardlink = archive_entry_hardlink(entry);
+            if (hardlink)
+            {
+                auto target = paths.resolve_link(job.launch ? job.launch->strip(hardlink) : hardlink);
+                if (!target)
+                {
+                    warn("Skipping {}: hardlink target {}", paths.relative(), target.error());
+                    continue;
+                }
+                archive_entry_set_hardlink(entry, *target);
+            }
+
+            const void *buff = nullptr;
+            size_t size = 0;
+            int64_t offset = 0;
+
+            /* the first block decides whether a candidate member looks like an archive, and the reader inside
+             * it whether it is one: a compressed tarball counts once its first tar header has been read. when
+             * it is not, what was read of it is kept and written out first below */
+            std::optional<int> held;
+            bool drained = false;
+            std::vector<std::byte> unread;
+            if (!hardlink && archive_entry_filetype(entry) == AE_IFREG && wants_nested(job, paths.relative()))
+            {
+                {
+                    TraceSpan decode_span(TraceKind::DECODE, entry_id);
+                    memstats::Attribute charge(memstats::decompression);
+                    held = entries.read_block(buff, size, offset);
+                }
+
+                std::span head(static_cast<const std::byte *>(buff), size);
+                auto looks = *held == ARCHIVE_OK && offset == 0 ? sniff_format(head) : ArchiveFormat::UNKNOWN;
+                if (has_members(looks))
+                {
+                    auto member = std::string(paths.relative());
+                    auto slash = member.rfind('/');
+                    auto dir = slash == std::string::npos ? std::string() : member.substr(0, slash + 1);
+                    auto inner_dest = job.dest_path / dir;
+                    fs::create_directories(inner_dest);
+
+                    std::vector<ManifestFile> inner_files;
+                    MemberTee tee;
+                    ExtractJob inner{ job.archive_path, inner_dest, files ? &inner_files : nullptr, nullptr, job.nested,
+                        job.depth + 1, nullptr, &tee };
+                    auto nested = extract_stream(inner,
+                            std::make_unique<MemberSource<Entries>>(entries, entry, head, tee));
+                    if (nested)
+                    {
+                        info("Extracted nested {} archive {}", format_name(nested->format), member);
+                        stats.entries += nested->entries;
+                        stats.files += nested->files;
+                        stats.bytes += nested->bytes;
+                        for (auto &file : inner_files)
+                        {
+                            file.path.insert(0, dir);
+                            files->push_back(std::move(file));
+                        }
+                        if (job.member)
+                        {
+                            for (const auto &path : tee.created)
+                                note_created(path.lexically_relative(job.dest_path).string());
+                        }
+                        continue;
+                    }
+
+                    if (tee.opened)
+                    {
+                        std::error_code ec;
+                        for (const auto &path : tee.created)
+                            fs::remove_all(path, ec);
+                        failure = std::format("Nested archive {} is damaged: {}", member, nested.error());
+                        break;
+                    }
+
+                    info("{} is not a {} archive after all; writing it out as it is", member, format_name(looks));
+                    unread = std::move(tee.data);
+                    buff = unread.data();
+                    size = unread.size();
+                    offset = 0;
+                    held = ARCHIVE_OK;
+                    drained = tee.ended;
+                }
+            }
+
+            if (job.member)
+                note_created(paths.relative());
+
+            stats.entries++;
+            progress::counters.entries.fetch_add(1, std::memory_order_relaxed);
+            {
+                TraceSpan write_span(TraceKind::WRITE, entry_id);
+                memstats::Attribute charge(memstats::pipeline);
+                r = archive_write_header(ext, entry);
+            }
+
+            bool created = r == ARCHIVE_OK;
+            if (!created)
+            {
+                warn("Archive write header: {}", archive_error_string(ext));
+            }
+            else
+            {
+                if (archive_entry_filetype(entry) == AE_IFREG)
+                {
+                    stats.files++;
+                    /* what the app starts from is written first; reserving each file whole keeps it in
+                     * one run of blocks, right after the one before */
+                    if (job.launch && archive_entry_size_is_set(entry) && job.launch->wants(paths.relative()))
+                        preallocate(archive_entry_pathname(entry), static_cast<uint64_t>(archive_entry_size(entry)));
+                }
+
+                /* hashed here, while each block is still in cache from being decoded */
+                std::optional<Sha256> hasher;
+                uint64_t hashed = 0;
+                if (files && archive_entry_filetype(entry) == AE_IFREG)
+                    hasher.emplace();
+
+                /* after the first failed write the rest of the entry is only read past, and one warning
+                 * counts every block that did not make it to disk */
+                std::string write_error;
+                uint64_t unwritten = 0;
+                bool first = true;
+                while (true)
+                {
+                    if (held)
+                    {
+                        r = *held;
+                        held.reset();
+                    }
+                    else if (drained)
+                    {
+                        r = ARCHIVE_EOF;
+                    }
+                    else
+                    {
+                        TraceSpan decode_span(TraceKind::DECODE, entry_id);
+                        memstats::Attribute charge(memstats::decompression);
+                        r = entries.read_block(buff, size, offset);
+                    }
+
+                    if (r != ARCHIVE_OK)
+                    {
+                        if (r != ARCHIVE_EOF)
+                            warn("Archive read data: {}", entries.error());
+                        break;
+                    }
+
+                    TraceSpan write_span(TraceKind::WRITE, entry_id);
+                    memstats::Attribute charge(memstats::pipeline);
+
+                    if constexpr (Policy::COPY_RANGE)
+                    {
+                        if (first && copy_range(source, entry, buff, offset))
+                        {
+                            /* the copy covered the whole entry, which the mapping still holds */
+                            size = static_cast<size_t>(archive_entry_size(entry));
+                            entries.skip();
+                            r = ARCHIVE_EOF;
+                        }
+                    }
+                    first = false;
+
+                    stats.bytes += size;
+                    progress::counters.bytes.fetch_add(size, std::memory_order_relaxed);
+                    if (hasher)
+                    {
+                        auto at = static_cast<uint64_t>(offset);
+                        if (at > hashed)
+                            hash_zeros(*hasher, at - hashed);
+                        hasher->update(std::span(static_cast<const std::byte *>(buff), size));
+                        hashed = std::max(hashed, at + size);
+                    }
+                    progress::counters.consumed.store(entries.position(), std::memory_order_relaxed);
+
+                    if (r == ARCHIVE_EOF)
+                        break;
+                    if (!write_error.empty())
+                        ++unwritten;
+                    else if (archive_write_data_block(ext, buff, size, offset) != ARCHIVE_OK)
+                    {
+                        const char *message = archive_error_string(ext);
+                        write_error = message ? message : "unknown error";
+                        ++unwritten;
+                    }
+                }
+                if (!write_error.empty())
+                    warn("Write error x{} on {}: {}", unwritten, paths.relative(), write_error);
+
+                if (hasher)
+                {
+                    /* a sparse file may end in a hole */
+                    auto size = archive_entry_size_is_set(entry) ? static_cast<uint64_t>(archive_entry_size(entry)) : 0;
+                    if (size > hashed)
+                        hash_zeros(*hasher, size - hashed);
+                    files->push_back({ std::string(paths.relative()), std::max(size, hashed), hasher->finish() });
+                    if (hardlink && std::max(size, hashed) == 0)
+                        hardlinks.emplace_back(files->size() - 1, paths.relative_link());
+                }
+            }
+
+            {
+                TraceSpan metadata_span(TraceKind::METADATA, entry_id);
+                memstats::Attribute charge(memstats::pipeline);
+                archive_write_finish_entry(ext);
+            }
+
+            /* the entry is complete on disk, so the plan can read the libraries it needs out of it */
+            auto type = archive_entry_filetype(entry);
+            if (job.launch && created && (type == AE_IFREG || type == AE_IFLNK))
+            {
+                auto target = archive_entry_symlink(entry);
+                if (job.launch->written(paths.relative(), archive_entry_pathname(entry), target ? target : ""))
+                {
+                    info("Ready to launch: {} (still extracting the rest)",
+                            (job.dest_path / job.launch->executable()).string());
+                    logging::flush();
+                }
+            }
+
+            if (header_start != 0)
+                trace::record(TraceKind::ENTRY, header_start, trace::now(), entry_id);
+        }
+
+        if (ext)
+        {
+            archive_write_close(ext);
+            archive_write_free(ext);
+        }
+        if (!failure.empty())
+            return std::unexpected(failure);
+
+        if (files)
+            settle_files(*files, hardlinks);
+
+        return stats;
+    }
+
+    /* one instantiation per format. `unrecognised` is set when the readers `Policy` registers cannot
+     * open the file at all */
+    template <typename Policy>
+    std::expected<ExtractStats, std::string> extract_as(const ExtractJob &job, bool &unrecognised,
+            std::unique_ptr<InputSource> input = nullptr)
+    {
+        std::expected<std::unique_ptr<InputSource>, std::string> source = std::move(input);
+        if (!*source)
+        {
+            memstats::Attribute charge(memstats::decompression);
+            source = open_input(job.archive_path);
+        }
+
+        if (!source)
+            return std::unexpected(source.error());
+
+        /* the digest is of the file as it is on disk, so it is taken below any decoding */
+        HashingSource *hashing = nullptr;
+        if (job.archive_hash)
+        {
+            auto wrapped = std::make_unique<HashingSource>(std::move(*source), *job.archive_hash);
+            hashing = wrapped.get();
+            *source = std::move(wrapped);
+        }
+
+        auto finish = [&](std::expected<ExtractStats, std::string> result) -> std::expected<ExtractStats, std::string> {
+            if (result && hashing)
+            {
+                if (auto finished = hashing->finish(); !finished)
+                    return std::unexpected(std::format("Failed to read {} for its checksum: {}",
+                            job.archive_path.string(), finished.error()));
+            }
+            return result;
+        };
+
+        /* a nested archive's progress is measured against the outer one's input */
+        if (job.depth == 0)
+            progress::counters.total_input.store((*source)->size().value_or(0), std::memory_order_relaxed);
+
+        /* a zip this reader does not handle goes to libarchive instead */
+        if constexpr (Policy::ZIP_DIRECTORY)
+        {
+            if (auto contents = (*source)->contents())
+            {
+                if (auto directory = zip::read_directory(*contents))
+                {
+                    /* the directory lists every name up front, so launch-first needs no guessing */
+                    if (job.launch)
+                    {
+                        std::vector<std::string_view> names;
+                        names.reserve(directory->size());
+                        for (const auto &entry : *directory)
+                            names.push_back(entry.name);
+                        job.launch->set_contents(names);
+                    }
+
+                    /* the directory also has every size, which an ETA by bytes written can go by */
+                    if (job.depth == 0)
+                    {
+                        uint64_t total = 0;
+                        for (const auto &entry : *directory)
+                        {
+                            if ((entry.mode & S_IFMT) == S_IFREG)
+                                total += entry.size;
+                        }
+                        progress::counters.total_bytes.store(total, std::memory_order_relaxed);
+                    }
+
+                    ZipEntries entries(*contents, std::move(*directory));
+                    if (job.launch)
+                        entries.prioritise(*job.launch);
+                    return finish(extract_entries<Policy>(entries, **source, job));
+                }
+            }
+        }
+
+        if constexpr (Policy::PAYLOAD_OFFSET)
+        {
+            auto head = peek_input(*source);
+            if (!head)
+                return std::unexpected(head.error());
+            auto payload = makeself::find_payload(*head);
+            if (!payload)
+            {
+                unrecognised = true;
+                return std::unexpected("No archive found after the installer script");
+            }
+            *source = offset_input(std::move(*source), payload->offset, payload->size);
+        }
+
+        /* libarchive would inflate with its own zlib filter; decoding here lets the faster backend do it */
+        if constexpr (Policy::GUNZIP)
+            *source = gunzip_input(std::move(*source));
+
+        archive *a = archive_read_new();
+        if (!a)
+            return std::unexpected("Failed to create archive objects");
+        Policy::readers(a);
+
+        int r;
+        {
+            memstats::Attribute charge(memstats::decompression);
+            r = archive_read_open_source(a, **source);
+        }
+
+        if (r != ARCHIVE_OK)
+        {
+            /* the fallback reports a damaged file the same way, so any failure here is worth the retry */
+            unrecognised = true;
+            auto err = std::format("Failed to open archive because: {}", archive_error_string(a));
+            archive_read_free(a);
+            return std::unexpected(err);
+        }
+
+        LibarchiveEntries entries(a, **source);
+        std::expected<ExtractStats, std::string> result;
+        if (job.launch)
+        {
+            SpillEntries spill(entries, *job.launch);
+            result = extract_entries<Policy>(spill, **source, job);
+        }
+        else
+        {
+            result = extract_entries<Policy>(entries, **source, job);
+        }
+
+        archive_read_close(a);
+        archive_read_free(a);
+
+        return finish(std::move(result));
+    }
+
+    std::expected<ExtractStats, std::string> extract_with(ArchiveFormat format, const ExtractJob &job,
+            bool &unrecognised, std::unique_ptr<InputSource> input = nullptr)
+    {
+        switch (format)
+        {
+            case ArchiveFormat::TAR:
+                return extract_as<TarFormat>(job, unrecognised, std::move(input));
+            case ArchiveFormat::TAR_GZ:
+                return extract_as<TarGzFormat>(job, unrecognised, std::move(input));
+            case ArchiveFormat::TAR_BZ2:
+                return extract_as<TarBz2Format>(job, unrecognised, std::move(input));
+            case ArchiveFormat::TAR_XZ:
+                return extract_as<TarXzFormat>(job, unrecognised, std::move(input));
+            case ArchiveFormat::ZIP:
+                return extract_as<ZipFormat>(job, unrecognised, std::move(input));
+            case ArchiveFormat::DEB:
+                return extract_as<DebFormat>(job, unrecognised, std::move(input));
+            case ArchiveFormat::RPM:
+                return extract_as<RpmFormat>(job, unrecognised, std::move(input));
+            case ArchiveFormat::MAKESELF:
+                return extract_as<MakeselfFormat>(job, unrecognised, std::move(input));
+            case ArchiveFormat::BINARY:
+            case ArchiveFormat::UNKNOWN:
+                break;
+        }
+        return extract_as<AnyFormat>(job, unrecognised, std::move(input));
+    }
+
+    /* `input` can only be read once, like a pipe or an archive member: its format comes from its first
+     * bytes rather than a name, and there is no second attempt with the probing reader */
+    std::expected<ExtractStats, std::string> extract_stream(const ExtractJob &job, std::unique_ptr<InputSource> input)
+    {
+        auto head = peek_input(input);
+        if (!head)
+            return std::unexpected(head.error());
+        auto format = sniff_format(*head);
+
+        /* zip keeps its directory at the end, and streaming it through libarchive's local-header reader
+         * would lose the unix modes that are only in the directory. the stream is held in memory instead,
+         * never on disk */
+        if (format == ArchiveFormat::ZIP)
+        {
+            auto buffered = buffer_input(std::move(input));
+            if (!buffered)
+                return std::unexpected(buffered.error());
+            input = std::move(*buffered);
+        }
+
+        bool unrecognised = false;
+        auto result = extract_with(format, job, unrecognised, std::move(input));
+        if (result)
+            result->format = format;
+        return result;
+    }
+}
+
+std::expected<ExtractStats, std::string> extract(const fs::path &archive_path, const fs::path &dest_path,
+        ArchiveFormat format, std::vector<ManifestFile> *files, Sha256 *archive_hash, const NestedArchives *nested,
+        LaunchPlan *launch)
+{
+    ExtractJob job{ archive_path, dest_path, files, archive_hash, nested && nested->enabled() ? nested : nullptr, 0,
+        launch };
+
+    if (is_standard_input(archive_path))
+    {
+        auto input = open_input(archive_path);
+        if (!input)
+            return std::unexpected(input.error());
+        return extract_stream(job, std::move(*input));
+    }
+
+    bool unrecognised = false;
+    auto result = extract_with(format, job, unrecognised);
+
+    /* a file named for one format but holding another still extracts, through the probing reader */
+    if (unrecognised && format != ArchiveFormat::UNKNOWN)
+    {
+        if (archive_hash)
+            *archive_hash = Sha256();
+        format = ArchiveFormat::UNKNOWN;
+        result = extract_with(format, job, unrecognised);
+    }
+
+    if (result)
+        result->format = format;
+    return result;
+}
+
+std::expected<ExtractStats, std::string> extract_binary(const fs::path &archive_path, const fs::path &dest_file,
+        bool &not_binary, Sha256 *file_hash, Sha256 *archive_hash)
+{
+    std::expected<std::unique_ptr<InputSource>, std::string> source;
+    {
+        memstats::Attribute charge(memstats::decompression);
+        source = open_input(archive_path);
+    }
+    if (!source)
+        return std::unexpected(source.error());
+
+    HashingSource *hashing = nullptr;
+    if (archive_hash)
+    {
+        auto wrapped = std::make_unique<HashingSource>(std::move(*source), *archive_hash);
+        hashing = wrapped.get();
+        *source = std::move(wrapped);
+    }
+    progress::counters.total_input.store((*source)->size().value_or(0), std::memory_order_relaxed);
+
+    int out = open(dest_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0755);
+    if (out < 0)
+        return std::unexpected(std::format("Failed to create {}: {}", dest_file.string(), std::strerror(errno)));
+
+    auto fail = [&](std::string message) -> std::expected<ExtractStats, std::string> {
+        close(out);
+        unlink(dest_file.c_str());
+        return std::unexpected(std::move(message));
+    };
+    auto wrong_kind = [&](std::span<const std::byte> head) {
+        not_binary = !is_executable(head) ||
+                     (head.size() > 262 && std::memcmp(head.data() + 257, "ustar", 5) == 0);
+        return not_binary;
+    };
+
+    ExtractStats stats{ .entries = 1, .files = 1, .bytes = 0, .format = ArchiveFormat::BINARY };
+    auto contents = (*source)->contents();
+    if (contents && (*source)->descriptor() >= 0 && is_executable(*contents))
+    {
+        /* a bare binary on a mapping needs no decoding at all */
+        memstats::Attribute charge(memstats::pipeline);
+        if (!copy_mapped((*source)->descriptor(), 0, *contents, out))
+            return fail(std::format("Failed to write {}: {}", dest_file.string(), std::strerror(errno)));
+        if (file_hash)
+            file_hash->update(*contents);
+        stats.bytes = contents->size();
+    }
+    else
+    {
+        /* anything compressed comes out of libarchive's raw format as a single entry. gzip goes
+         * through `inflater` first, like a `.tar.gz` */
+        *source = gunzip_input(std::move(*source));
+        archive *a = archive_read_new();
+        if (!a)
+            return fail("Failed to create archive objects");
+        archive_read_support_format_raw(a);
+        archive_read_support_filter_bzip2(a);
+        archive_read_support_filter_xz(a);
+        archive_read_support_filter_lzma(a);
+        archive_read_support_filter_zstd(a);
+
+        archive_entry *entry = nullptr;
+        int r;
+        {
+            memstats::Attribute charge(memstats::decompression);
+            r = archive_read_open_source(a, **source);
+            if (r == ARCHIVE_OK)
+                r = archive_read_next_header(a, &entry);
+        }
+
+        std::string error;
+        bool first = true;
+        while (r == ARCHIVE_OK)
+        {
+            const void *buffer;
+            size_t size;
+            la_int64_t offset;
+            {
+                memstats::Attribute charge(memstats::decompression);
+                r = archive_read_data_block(a, &buffer, &size, &offset);
+            }
+            if (r != ARCHIVE_OK)
+                break;
+
+            std::span block(static_cast<const std::byte *>(buffer), size);
+            if (first && wrong_kind(block))
+                break;
+            first = false;
+
+            memstats::Attribute charge(memstats::pipeline);
+            if (file_hash)
+                file_hash->update(block);
+            for (size_t written = 0; written < size;)
+            {
+                auto n = pwrite(out, block.data() + written, size - written,
+                        static_cast<off_t>(offset) + static_cast<off_t>(written));
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                {
+                    error = std::format("Failed to write {}: {}", dest_file.string(), std::strerror(errno));
+                    break;
+                }
+                written += static_cast<size_t>(n);
+            }
+            if (!error.empty())
+                break;
+
+            stats.bytes += size;
+            progress::counters.bytes.fetch_add(size, std::memory_order_relaxed);
+            progress::counters.consumed.store((*source)->position(), std::memory_order_relaxed);
+        }
+
+        if (error.empty() && r != ARCHIVE_EOF && !not_binary)
+            error = std::format("Failed to decompress {}: {}", archive_path.string(), archive_error_string(a));
+        /* an empty file is not an executable either */
+        if (first && error.empty())
+            not_binary = true;
+        archive_read_free(a);
+
+        if (!error.empty())
+            return fail(std::move(error));
+        if (not_binary)
+            return fail(std::format("{} is not a single executable", archive_path.string()));
+    }
+
+    /* the umask may have taken bits off the mode `open` asked for */
+    fchmod(out, 0755);
+    close(out);
+    progress::counters.entries.fetch_add(1, std::memory_order_relaxed);
+
+    if (hashing)
+    {
+        if (auto finished = hashing->finish(); !finished)
+            return std::unexpected(std::format("Failed to read {} for its checksum: {}", archive_path.string(),
+                    finished.error()));
+    }
+    return stats;
+}
+
+bool is_executable(std::span<const std::byte> head)
+{
+    auto starts_with = [&](std::string_view magic) {
+        return head.size() >= magic.size() && std::memcmp(head.data(), magic.data(), magic.size()) == 0;
+    };
+    return starts_with("\x7f" "ELF") || starts_with("#!");
+}
+
+ArchiveFormat sniff_format(std::span<const std::byte> head)
+{
+    auto starts_with = [&](std::string_view magic, size_t at = 0) {
+        return head.size() >= at + magic.size() &&
+               std::memcmp(head.data() + at, magic.data(), magic.size()) == 0;
+    };
+
+    if (starts_with("\x1f\x8b"))
+        return ArchiveFormat::TAR_GZ;
+    if (starts_with("BZh"))
+        return ArchiveFormat::TAR_BZ2;
+    if (starts_with({ "\xfd" "7zXZ\0", 6 }))
+        return ArchiveFormat::TAR_XZ;
+    /* a local header, or the end record alone for an empty archive */
+    if (starts_with("PK\x03\x04") || starts_with("PK\x05\x06"))
+        return ArchiveFormat::ZIP;
+    if (starts_with("!<arch>\n"))
+        return ArchiveFormat::DEB;
+    if (starts_with("\xed\xab\xee\xdb"))
+        return ArchiveFormat::RPM;
+    /* POSIX and GNU tar both put `ustar` in the first header */
+    if (starts_with("ustar", 257))
+        return ArchiveFormat::TAR;
+    if (starts_with("#!") && makeself::find_payload(head))
+        return ArchiveFormat::MAKESELF;
+    if (starts_with("\x7f" "ELF"))
+        return ArchiveFormat::BINARY;
+
+    return ArchiveFormat::UNKNOWN;
+}
+
+ArchiveFormat sniff_format(const fs::path &path)
+{
+    /* enough for a makeself script with a licence pasted into it */
+    constexpr size_t HEAD = 1024 * 1024;
+    auto input = open_input(path);
+    if (!input)
+        return ArchiveFormat::UNKNOWN;
+    auto head = peek_input(*input);
+    return head ? sniff_format(head->first(std::min(head->size(), HEAD))) : ArchiveFormat::UNKNOWN;
+}
+
+ArchiveFormat detect_format(const fs::path &path)
+{
+    static constexpr auto suffixes = perfect_map<ArchiveFormat>({
+        { ".tar.gz", ArchiveFormat::TAR_GZ },
+        { ".tgz", ArchiveFormat::TAR_GZ },
+        { ".tar.bz2", ArchiveFormat::TAR_BZ2 },
+        { ".tbz2", ArchiveFormat::TAR_BZ2 },
+        { ".tar.xz", ArchiveFormat::TAR_XZ },
+        { ".txz", ArchiveFormat::TAR_XZ },
+        { ".tar", ArchiveFormat::TAR },
+        { ".zip", ArchiveFormat::ZIP },
+        { ".deb", ArchiveFormat::DEB },
+        { ".rpm", ArchiveFormat::RPM },
+        { ".run", ArchiveFormat::MAKESELF },
+        { ".gz", ArchiveFormat::BINARY },
+        { ".xz", ArchiveFormat::BINARY },
+        { ".bz2", ArchiveFormat::BINARY },
+        { ".zst", ArchiveFormat::BINARY },
+    });
+
+    /* the two-part suffix first, so `.tar.gz` wins over `.gz`. a split archive's volumes are named for
+     * the whole */
+    auto filename = names::filename(path);
+    filename.remove_suffix(names::volume_suffix(filename).size());
+    if (auto format = suffixes.find(names::suffix(filename, 2)))
+        return *format;
+    if (auto format = suffixes.find(names::suffix(filename, 1)))
+        return *format;
+
+    return ArchiveFormat::UNKNOWN;
+}
+
+std::string_view format_name(ArchiveFormat format)
+{
+    switch (format)
+    {
+        case ArchiveFormat::TAR:
+            return "tar";
+        case ArchiveFormat::TAR_GZ:
+            return "tar.gz";
+        case ArchiveFormat::TAR_BZ2:
+            return "tar.bz2";
+        case ArchiveFormat::TAR_XZ:
+            return "tar.xz";
+        case ArchiveFormat::ZIP:
+            return "zip";
+        case ArchiveFormat::DEB:
+            return "deb";
+        case ArchiveFormat::RPM:
+            return "rpm";
+        case ArchiveFormat::MAKESELF:
+            return "makeself";
+        case ArchiveFormat::BINARY:
+            return "binary";
+        case ArchiveFormat::UNKNOWN:
+            break;
+    }
+
+    return "unknown";
+}
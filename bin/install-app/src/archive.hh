@@ -0,0 +1,86 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "manifest.hh"
+
+class LaunchPlan;
+
+enum class ArchiveFormat
+{
+    TAR,
+    TAR_GZ,
+    TAR_BZ2,
+    TAR_XZ,
+    ZIP,
+    DEB,
+    RPM,
+    /* a shell script with a tarball appended, such as makeself writes */
+    MAKESELF,
+    /* one executable on its own, bare or compressed by itself (`kubectl.gz`, `tool.xz`, an AppImage) */
+    BINARY,
+    UNKNOWN
+};
+
+struct ExtractStats
+{
+    uint64_t entries = 0;
+    uint64_t files = 0;
+    uint64_t bytes = 0;
+    /* what the archive was read as: the format sniffed from standard input, or UNKNOWN when only the
+     * probing reader could open it */
+    ArchiveFormat format = ArchiveFormat::UNKNOWN;
+};
+
+/* archive members that are archives themselves, extracted in place of being written out. either way
+ * the member's first bytes must look like a format this tool reads */
+struct NestedArchives
+{
+    /* members named like one of the supported formats */
+    bool by_name = false;
+    /* members whose path in the archive matches one of these `fnmatch` patterns, whatever they are called */
+    std::vector<std::string> patterns;
+
+    bool enabled() const
+    {
+        return by_name || !patterns.empty();
+    }
+};
+
+ArchiveFormat detect_format(const std::filesystem::path &path);
+bool is_executable(std::span<const std::byte> head);
+/* from the magic bytes at the start of the archive, for input that has no name to go by */
+ArchiveFormat sniff_format(std::span<const std::byte> head);
+/* the same from the start of a file, for names that say nothing, such as a vendor's `.bin` */
+ArchiveFormat sniff_format(const std::filesystem::path &path);
+std::string_view format_name(ArchiveFormat format);
+
+/* `archive_path` may be `-` for standard input, in which case `format` is ignored and taken from the
+ * first bytes. members that `nested` picks out are streamed into a second reader and their contents land
+ * in the member's directory; the member itself is never written. one whose reader cannot read a first
+ * header is written out as it is after all, and one that breaks off after that fails the extraction,
+ * with what it had written taken away again. when `files` is given, every regular file is hashed as its
+ * data streams past and listed there with its path relative to `dest_path`. when `archive_hash` is given, the archive file itself is fed
+ * through it on the same read, all of it, including anything extraction never looked at.
+ *
+ * with `launch`, what the plan wants is extracted first (zip in any order, anything streamed through a
+ * bounded spill buffer), the archive's top-level directory is left out on the way, and "Ready to launch"
+ * is logged as soon as the app can be started while the rest keeps coming */
+std::expected<ExtractStats, std::string> extract(const std::filesystem::path &archive_path,
+        const std::filesystem::path &dest_path, ArchiveFormat format, std::vector<ManifestFile> *files = nullptr,
+        Sha256 *archive_hash = nullptr, const NestedArchives *nested = nullptr, LaunchPlan *launch = nullptr);
+
+/* for BINARY: decompresses the file straight to `dest_file`, or has the kernel copy it when it is not
+ * compressed, and makes it executable. the output is hashed into `file_hash` as it is written, and the
+ * input into `archive_hash` as it is read. `not_binary` is set, and nothing is left at `dest_file`,
+ * when what comes out is a tar archive after all or not something that can be run */
+std::expected<ExtractStats, std::string> extract_binary(const std::filesystem::path &archive_path,
+        const std::filesystem::path &dest_file, bool &not_binary, Sha256 *file_hash = nullptr,
+        Sha256 *archive_hash = nullptr);
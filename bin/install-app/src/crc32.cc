@@ -0,0 +1,264 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <array>
+#include <bit>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define INSTALL_APP_CRC_CLMUL 1
+#endif
+#include "crc32.hh"
+
+namespace
+{
+    /* the reflected polynomial of gzip, zip and ethernet */
+    constexpr uint32_t POLYNOMIAL = 0xedb88320;
+
+    using Tables = std::array<std::array<uint32_t, 256>, 8>;
+
+    /* `TABLES[k][b]` is the CRC of byte `b` followed by `k` zero bytes */
+    constexpr Tables make_tables()
+    {
+        Tables tables = {};
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit)
+                value = (value >> 1) ^ (POLYNOMIAL & (0u - (value & 1)));
+            tables[0][i] = value;
+        }
+        for (size_t k = 1; k < tables.size(); ++k)
+        {
+            for (size_t i = 0; i < 256; ++i)
+                tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xff];
+        }
+        return tables;
+    }
+
+    constexpr Tables TABLES = make_tables();
+
+    /* slice-by-8: eight table lookups per eight bytes, with no dependency between them */
+    uint32_t portable(uint32_t state, const std::byte *data, size_t length)
+    {
+        for (; length >= 8; data += 8, length -= 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, data, sizeof(word));
+            if constexpr (std::endian::native == std::endian::big)
+                word = std::byteswap(word);
+            word ^= state;
+
+            state = TABLES[7][word & 0xff] ^ TABLES[6][(word >> 8) & 0xff] ^ TABLES[5][(word >> 16) & 0xff]
+                    ^ TABLES[4][(word >> 24) & 0xff] ^ TABLES[3][(word >> 32) & 0xff] ^ TABLES[2][(word >> 40) & 0xff]
+                    ^ TABLES[1][(word >> 48) & 0xff] ^ TABLES[0][word >> 56];
+        }
+
+        for (; length > 0; ++data, --length)
+            state = (state >> 8) ^ TABLES[0][(state ^ static_cast<uint32_t>(*data)) & 0xff];
+        return state;
+    }
+
+#ifdef INSTALL_APP_CRC_CLMUL
+    /* folding constants from Intel's "Fast CRC Computation Using PCLMULQDQ", bit-reflected and shifted
+     * left by one: x^(d+32) and x^(d-32) mod P for a fold across d bits, then x^64 and the Barrett pair */
+    alignas(16) constexpr uint64_t FOLD_2048[2] = { 0x011542778a, 0x01322d1430 };
+    alignas(16) constexpr uint64_t FOLD_512[2] = { 0x0154442bd4, 0x01c6e41596 };
+    alignas(16) constexpr uint64_t FOLD_128[2] = { 0x01751997d0, 0x00ccaa009e };
+    alignas(16) constexpr uint64_t FOLD_64[2] = { 0x0163cd6124, 0x0000000000 };
+    alignas(16) constexpr uint64_t BARRETT[2] = { 0x01db710641, 0x01f7011641 };
+
+    __attribute__((target("pclmul,sse4.1"))) inline __m128i load(const std::byte *at)
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i *>(at));
+    }
+
+    __attribute__((target("pclmul,sse4.1"))) inline __m128i fold(__m128i value, __m128i constants, __m128i next)
+    {
+        auto low = _mm_clmulepi64_si128(value, constants, 0x00);
+        auto high = _mm_clmulepi64_si128(value, constants, 0x11);
+        return _mm_xor_si128(_mm_xor_si128(low, high), next);
+    }
+
+    /* folds the remaining 16-byte blocks into `value` and reduces it to the 32-bit CRC */
+    __attribute__((target("pclmul,sse4.1"))) uint32_t finish(__m128i value, const std::byte *data, size_t length)
+    {
+        auto k3k4 = _mm_load_si128(reinterpret_cast<const __m128i *>(FOLD_128));
+        for (; length >= 16; data += 16, length -= 16)
+            value = fold(value, k3k4, load(data));
+
+        /* 128 bits to 64 */
+        auto mask = _mm_setr_epi32(~0, 0, ~0, 0);
+        auto folded = _mm_clmulepi64_si128(value, k3k4, 0x10);
+        value = _mm_xor_si128(_mm_srli_si128(value, 8), folded);
+
+        auto k5 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(FOLD_64));
+        folded = _mm_srli_si128(value, 4);
+        value = _mm_clmulepi64_si128(_mm_and_si128(value, mask), k5, 0x00);
+        value = _mm_xor_si128(value, folded);
+
+        /* Barrett reduction to 32 */
+        auto barrett = _mm_load_si128(reinterpret_cast<const __m128i *>(BARRETT));
+        auto quotient = _mm_clmulepi64_si128(_mm_and_si128(value, mask), barrett, 0x10);
+        quotient = _mm_clmulepi64_si128(_mm_and_si128(quotient, mask), barrett, 0x00);
+        value = _mm_xor_si128(value, quotient);
+
+        return static_cast<uint32_t>(_mm_extract_epi32(value, 1));
+    }
+
+    /* four 128-bit lanes folded 64 bytes at a time. `length` is at least 64 and a multiple of 16 */
+    __attribute__((target("pclmul,sse4.1"))) uint32_t pclmul(uint32_t state, const std::byte *data, size_t length)
+    {
+        auto x0 = _mm_xor_si128(load(data), _mm_cvtsi32_si128(static_cast<int>(state)));
+        auto x1 = load(data + 16);
+        auto x2 = load(data + 32);
+        auto x3 = load(data + 48);
+        data += 64;
+        length -= 64;
+
+        auto k1k2 = _mm_load_si128(reinterpret_cast<const __m128i *>(FOLD_512));
+        for (; length >= 64; data += 64, length -= 64)
+        {
+            x0 = fold(x0, k1k2, load(data));
+            x1 = fold(x1, k1k2, load(data + 16));
+            x2 = fold(x2, k1k2, load(data + 32));
+            x3 = fold(x3, k1k2, load(data + 48));
+        }
+
+        auto k3k4 = _mm_load_si128(reinterpret_cast<const __m128i *>(FOLD_128));
+        x0 = fold(x0, k3k4, x1);
+        x0 = fold(x0, k3k4, x2);
+        x0 = fold(x0, k3k4, x3);
+        return finish(x0, data, length);
+    }
+
+    __attribute__((target("avx512f,avx512vl,vpclmulqdq,pclmul,sse4.1"))) inline __m512i load_wide(const std::byte *at)
+    {
+        return _mm512_loadu_si512(at);
+    }
+
+    __attribute__((target("avx512f,avx512vl,vpclmulqdq,pclmul,sse4.1"))) inline __m512i fold(__m512i value,
+            __m512i constants, __m512i next)
+    {
+        auto low = _mm512_clmulepi64_epi128(value, constants, 0x00);
+        auto high = _mm512_clmulepi64_epi128(value, constants, 0x11);
+        return _mm512_ternarylogic_epi64(low, high, next, 0x96);
+    }
+
+    /* the same folding, sixteen 128-bit lanes at a time in four zmm registers. `length` is at least 256
+     * and a multiple of 16 */
+    __attribute__((target("avx512f,avx512vl,vpclmulqdq,pclmul,sse4.1"))) uint32_t vpclmul(uint32_t state,
+            const std::byte *data, size_t length)
+    {
+        auto z0 = _mm512_xor_si512(load_wide(data),
+                _mm512_zextsi128_si512(_mm_cvtsi32_si128(static_cast<int>(state))));
+        auto z1 = load_wide(data + 64);
+        auto z2 = load_wide(data + 128);
+        auto z3 = load_wide(data + 192);
+        data += 256;
+        length -= 256;
+
+        auto k2048 = _mm512_broadcast_i32x4(_mm_load_si128(reinterpret_cast<const __m128i *>(FOLD_2048)));
+        for (; length >= 256; data += 256, length -= 256)
+        {
+            z0 = fold(z0, k2048, load_wide(data));
+            z1 = fold(z1, k2048, load_wide(data + 64));
+            z2 = fold(z2, k2048, load_wide(data + 128));
+            z3 = fold(z3, k2048, load_wide(data + 192));
+        }
+
+        auto k512 = _mm512_broadcast_i32x4(_mm_load_si128(reinterpret_cast<const __m128i *>(FOLD_512)));
+        z0 = fold(z0, k512, z1);
+        z0 = fold(z0, k512, z2);
+        z0 = fold(z0, k512, z3);
+        for (; length >= 64; data += 64, length -= 64)
+            z0 = fold(z0, k512, load_wide(data));
+
+        auto k3k4 = _mm_load_si128(reinterpret_cast<const __m128i *>(FOLD_128));
+        auto x = _mm512_castsi512_si128(z0);
+        x = fold(x, k3k4, _mm512_extracti32x4_epi32(z0, 1));
+        x = fold(x, k3k4, _mm512_extracti32x4_epi32(z0, 2));
+        x = fold(x, k3k4, _mm512_extracti32x4_epi32(z0, 3));
+        return finish(x, data, length);
+    }
+#endif
+
+    crc::Implementation select_implementation()
+    {
+#ifdef INSTALL_APP_CRC_CLMUL
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("vpclmulqdq") && __builtin_cpu_supports("avx512f")
+                && __builtin_cpu_supports("avx512vl"))
+            return crc::Implementation::VPCLMUL;
+        if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+            return crc::Implementation::PCLMUL;
+#endif
+        return crc::Implementation::PORTABLE;
+    }
+
+    /* below these sizes setting up the folds costs more than the table lookups it replaces */
+    constexpr size_t PCLMUL_MINIMUM = 64;
+    constexpr size_t VPCLMUL_MINIMUM = 1024;
+}
+
+namespace crc
+{
+    uint32_t crc32(Implementation with, uint32_t value, std::span<const std::byte> data)
+    {
+        uint32_t state = ~value;
+        auto at = data.data();
+        auto length = data.size();
+
+#ifdef INSTALL_APP_CRC_CLMUL
+        if (with == Implementation::VPCLMUL && length >= VPCLMUL_MINIMUM)
+        {
+            auto blocks = length & ~size_t(15);
+            state = vpclmul(state, at, blocks);
+            at += blocks;
+            length -= blocks;
+        }
+        else if (with != Implementation::PORTABLE && length >= PCLMUL_MINIMUM)
+        {
+            auto blocks = length & ~size_t(15);
+            state = pclmul(state, at, blocks);
+            at += blocks;
+            length -= blocks;
+        }
+#else
+        (void)with;
+#endif
+
+        return ~portable(state, at, length);
+    }
+
+    uint32_t crc32(uint32_t value, std::span<const std::byte> data)
+    {
+        return crc32(implementation(), value, data);
+    }
+
+    Implementation implementation()
+    {
+        static const Implementation selected = select_implementation();
+        return selected;
+    }
+
+    std::string_view implementation_name(Implementation with)
+    {
+        switch (with)
+        {
+            case Implementation::PORTABLE:
+                return "slice-by-8";
+            case Implementation::PCLMUL:
+                return "pclmulqdq";
+            case Implementation::VPCLMUL:
+                return "vpclmulqdq";
+        }
+        return "unknown";
+    }
+
+    bool available(Implementation with)
+    {
+        auto selected = implementation();
+        return with == Implementation::PORTABLE || with == selected
+               || (with == Implementation::PCLMUL && selected == Implementation::VPCLMUL);
+    }
+}
@@ -0,0 +1,29 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+/* the CRC-32 of gzip and zip. carry-less multiply folds 64 or 256 bytes per step where the CPU has
+ * PCLMULQDQ or VPCLMULQDQ; everything else uses slice-by-8 tables. the choice is made once, on first
+ * use */
+namespace crc
+{
+    enum class Implementation
+    {
+        PORTABLE,
+        PCLMUL,
+        VPCLMUL
+    };
+
+    /* continues `value`, the CRC of everything before `data`; start from 0 */
+    uint32_t crc32(uint32_t value, std::span<const std::byte> data);
+    uint32_t crc32(Implementation with, uint32_t value, std::span<const std::byte> data);
+
+    Implementation implementation();
+    std::string_view implementation_name(Implementation with);
+    bool available(Implementation with);
+}
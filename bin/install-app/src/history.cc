@@ -0,0 +1,299 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <algorithm>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <map>
+#include <print>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include "history.hh"
+#include "json.hh"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    struct FormatSummary
+    {
+        uint64_t runs = 0;
+        std::map<std::string, uint64_t> outcomes;
+        uint64_t archive_bytes = 0;
+        uint64_t bytes = 0;
+        uint64_t files = 0;
+        double duration = 0;
+        double extract_seconds = 0;
+        std::map<std::string, double> phases;
+        std::vector<double> rates;
+    };
+
+    std::map<std::string, FormatSummary> summarise(std::span<const HistoryRecord> records)
+    {
+        std::map<std::string, FormatSummary> summaries;
+
+        for (const auto &record : records)
+        {
+            auto &summary = summaries[record.format];
+            summary.runs++;
+            summary.outcomes[record.outcome]++;
+            summary.duration += record.duration_seconds;
+
+            for (const auto &[name, seconds] : record.phases)
+                summary.phases[name] += seconds;
+
+            if (record.outcome != "success")
+                continue;
+
+            /* throughput only counts completed installs so failures do not skew it */
+            auto extract_seconds = record.phase_seconds("extract");
+            summary.archive_bytes += record.archive_bytes;
+            summary.bytes += record.bytes;
+            summary.files += record.files;
+            summary.extract_seconds += extract_seconds;
+            if (extract_seconds > 0)
+                summary.rates.push_back(static_cast<double>(record.bytes) / extract_seconds / 1e6);
+        }
+
+        return summaries;
+    }
+
+    std::string label_escape(std::string_view text)
+    {
+        std::string out;
+        for (auto c : text)
+        {
+            if (c == '\\' || c == '"')
+                out += '\\';
+            if (c == '\n')
+            {
+                out += "\\n";
+                continue;
+            }
+            out += c;
+        }
+        return out;
+    }
+
+    std::string record_json(const HistoryRecord &record)
+    {
+        std::string phases;
+        for (const auto &[name, seconds] : record.phases)
+        {
+            if (!phases.empty())
+                phases += ',';
+            phases += std::format("\"{}\":{:.6f}", json_escape(name), seconds);
+        }
+
+        return std::format("{{\"timestamp\":{},\"app\":\"{}\",\"archive\":\"{}\",\"format\":\"{}\",\"outcome\":\"{}\","
+                           "\"archive_bytes\":{},\"bytes\":{},\"files\":{},\"entries\":{},\"duration_seconds\":{:.6f},"
+                           "\"phases\":{{{}}}}}\n",
+                record.timestamp, json_escape(record.app), json_escape(record.archive), json_escape(record.format),
+                json_escape(record.outcome), record.archive_bytes, record.bytes, record.files, record.entries,
+                record.duration_seconds, phases);
+    }
+}
+
+double HistoryRecord::phase_seconds(std::string_view name) const
+{
+    for (const auto &[phase, seconds] : phases)
+    {
+        if (phase == name)
+            return seconds;
+    }
+    return 0;
+}
+
+fs::path default_state_dir()
+{
+    if (auto state = std::getenv("XDG_STATE_HOME"); state && *state)
+        return fs::path(state) / "install-app";
+    if (auto home = std::getenv("HOME"); home && *home)
+        return fs::path(home) / ".local" / "state" / "install-app";
+    return {};
+}
+
+fs::path default_history_path()
+{
+    auto dir = default_state_dir();
+    return dir.empty() ? dir : dir / "history.jsonl";
+}
+
+bool append_history(const fs::path &path, const HistoryRecord &record)
+{
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+
+    /* a single O_APPEND write keeps lines intact when several installs finish at once */
+    auto line = record_json(record);
+    auto written = write(fd, line.data(), line.size());
+    close(fd);
+
+    return written == static_cast<ssize_t>(line.size());
+}
+
+std::vector<HistoryRecord> load_history(const fs::path &path)
+{
+    std::vector<HistoryRecord> records;
+    std::ifstream file(path);
+    std::string line;
+
+    while (std::getline(file, line))
+    {
+        auto doc = json_parse(line);
+        if (!doc || !doc->object())
+            continue;
+
+        auto field = [&](std::string_view key) -> const JsonValue &
+        {
+            static const JsonValue missing;
+            auto value = doc->find(key);
+            return value ? *value : missing;
+        };
+
+        HistoryRecord record;
+        record.timestamp = static_cast<int64_t>(field("timestamp").number());
+        record.app = field("app").string();
+        record.archive = field("archive").string();
+        record.format = field("format").string("unknown");
+        record.outcome = field("outcome").string("unknown");
+        record.archive_bytes = static_cast<uint64_t>(field("archive_bytes").number());
+        record.bytes = static_cast<uint64_t>(field("bytes").number());
+        record.files = static_cast<uint64_t>(field("files").number());
+        record.entries = static_cast<uint64_t>(field("entries").number());
+        record.duration_seconds = field("duration_seconds").number();
+
+        if (auto phases = field("phases").object())
+        {
+            for (const auto &[name, seconds] : *phases)
+                record.phases.emplace_back(name, seconds.number());
+        }
+
+        records.push_back(std::move(record));
+    }
+
+    return records;
+}
+
+bool write_metrics_textfile(const fs::path &path, std::span<const HistoryRecord> records)
+{
+    auto summaries = summarise(records);
+    std::string out;
+
+    auto metric = [&](std::string_view name, std::string_view type, std::string_view help)
+    {
+        out += std::format("# HELP {} {}\n# TYPE {} {}\n", name, help, name, type);
+    };
+
+    metric("install_app_runs_total", "counter", "Install runs by archive format and outcome.");
+    for (const auto &[format, summary] : summaries)
+    {
+        for (const auto &[outcome, count] : summary.outcomes)
+            out += std::format("install_app_runs_total{{format=\"{}\",outcome=\"{}\"}} {}\n", label_escape(format),
+                    label_escape(outcome), count);
+    }
+
+    metric("install_app_bytes_total", "counter", "Uncompressed bytes extracted by successful installs.");
+    for (const auto &[format, summary] : summaries)
+        out += std::format("install_app_bytes_total{{format=\"{}\"}} {}\n", label_escape(format), summary.bytes);
+
+    metric("install_app_archive_bytes_total", "counter", "Compressed archive bytes consumed by successful installs.");
+    for (const auto &[format, summary] : summaries)
+        out += std::format("install_app_archive_bytes_total{{format=\"{}\"}} {}\n", label_escape(format),
+                summary.archive_bytes);
+
+    metric("install_app_files_total", "counter", "Files written by successful installs.");
+    for (const auto &[format, summary] : summaries)
+        out += std::format("install_app_files_total{{format=\"{}\"}} {}\n", label_escape(format), summary.files);
+
+    metric("install_app_duration_seconds", "summary", "Wall time of install runs.");
+    for (const auto &[format, summary] : summaries)
+    {
+        out += std::format("install_app_duration_seconds_sum{{format=\"{}\"}} {:.6f}\n", label_escape(format),
+                summary.duration);
+        out += std::format("install_app_duration_seconds_count{{format=\"{}\"}} {}\n", label_escape(format),
+                summary.runs);
+    }
+
+    metric("install_app_phase_duration_seconds_total", "counter", "Wall time spent in each install phase.");
+    for (const auto &[format, summary] : summaries)
+    {
+        for (const auto &[phase, seconds] : summary.phases)
+            out += std::format("install_app_phase_duration_seconds_total{{format=\"{}\",phase=\"{}\"}} {:.6f}\n",
+                    label_escape(format), label_escape(phase), seconds);
+    }
+
+    if (!records.empty())
+    {
+        const auto &last = records.back();
+        metric("install_app_last_run_timestamp_seconds", "gauge", "Unix time of the most recent install run.");
+        out += std::format("install_app_last_run_timestamp_seconds{{app=\"{}\",format=\"{}\",outcome=\"{}\"}} {}\n",
+                label_escape(last.app), label_escape(last.format), label_escape(last.outcome), last.timestamp);
+        metric("install_app_last_run_duration_seconds", "gauge", "Wall time of the most recent install run.");
+        out += std::format("install_app_last_run_duration_seconds{{app=\"{}\",format=\"{}\"}} {:.6f}\n",
+                label_escape(last.app), label_escape(last.format), last.duration_seconds);
+    }
+
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+
+    /* node_exporter may scrape at any moment, so never let it see a half-written file */
+    auto temp = path;
+    temp += std::format(".{}.tmp", getpid());
+    {
+        std::ofstream file(temp);
+        if (!file || !(file << out))
+            return false;
+    }
+
+    fs::rename(temp, path, ec);
+    if (ec)
+    {
+        fs::remove(temp, ec);
+        return false;
+    }
+
+    return true;
+}
+
+void print_history_stats(std::span<const HistoryRecord> records)
+{
+    if (records.empty())
+    {
+        std::println("No install history recorded yet.");
+        return;
+    }
+
+    auto summaries = summarise(records);
+
+    std::println("{:<8} {:>5} {:>5} {:>6} {:>11} {:>11} {:>9} {:>10} {:>11} {:>10} {:>10}", "format", "runs", "ok",
+            "failed", "archive", "extracted", "files", "MB/s", "median MB/s", "files/s", "avg secs");
+
+    for (const auto &[format, summary] : summaries)
+    {
+        auto rates = summary.rates;
+        std::sort(rates.begin(), rates.end());
+        auto median = rates.empty() ? 0.0 : rates[rates.size() / 2];
+
+        auto seconds = summary.extract_seconds;
+        auto throughput = seconds > 0 ? static_cast<double>(summary.bytes) / seconds / 1e6 : 0.0;
+        auto files_rate = seconds > 0 ? static_cast<double>(summary.files) / seconds : 0.0;
+
+        auto outcome = [&](const std::string &name)
+        {
+            auto it = summary.outcomes.find(name);
+            return it != summary.outcomes.end() ? it->second : 0;
+        };
+
+        std::println("{:<8} {:>5} {:>5} {:>6} {:>8.1f} MB {:>8.1f} MB {:>9} {:>10.1f} {:>11.1f} {:>10.0f} {:>10.2f}",
+                format, summary.runs, outcome("success"), outcome("failed"),
+                static_cast<double>(summary.archive_bytes) / 1e6, static_cast<double>(summary.bytes) / 1e6,
+                summary.files, throughput, median, files_rate,
+                summary.duration / static_cast<double>(summary.runs));
+    }
+}
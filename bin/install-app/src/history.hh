@@ -0,0 +1,39 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct HistoryRecord
+{
+    int64_t timestamp = 0;
+    std::string app;
+    std::string archive;
+    std::string format;
+    std::string outcome;
+    uint64_t archive_bytes = 0;
+    uint64_t bytes = 0;
+    uint64_t files = 0;
+    uint64_t entries = 0;
+    double duration_seconds = 0;
+    std::vector<std::pair<std::string, double>> phases;
+
+    double phase_seconds(std::string_view name) const;
+};
+
+/* `$XDG_STATE_HOME/install-app`, falling back to `~/.local/state`. empty when neither is set */
+std::filesystem::path default_state_dir();
+/* `history.jsonl` in the state directory */
+std::filesystem::path default_history_path();
+
+bool append_history(const std::filesystem::path &path, const HistoryRecord &record);
+std::vector<HistoryRecord> load_history(const std::filesystem::path &path);
+
+/* node_exporter textfile collector output, aggregated over `records`. written atomically via rename */
+bool write_metrics_textfile(const std::filesystem::path &path, std::span<const HistoryRecord> records);
+void print_history_stats(std::span<const HistoryRecord> records);
@@ -0,0 +1,699 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <zlib.h>
+#ifdef INSTALL_APP_HAVE_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+#include "crc32.hh"
+#include "inflate.hh"
+
+namespace
+{
+    constexpr size_t MiB = 1024 * 1024;
+    /* what the streaming decoder hands libarchive per read */
+    constexpr size_t OUTPUT_BLOCK = 1 * MiB;
+    /* gzip files that decode to at most this much are decoded in one go when the backend prefers it.
+     * larger ones stream, so that memory stays bounded and libarchive writes while the rest decodes */
+    constexpr size_t WHOLE_BUFFER_LIMIT = 4 * MiB;
+
+    bool is_gzip(std::span<const std::byte> data)
+    {
+        return data.size() >= 2 && data[0] == std::byte{ 0x1f } && data[1] == std::byte{ 0x8b };
+    }
+
+    /* the length field of the last member's trailer: the decoded size modulo 4 GiB */
+    size_t gzip_size_hint(std::span<const std::byte> data)
+    {
+        if (data.size() < 18)
+            return 0;
+
+        uint32_t size = 0;
+        for (size_t i = 0; i < 4; ++i)
+            size |= static_cast<uint32_t>(data[data.size() - 4 + i]) << (8 * i);
+        return size;
+    }
+
+    std::string zlib_error(const z_stream &stream, int result)
+    {
+        return std::format("Failed to decompress: {}", stream.msg ? stream.msg : zError(result));
+    }
+
+    /* zlib's streaming decoder across any number of gzip members. zlib only inflates; the gzip framing
+     * is read here so that the CRC is taken with `crc::crc32` over each chunk right after it is decoded,
+     * while it is still in cache. anything after the last member that does not start another one is
+     * ignored, as `gzip -d` does */
+    class GzipInflater
+    {
+    public:
+        GzipInflater()
+        {
+            if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+                throw std::bad_alloc();
+        }
+
+        GzipInflater(const GzipInflater &) = delete;
+        GzipInflater &operator=(const GzipInflater &) = delete;
+
+        ~GzipInflater()
+        {
+            inflateEnd(&stream);
+        }
+
+        /* decodes from `in` into `out`, advancing both. true once the input has ended cleanly */
+        std::expected<bool, std::string> decode(std::span<const std::byte> &in, std::span<std::byte> &out,
+                bool input_ended)
+        {
+            while (true)
+            {
+                if (stage == Stage::BETWEEN)
+                {
+                    if (in.empty())
+                        return input_ended;
+                    if (in[0] != std::byte{ 0x1f })
+                        return true;
+                    start_member();
+                }
+
+                if (stage == Stage::BODY && out.empty())
+                    return false;
+                if (in.empty())
+                {
+                    if (input_ended)
+                        return std::unexpected("Failed to decompress: unexpected end of input");
+                    return false;
+                }
+
+                auto step = stage == Stage::BODY ? body(in, out) : stage == Stage::TRAILER ? trailer(in) : header(in);
+                if (!step)
+                    return std::unexpected(step.error());
+            }
+        }
+
+    private:
+        enum class Stage
+        {
+            FIXED,
+            EXTRA_LENGTH,
+            EXTRA,
+            NAME,
+            COMMENT,
+            HEADER_CRC,
+            BODY,
+            TRAILER,
+            BETWEEN
+        };
+
+        static constexpr uint8_t FLAG_HEADER_CRC = 0x02;
+        static constexpr uint8_t FLAG_EXTRA = 0x04;
+        static constexpr uint8_t FLAG_NAME = 0x08;
+        static constexpr uint8_t FLAG_COMMENT = 0x10;
+        /* the most bytes decoded before the CRC catches up, so that it reads them from cache */
+        static constexpr size_t CHUNK = 64 * 1024;
+
+        void start_member()
+        {
+            stage = Stage::FIXED;
+            field_length = 0;
+            header_crc = 0;
+            data_crc = 0;
+            data_size = 0;
+            inflateReset(&stream);
+        }
+
+        /* collects a fixed-size field that may arrive split across blocks; true once it is complete */
+        bool collect(std::span<const std::byte> &in, size_t size)
+        {
+            auto take = std::min(size - field_length, in.size());
+            std::memcpy(field.data() + field_length, in.data(), take);
+            if (stage != Stage::TRAILER && stage != Stage::HEADER_CRC)
+                header_crc = crc::crc32(header_crc, in.first(take));
+            field_length += take;
+            in = in.subspan(take);
+            return field_length == size;
+        }
+
+        uint32_t field_value(size_t size) const
+        {
+            uint32_t value = 0;
+            for (size_t i = 0; i < size; ++i)
+                value |= static_cast<uint32_t>(field[i]) << (8 * i);
+            return value;
+        }
+
+        /* moves to the next optional header field the flags ask for, or to the data */
+        void next_field()
+        {
+            field_length = 0;
+            while (true)
+            {
+                stage = static_cast<Stage>(static_cast<int>(stage) + 1);
+                if ((stage == Stage::EXTRA_LENGTH && (flags & FLAG_EXTRA))
+                        || (stage == Stage::EXTRA && extra_left > 0) || (stage == Stage::NAME && (flags & FLAG_NAME))
+                        || (stage == Stage::COMMENT && (flags & FLAG_COMMENT))
+                        || (stage == Stage::HEADER_CRC && (flags & FLAG_HEADER_CRC)) || stage == Stage::BODY)
+                    return;
+            }
+        }
+
+        std::expected<void, std::string> header(std::span<const std::byte> &in)
+        {
+            switch (stage)
+            {
+                case Stage::FIXED:
+                    if (!collect(in, 10))
+                        return {};
+                    if (!is_gzip(std::span(field).first(2)))
+                        return std::unexpected("Failed to decompress: not a gzip member");
+                    if (field[2] != std::byte{ 8 })
+                        return std::unexpected("Failed to decompress: unknown compression method");
+                    flags = static_cast<uint8_t>(field[3]);
+                    extra_left = 0;
+                    break;
+                case Stage::EXTRA_LENGTH:
+                    if (!collect(in, 2))
+                        return {};
+                    extra_left = field_value(2);
+                    break;
+                case Stage::EXTRA:
+                {
+                    auto take = std::min(extra_left, in.size());
+                    header_crc = crc::crc32(header_crc, in.first(take));
+                    in = in.subspan(take);
+                    extra_left -= take;
+                    if (extra_left > 0)
+                        return {};
+                    break;
+                }
+                case Stage::NAME:
+                case Stage::COMMENT:
+                {
+                    /* zero-terminated, and possibly split across blocks */
+                    auto end = std::find(in.begin(), in.end(), std::byte{ 0 });
+                    auto terminated = end != in.end();
+                    auto take = static_cast<size_t>(end - in.begin()) + (terminated ? 1 : 0);
+                    header_crc = crc::crc32(header_crc, in.first(take));
+                    in = in.subspan(take);
+                    if (!terminated)
+                        return {};
+                    break;
+                }
+                case Stage::HEADER_CRC:
+                    if (!collect(in, 2))
+                        return {};
+                    if (field_value(2) != (header_crc & 0xffff))
+                        return std::unexpected("Failed to decompress: header crc mismatch");
+                    break;
+                default:
+                    break;
+            }
+
+            next_field();
+            return {};
+        }
+
+        std::expected<void, std::string> body(std::span<const std::byte> &in, std::span<std::byte> &out)
+        {
+            stream.next_in = reinterpret_cast<Bytef *>(const_cast<std::byte *>(in.data()));
+            stream.avail_in = static_cast<uInt>(std::min<size_t>(in.size(), UINT_MAX));
+            stream.next_out = reinterpret_cast<Bytef *>(out.data());
+            stream.avail_out = static_cast<uInt>(std::min(out.size(), CHUNK));
+
+            auto before_in = stream.avail_in;
+            auto before_out = stream.avail_out;
+            auto result = inflate(&stream, Z_NO_FLUSH);
+            auto produced = before_out - stream.avail_out;
+
+            data_crc = crc::crc32(data_crc, out.first(produced));
+            data_size += produced;
+            in = in.subspan(before_in - stream.avail_in);
+            out = out.subspan(produced);
+
+            if (result == Z_STREAM_END)
+            {
+                stage = Stage::TRAILER;
+                field_length = 0;
+            }
+            else if (result != Z_OK && result != Z_BUF_ERROR)
+                return std::unexpected(zlib_error(stream, result));
+            return {};
+        }
+
+        std::expected<void, std::string> trailer(std::span<const std::byte> &in)
+        {
+            if (!collect(in, 8))
+                return {};
+
+            if (field_value(4) != data_crc)
+                return std::unexpected("Failed to decompress: crc mismatch");
+            uint32_t size = 0;
+            for (size_t i = 0; i < 4; ++i)
+                size |= static_cast<uint32_t>(field[4 + i]) << (8 * i);
+            if (size != static_cast<uint32_t>(data_size))
+                return std::unexpected("Failed to decompress: length mismatch");
+
+            stage = Stage::BETWEEN;
+            return {};
+        }
+
+        z_stream stream = {};
+        Stage stage = Stage::FIXED;
+        std::array<std::byte, 10> field = {};
+        size_t field_length = 0;
+        uint8_t flags = 0;
+        size_t extra_left = 0;
+        uint32_t header_crc = 0;
+        uint32_t data_crc = 0;
+        uint64_t data_size = 0;
+    };
+
+    std::expected<void, std::string> zlib_decode_raw(std::span<const std::byte> in, std::span<std::byte> out)
+    {
+        z_stream stream = {};
+        if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+            return std::unexpected("Failed to set up the decompressor");
+
+        int result = Z_OK;
+        while (result == Z_OK)
+        {
+            stream.next_in = reinterpret_cast<Bytef *>(const_cast<std::byte *>(in.data()));
+            stream.avail_in = static_cast<uInt>(std::min<size_t>(in.size(), UINT_MAX));
+            stream.next_out = reinterpret_cast<Bytef *>(out.data());
+            stream.avail_out = static_cast<uInt>(std::min<size_t>(out.size(), UINT_MAX));
+
+            auto before_in = stream.avail_in;
+            auto before_out = stream.avail_out;
+            result = inflate(&stream, Z_FINISH);
+            in = in.subspan(before_in - stream.avail_in);
+            out = out.subspan(before_out - stream.avail_out);
+
+            /* Z_BUF_ERROR only means "more room or input needed" while there is some left to give */
+            if (result == Z_BUF_ERROR && !in.empty() && !out.empty())
+                result = Z_OK;
+        }
+
+        std::expected<void, std::string> outcome;
+        if (result != Z_STREAM_END)
+            outcome = std::unexpected(result == Z_BUF_ERROR ? std::string("Failed to decompress: size mismatch")
+                                                            : zlib_error(stream, result));
+        else if (!out.empty())
+            outcome = std::unexpected("Failed to decompress: size mismatch");
+
+        inflateEnd(&stream);
+        return outcome;
+    }
+
+    /* grows `decoded` to at least `wanted` bytes, keeping what is already there */
+    std::expected<void, std::string> grow(inflater::Decoded &decoded, size_t &capacity, size_t wanted, size_t limit)
+    {
+        if (wanted > limit)
+            return std::unexpected("Decoded data is larger than the limit");
+
+        auto bigger = std::min(limit, std::max({ wanted, capacity * 2, MiB }));
+        auto data = std::make_unique_for_overwrite<std::byte[]>(bigger);
+        if (decoded.size > 0)
+            std::memcpy(data.get(), decoded.data.get(), decoded.size);
+        decoded.data = std::move(data);
+        capacity = bigger;
+        return {};
+    }
+
+    std::expected<inflater::Decoded, std::string> zlib_decode_gzip(std::span<const std::byte> in, size_t limit)
+    {
+        if (!is_gzip(in))
+            return std::unexpected("Not gzip data");
+
+        inflater::Decoded decoded;
+        size_t capacity = 0;
+        GzipInflater inflater;
+        while (true)
+        {
+            if (decoded.size == capacity)
+            {
+                if (auto grown = grow(decoded, capacity, std::max(capacity + 1, gzip_size_hint(in)), limit); !grown)
+                    return std::unexpected(grown.error());
+            }
+
+            std::span<std::byte> out(decoded.data.get() + decoded.size, capacity - decoded.size);
+            auto room = out.size();
+            auto done = inflater.decode(in, out, true);
+            if (!done)
+                return std::unexpected(done.error());
+
+            decoded.size += room - out.size();
+            if (*done)
+                return decoded;
+        }
+    }
+
+#ifdef INSTALL_APP_HAVE_LIBDEFLATE
+    struct DecompressorFree
+    {
+        void operator()(libdeflate_decompressor *decompressor) const
+        {
+            libdeflate_free_decompressor(decompressor);
+        }
+    };
+
+    /* the decompressor holds its tables, so each thread keeps one around */
+    libdeflate_decompressor *decompressor()
+    {
+        thread_local std::unique_ptr<libdeflate_decompressor, DecompressorFree> instance(
+                libdeflate_alloc_decompressor());
+        return instance.get();
+    }
+
+    std::expected<void, std::string> libdeflate_decode_raw(std::span<const std::byte> in, std::span<std::byte> out)
+    {
+        auto d = decompressor();
+        if (!d)
+            return std::unexpected("Failed to set up the decompressor");
+
+        switch (libdeflate_deflate_decompress(d, in.data(), in.size(), out.data(), out.size(), nullptr))
+        {
+            case LIBDEFLATE_SUCCESS:
+                return {};
+            case LIBDEFLATE_SHORT_OUTPUT:
+            case LIBDEFLATE_INSUFFICIENT_SPACE:
+                return std::unexpected("Failed to decompress: size mismatch");
+            default:
+                return std::unexpected("Failed to decompress: invalid deflate data");
+        }
+    }
+
+    std::expected<inflater::Decoded, std::string> libdeflate_decode_gzip(std::span<const std::byte> in, size_t limit)
+    {
+        if (!is_gzip(in))
+            return std::unexpected("Not gzip data");
+
+        auto d = decompressor();
+        if (!d)
+            return std::unexpected("Failed to set up the decompressor");
+
+        /* a single member, the usual case, says exactly how big it is */
+        inflater::Decoded decoded;
+        size_t capacity = 0;
+        if (auto grown = grow(decoded, capacity, gzip_size_hint(in), limit); !grown)
+            return std::unexpected(grown.error());
+
+        while (is_gzip(in))
+        {
+            size_t used = 0;
+            size_t produced = 0;
+            auto result = libdeflate_gzip_decompress_ex(d, in.data(), in.size(), decoded.data.get() + decoded.size,
+                    capacity - decoded.size, &used, &produced);
+
+            if (result == LIBDEFLATE_INSUFFICIENT_SPACE)
+            {
+                if (auto grown = grow(decoded, capacity, capacity + 1, limit); !grown)
+                    return std::unexpected(grown.error());
+                continue;
+            }
+            if (result != LIBDEFLATE_SUCCESS)
+                return std::unexpected("Failed to decompress: invalid gzip data");
+
+            in = in.subspan(used);
+            decoded.size += produced;
+        }
+        return decoded;
+    }
+#endif
+
+    inflater::Backend select_backend()
+    {
+        if (auto forced = std::getenv("INSTALL_APP_INFLATE"))
+        {
+            std::string_view name(forced);
+            if (name == "zlib")
+                return inflater::Backend::ZLIB;
+            if (name == "libdeflate" && inflater::available(inflater::Backend::LIBDEFLATE))
+                return inflater::Backend::LIBDEFLATE;
+        }
+
+#ifdef INSTALL_APP_HAVE_LIBDEFLATE
+#if defined(__x86_64__) || defined(__i386__)
+        /* libdeflate's x86 decode loop is built around BMI2; without it zlib is about as fast and
+         * streams, which keeps memory down */
+        __builtin_cpu_init();
+        if (!__builtin_cpu_supports("bmi2"))
+            return inflater::Backend::ZLIB;
+#endif
+        return inflater::Backend::LIBDEFLATE;
+#else
+        return inflater::Backend::ZLIB;
+#endif
+    }
+
+    /* decodes gzip on the way from the file to libarchive. a small mapped file comes out as a single
+     * block when the backend decodes whole buffers; otherwise zlib streams it */
+    class GzipSource final : public InputSource
+    {
+    public:
+        explicit GzipSource(std::unique_ptr<InputSource> compressed) :
+            compressed(std::move(compressed))
+        {
+        }
+
+        std::expected<std::span<const std::byte>, std::string> read() override
+        {
+            switch (mode)
+            {
+                case Mode::START:
+                    return start();
+                case Mode::STREAM:
+                    return stream();
+                case Mode::PASSTHROUGH:
+                    return compressed->read();
+                case Mode::FINISHED:
+                    break;
+            }
+            return std::span<const std::byte>();
+        }
+
+        std::expected<uint64_t, std::string> seek(int64_t, int) override
+        {
+            return std::unexpected("Cannot seek in a decompressed input");
+        }
+
+        bool seekable() const override
+        {
+            return false;
+        }
+
+        std::optional<uint64_t> size() const override
+        {
+            return compressed->size();
+        }
+
+        uint64_t position() const override
+        {
+            /* a whole-buffer decode reads the mapping directly, not through `read()` */
+            if (whole.data)
+                return compressed->size().value_or(0);
+            return compressed->position();
+        }
+
+        std::string_view kind() const override
+        {
+            return "gunzip";
+        }
+
+    private:
+        enum class Mode
+        {
+            START,
+            STREAM,
+            PASSTHROUGH,
+            FINISHED
+        };
+
+        std::expected<std::span<const std::byte>, std::string> start()
+        {
+            if (auto contents = compressed->contents())
+            {
+                if (!is_gzip(*contents))
+                {
+                    mode = Mode::PASSTHROUGH;
+                    return compressed->read();
+                }
+
+                /* a failed whole-buffer decode falls back to streaming, which reports the error properly
+                 * if the data really is damaged */
+                if (inflater::backend() == inflater::Backend::LIBDEFLATE)
+                {
+                    if (auto decoded = inflater::decode_gzip(*contents, WHOLE_BUFFER_LIMIT))
+                    {
+                        whole = std::move(*decoded);
+                        mode = Mode::FINISHED;
+                        return std::span<const std::byte>(whole.data.get(), whole.size);
+                    }
+                }
+            }
+            else
+            {
+                auto block = compressed->read();
+                if (!block || !is_gzip(*block))
+                {
+                    mode = Mode::PASSTHROUGH;
+                    return block;
+                }
+                pending = *block;
+            }
+
+            buffer = std::make_unique_for_overwrite<std::byte[]>(OUTPUT_BLOCK);
+            inflater = std::make_unique<GzipInflater>();
+            mode = Mode::STREAM;
+            return stream();
+        }
+
+        std::expected<std::span<const std::byte>, std::string> stream()
+        {
+            if (!failure.empty())
+                return std::unexpected(failure);
+
+            /* an error is held back until what was decoded before it has been handed out, so a
+             * damaged archive still yields the entries ahead of the damage */
+            std::span<std::byte> out(buffer.get(), OUTPUT_BLOCK);
+            while (!out.empty())
+            {
+                if (pending.empty() && !input_ended)
+                {
+                    auto block = compressed->read();
+                    if (!block)
+                    {
+                        failure = std::move(block.error());
+                        break;
+                    }
+                    input_ended = block->empty();
+                    pending = *block;
+                }
+
+                auto done = inflater->decode(pending, out, input_ended);
+                if (!done)
+                {
+                    failure = std::move(done.error());
+                    break;
+                }
+                if (*done)
+                {
+                    mode = Mode::FINISHED;
+                    break;
+                }
+            }
+            if (out.size() == OUTPUT_BLOCK && !failure.empty())
+                return std::unexpected(failure);
+            return std::span<const std::byte>(buffer.get(), OUTPUT_BLOCK - out.size());
+        }
+
+        std::unique_ptr<InputSource> compressed;
+        Mode mode = Mode::START;
+        inflater::Decoded whole;
+        std::unique_ptr<GzipInflater> inflater;
+        std::unique_ptr<std::byte[]> buffer;
+        std::span<const std::byte> pending;
+        bool input_ended = false;
+        std::string failure;
+    };
+}
+
+namespace inflater
+{
+    Backend backend()
+    {
+        static const Backend selected = select_backend();
+        return selected;
+    }
+
+    std::string_view backend_name(Backend backend)
+    {
+        switch (backend)
+        {
+            case Backend::ZLIB:
+                return "zlib";
+            case Backend::LIBDEFLATE:
+                return "libdeflate";
+        }
+        return "unknown";
+    }
+
+    bool available(Backend backend)
+    {
+#ifdef INSTALL_APP_HAVE_LIBDEFLATE
+        return backend == Backend::ZLIB || backend == Backend::LIBDEFLATE;
+#else
+        return backend == Backend::ZLIB;
+#endif
+    }
+
+    struct RawStream::State
+    {
+        z_stream stream = {};
+    };
+
+    RawStream::RawStream() :
+        state(std::make_unique<State>())
+    {
+        if (inflateInit2(&state->stream, -MAX_WBITS) != Z_OK)
+            throw std::bad_alloc();
+    }
+
+    RawStream::~RawStream()
+    {
+        inflateEnd(&state->stream);
+    }
+
+    std::expected<size_t, std::string> RawStream::decode(std::span<const std::byte> &in, std::span<std::byte> out,
+            bool &finished)
+    {
+        auto &stream = state->stream;
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<std::byte *>(in.data()));
+        stream.avail_in = static_cast<uInt>(std::min<size_t>(in.size(), UINT_MAX));
+        stream.next_out = reinterpret_cast<Bytef *>(out.data());
+        stream.avail_out = static_cast<uInt>(std::min<size_t>(out.size(), UINT_MAX));
+
+        auto before_in = stream.avail_in;
+        auto before_out = stream.avail_out;
+        auto result = inflate(&stream, Z_NO_FLUSH);
+        in = in.subspan(before_in - stream.avail_in);
+        auto produced = static_cast<size_t>(before_out - stream.avail_out);
+
+        finished = result == Z_STREAM_END;
+        if (result != Z_OK && result != Z_STREAM_END && !(result == Z_BUF_ERROR && produced > 0))
+        {
+            if (result == Z_BUF_ERROR)
+                return std::unexpected("Failed to decompress: truncated deflate data");
+            return std::unexpected(zlib_error(stream, result));
+        }
+        return produced;
+    }
+
+    std::expected<void, std::string> decode_raw(std::span<const std::byte> in, std::span<std::byte> out, Backend with)
+    {
+#ifdef INSTALL_APP_HAVE_LIBDEFLATE
+        if (with == Backend::LIBDEFLATE)
+            return libdeflate_decode_raw(in, out);
+#endif
+        (void)with;
+        return zlib_decode_raw(in, out);
+    }
+
+    std::expected<Decoded, std::string> decode_gzip(std::span<const std::byte> in, size_t limit, Backend with)
+    {
+#ifdef INSTALL_APP_HAVE_LIBDEFLATE
+        if (with == Backend::LIBDEFLATE)
+            return libdeflate_decode_gzip(in, limit);
+#endif
+        (void)with;
+        return zlib_decode_gzip(in, limit);
+    }
+}
+
+std::unique_ptr<InputSource> gunzip_input(std::unique_ptr<InputSource> compressed)
+{
+    return std::make_unique<GzipSource>(std::move(compressed));
+}
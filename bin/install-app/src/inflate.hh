@@ -0,0 +1,67 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <cstddef>
+#include <expected>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include "input.hh"
+
+/* deflate decoding outside libarchive. zlib is always there; libdeflate, when the build found it, is
+ * a much faster whole-buffer decoder and is picked at startup if the CPU has the instructions its fast
+ * path is built around. either one produces the same bytes, and both check the gzip CRC and length */
+namespace inflater
+{
+    enum class Backend
+    {
+        ZLIB,
+        LIBDEFLATE
+    };
+
+    /* chosen once; `INSTALL_APP_INFLATE=zlib` or `=libdeflate` overrides the CPU check */
+    Backend backend();
+    std::string_view backend_name(Backend backend);
+    bool available(Backend backend);
+
+    /* decodes a raw deflate stream whose decoded size is known up front, as it is for zip entries.
+     * decoding to anything but exactly `out.size()` bytes is an error */
+    std::expected<void, std::string> decode_raw(std::span<const std::byte> in, std::span<std::byte> out,
+            Backend with = backend());
+
+    /* zlib's raw deflate decoder a piece at a time, for zip entries too big to decode in one go */
+    class RawStream
+    {
+    public:
+        RawStream();
+        RawStream(const RawStream &) = delete;
+        RawStream &operator=(const RawStream &) = delete;
+        ~RawStream();
+
+        /* decodes from the front of `in` into `out`, dropping the input it used, and returns how much it
+         * wrote. `finished` is set once the end of the deflate stream has been decoded */
+        std::expected<size_t, std::string> decode(std::span<const std::byte> &in, std::span<std::byte> out,
+                bool &finished);
+
+    private:
+        struct State;
+        std::unique_ptr<State> state;
+    };
+
+    struct Decoded
+    {
+        std::unique_ptr<std::byte[]> data;
+        size_t size = 0;
+    };
+
+    /* decodes a whole gzip file, every member of it, into memory. gives up once the output would grow
+     * past `limit` */
+    std::expected<Decoded, std::string> decode_gzip(std::span<const std::byte> in, size_t limit,
+            Backend with = backend());
+}
+
+/* decompresses a gzip input so libarchive only sees the tar inside. an input that turns out not to be
+ * gzip is passed through untouched for libarchive to identify */
+std::unique_ptr<InputSource> gunzip_input(std::unique_ptr<InputSource> compressed);
@@ -0,0 +1,1010 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <mutex>
+#include <ranges>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <archive.h>
+#include "input.hh"
+#include "lookup.hh"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr size_t MiB = 1024 * 1024;
+    constexpr size_t MIN_BLOCK = 1 * MiB;
+    constexpr size_t MAX_BLOCK = 16 * MiB;
+
+    std::optional<uint64_t> read_sysfs_number(const fs::path &path)
+    {
+        std::ifstream file(path);
+        uint64_t value = 0;
+        if (file >> value)
+            return value;
+        return std::nullopt;
+    }
+
+    /* `queue/` lives on the whole disk, one level up from a partition */
+    std::optional<uint64_t> block_queue_value(dev_t device, std::string_view name)
+    {
+        auto dir = fs::path(std::format("/sys/dev/block/{}:{}", major(device), minor(device)));
+        if (auto value = read_sysfs_number(dir / "queue" / name))
+            return value;
+        return read_sysfs_number(dir / ".." / "queue" / name);
+    }
+
+    /* a large multiple of the preferred I/O size, and at least the device's own readahead. spinning
+     * disks get bigger blocks still, since every extra request can cost a seek */
+    size_t preferred_block_size(const struct stat &st)
+    {
+        size_t base = st.st_blksize > 0 ? static_cast<size_t>(st.st_blksize) : 4096;
+        size_t block = std::max(MIN_BLOCK, base * 64);
+
+        if (auto readahead_kb = block_queue_value(st.st_dev, "read_ahead_kb"))
+            block = std::max<size_t>(block, *readahead_kb * 1024);
+        if (block_queue_value(st.st_dev, "rotational").value_or(0) == 1)
+            block = std::max<size_t>(block, 4 * MiB);
+
+        block = std::min(block, MAX_BLOCK);
+        return (block + base - 1) / base * base;
+    }
+
+    std::expected<uint64_t, std::string> resolve_seek(int64_t offset, int whence, uint64_t position,
+            std::optional<uint64_t> size)
+    {
+        int64_t base = 0;
+        switch (whence)
+        {
+            case SEEK_SET:
+                break;
+            case SEEK_CUR:
+                base = static_cast<int64_t>(position);
+                break;
+            case SEEK_END:
+                if (!size)
+                    return std::unexpected("Cannot seek from the end of an input of unknown size");
+                base = static_cast<int64_t>(*size);
+                break;
+            default:
+                return std::unexpected("Invalid seek");
+        }
+
+        if (base + offset < 0)
+            return std::unexpected("Seek before the start of the input");
+        auto target = static_cast<uint64_t>(base + offset);
+        return size ? std::min(target, *size) : target;
+    }
+
+    /* serves blocks straight out of a read-only mapping. the next block is prefetched with
+     * MADV_WILLNEED as each one is handed out, and blocks libarchive is done with are dropped from the
+     * mapping so a multi-gigabyte archive does not pile up in our RSS */
+    class MappedSource final : public InputSource
+    {
+    public:
+        /* the volumes of a split archive are mapped back to back, so there may be several files */
+        MappedSource(std::vector<int> fds, uint64_t length, const std::byte *base, size_t block) :
+            fds(std::move(fds)), length(length), base(base), block(block),
+            page(static_cast<uint64_t>(sysconf(_SC_PAGESIZE)))
+        {
+            madvise(const_cast<std::byte *>(base), length, MADV_SEQUENTIAL);
+            advise_ahead(0);
+        }
+
+        ~MappedSource() override
+        {
+            munmap(const_cast<std::byte *>(base), length);
+            for (auto fd : fds)
+                close(fd);
+        }
+
+        std::expected<std::span<const std::byte>, std::string> read() override
+        {
+            /* the previous block stays valid until now; everything before it can go */
+            auto keep_from = last_block / page * page;
+            if (keep_from > released)
+            {
+                madvise(const_cast<std::byte *>(base) + released, keep_from - released, MADV_DONTNEED);
+                released = keep_from;
+            }
+
+            if (cursor >= length)
+                return std::span<const std::byte>();
+
+            auto size = std::min<uint64_t>(block, length - cursor);
+            std::span<const std::byte> out(base + cursor, size);
+            last_block = cursor;
+            cursor += size;
+            advise_ahead(cursor);
+            return out;
+        }
+
+        std::expected<uint64_t, std::string> seek(int64_t offset, int whence) override
+        {
+            auto target = resolve_seek(offset, whence, cursor, length);
+            if (!target)
+                return target;
+
+            cursor = *target;
+            last_block = cursor;
+            released = std::min(released, cursor / page * page);
+            return cursor;
+        }
+
+        bool seekable() const override
+        {
+            return true;
+        }
+
+        std::optional<uint64_t> size() const override
+        {
+            return length;
+        }
+
+        uint64_t position() const override
+        {
+            return cursor;
+        }
+
+        std::optional<std::span<const std::byte>> contents() const override
+        {
+            return std::span<const std::byte>(base, length);
+        }
+
+        int descriptor() const override
+        {
+            return fds.size() == 1 ? fds.front() : -1;
+        }
+
+        std::string_view kind() const override
+        {
+            return "mmap";
+        }
+
+    private:
+        void advise_ahead(uint64_t from)
+        {
+            auto start = from / page * page;
+            if (start >= length)
+                return;
+            madvise(const_cast<std::byte *>(base) + start, std::min<uint64_t>(block * 2, length - start),
+                    MADV_WILLNEED);
+        }
+
+        std::vector<int> fds;
+        uint64_t length;
+        const std::byte *base;
+        size_t block;
+        uint64_t page;
+        uint64_t cursor = 0;
+        uint64_t last_block = 0;
+        uint64_t released = 0;
+    };
+
+    struct AlignedFree
+    {
+        void operator()(std::byte *ptr) const
+        {
+            std::free(ptr);
+        }
+    };
+
+    /* double-buffered reads on a background thread: while libarchive decodes one block the thread is
+     * already reading the next with a single large `pread` (or `read` for pipes) */
+    class PrefetchSource final : public InputSource
+    {
+    public:
+        PrefetchSource(int fd, std::optional<uint64_t> length, bool can_seek, size_t block, size_t alignment) :
+            fd(fd), length(length), can_seek(can_seek), block(block)
+        {
+            for (auto &buffer : buffers)
+            {
+                void *memory = nullptr;
+                if (posix_memalign(&memory, alignment, block) != 0)
+                    throw std::bad_alloc();
+                buffer.data.reset(static_cast<std::byte *>(memory));
+            }
+
+            if (can_seek)
+                posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            start(0);
+        }
+
+        ~PrefetchSource() override
+        {
+            stop();
+            close(fd);
+        }
+
+        std::expected<std::span<const std::byte>, std::string> read() override
+        {
+            std::unique_lock guard(lock);
+            if (handed_out >= 0)
+            {
+                buffers[static_cast<size_t>(handed_out)].state = State::EMPTY;
+                handed_out = -1;
+                wakeup.notify_all();
+            }
+
+            auto &buffer = buffers[next_read];
+            wakeup.wait(guard, [&] { return buffer.state != State::EMPTY; });
+
+            if (buffer.state == State::FAILED)
+                return std::unexpected(buffer.error);
+            if (buffer.length == 0)
+                return std::span<const std::byte>();
+
+            handed_out = static_cast<int>(next_read);
+            next_read ^= 1;
+            cursor += buffer.length;
+            return std::span<const std::byte>(buffer.data.get(), buffer.length);
+        }
+
+        std::expected<uint64_t, std::string> seek(int64_t offset, int whence) override
+        {
+            auto target = resolve_seek(offset, whence, cursor, length);
+            if (!target)
+                return target;
+
+            /* seeks are rare (zip's central directory), so restarting the reader is simpler than
+             * teaching it to abandon blocks in flight */
+            stop();
+            start(*target);
+            cursor = *target;
+            return cursor;
+        }
+
+        bool seekable() const override
+        {
+            return can_seek;
+        }
+
+        std::optional<uint64_t> size() const override
+        {
+            return length;
+        }
+
+        uint64_t position() const override
+        {
+            return cursor;
+        }
+
+        std::string_view kind() const override
+        {
+            return "read";
+        }
+
+    private:
+        enum class State
+        {
+            EMPTY,
+            FULL,
+            FAILED
+        };
+
+        struct Buffer
+        {
+            std::unique_ptr<std::byte, AlignedFree> data;
+            size_t length = 0;
+            State state = State::EMPTY;
+            std::string error;
+        };
+
+        void start(uint64_t offset)
+        {
+            for (auto &buffer : buffers)
+                buffer.state = State::EMPTY;
+            handed_out = -1;
+            next_read = 0;
+            worker = std::jthread([this, offset](std::stop_token token) { run(token, offset); });
+        }
+
+        void stop()
+        {
+            if (!worker.joinable())
+                return;
+
+            {
+                std::lock_guard guard(lock);
+                worker.request_stop();
+            }
+            wakeup.notify_all();
+            worker.join();
+        }
+
+        void run(std::stop_token token, uint64_t offset)
+        {
+            size_t next_fill = 0;
+
+            while (true)
+            {
+                auto &buffer = buffers[next_fill];
+                {
+                    std::unique_lock guard(lock);
+                    if (!wakeup.wait(guard, token, [&] { return buffer.state == State::EMPTY; }))
+                        return;
+                }
+
+                size_t filled = 0;
+                std::string error;
+                while (filled < block)
+                {
+                    auto n = can_seek ? pread(fd, buffer.data.get() + filled, block - filled,
+                                                static_cast<off_t>(offset + filled))
+                                      : ::read(fd, buffer.data.get() + filled, block - filled);
+                    if (n < 0 && errno == EINTR)
+                        continue;
+                    if (n < 0)
+                    {
+                        error = std::format("Failed to read archive: {}", std::strerror(errno));
+                        break;
+                    }
+                    if (n == 0)
+                        break;
+                    filled += static_cast<size_t>(n);
+                }
+
+                bool done = filled == 0 || !error.empty();
+                {
+                    std::lock_guard guard(lock);
+                    buffer.length = filled;
+                    buffer.error = std::move(error);
+                    buffer.state = buffer.error.empty() ? State::FULL : State::FAILED;
+                }
+                wakeup.notify_all();
+
+                /* a short block is followed by an empty one, which is what ends the input */
+                if (done)
+                    return;
+
+                offset += filled;
+                next_fill ^= 1;
+            }
+        }
+
+        int fd;
+        std::optional<uint64_t> length;
+        bool can_seek;
+        size_t block;
+        uint64_t cursor = 0;
+        std::array<Buffer, 2> buffers;
+        int handed_out = -1;
+        size_t next_read = 0;
+        std::mutex lock;
+        std::condition_variable_any wakeup;
+        std::jthread worker;
+    };
+
+    /* the volumes of a split archive read one after another as if they were one file, for when they
+     * cannot be mapped back to back. blocks stop at the end of each volume, so a read is one `pread` */
+    class VolumeSource final : public InputSource
+    {
+    public:
+        struct Volume
+        {
+            int fd;
+            uint64_t start;
+            uint64_t length;
+        };
+
+        VolumeSource(std::vector<Volume> volumes, uint64_t length, size_t block) :
+            volumes(std::move(volumes)), length(length), block(block),
+            buffer(std::make_unique_for_overwrite<std::byte[]>(block))
+        {
+            for (const auto &volume : this->volumes)
+                posix_fadvise(volume.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+
+        ~VolumeSource() override
+        {
+            for (const auto &volume : volumes)
+                close(volume.fd);
+        }
+
+        std::expected<std::span<const std::byte>, std::string> read() override
+        {
+            if (cursor >= length)
+                return std::span<const std::byte>();
+
+            auto volume = std::ranges::upper_bound(volumes, cursor, {}, &Volume::start) - 1;
+            auto within = cursor - volume->start;
+            auto wanted = std::min<uint64_t>(block, volume->length - within);
+
+            size_t filled = 0;
+            while (filled < wanted)
+            {
+                auto n = pread(volume->fd, buffer.get() + filled, wanted - filled, static_cast<off_t>(within + filled));
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n < 0)
+                    return std::unexpected(std::format("Failed to read archive: {}", std::strerror(errno)));
+                if (n == 0)
+                    return std::unexpected("Failed to read archive: a volume is shorter than when it was opened");
+                filled += static_cast<size_t>(n);
+            }
+
+            cursor += filled;
+            return std::span<const std::byte>(buffer.get(), filled);
+        }
+
+        std::expected<uint64_t, std::string> seek(int64_t offset, int whence) override
+        {
+            auto target = resolve_seek(offset, whence, cursor, length);
+            if (!target)
+                return target;
+            cursor = *target;
+            return cursor;
+        }
+
+        bool seekable() const override
+        {
+            return true;
+        }
+
+        std::optional<uint64_t> size() const override
+        {
+            return length;
+        }
+
+        uint64_t position() const override
+        {
+            return cursor;
+        }
+
+        std::string_view kind() const override
+        {
+            return "volumes";
+        }
+
+    private:
+        std::vector<Volume> volumes;
+        uint64_t length;
+        size_t block;
+        std::unique_ptr<std::byte[]> buffer;
+        uint64_t cursor = 0;
+    };
+
+    /* the name of the volume after `name`, whose last `suffix` characters number it. empty past the last
+     * number the suffix can hold */
+    std::string next_volume(std::string name, size_t suffix)
+    {
+        auto digits = name.back() >= '0' && name.back() <= '9';
+        auto first = digits ? '0' : 'a';
+        auto last = digits ? '9' : 'z';
+        for (size_t i = name.size() - 1; i >= name.size() - suffix; --i)
+        {
+            if (name[i] == '.' || name[i] == '-')
+                break;
+            if (name[i] != last)
+            {
+                ++name[i];
+                return name;
+            }
+            name[i] = first;
+        }
+        return {};
+    }
+
+    bool is_first_volume(std::string_view suffix)
+    {
+        auto number = suffix.substr(suffix.find_last_of(".-") + 1);
+        if (number.front() >= 'a')
+            return number.find_first_not_of('a') == std::string_view::npos;
+        return number.find_first_not_of('0') == number.size() - 1 && number.back() == '1';
+    }
+
+    std::expected<std::unique_ptr<InputSource>, std::string> open_volumes(const std::vector<fs::path> &paths)
+    {
+        std::vector<VolumeSource::Volume> volumes;
+        auto close_all = [&] {
+            for (const auto &volume : volumes)
+                close(volume.fd);
+        };
+
+        uint64_t total = 0;
+        struct stat st = {};
+        for (const auto &path : paths)
+        {
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0 || fstat(fd, &st) != 0)
+            {
+                auto err = std::format("Failed to open {}: {}", path.string(), std::strerror(errno));
+                if (fd >= 0)
+                    close(fd);
+                close_all();
+                return std::unexpected(err);
+            }
+            volumes.push_back({ fd, total, static_cast<uint64_t>(st.st_size) });
+            total += static_cast<uint64_t>(st.st_size);
+        }
+
+        auto block = preferred_block_size(st);
+
+        /* volumes cut at whole pages can be mapped into one reserved range, which gives the readers that
+         * want the whole file in memory (zip's central directory) the same view as for a single file */
+        auto page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+        auto aligned = std::ranges::all_of(volumes | std::views::take(volumes.size() - 1),
+                [&](const auto &volume) { return volume.length % page == 0; });
+        if (aligned && total > 0)
+        {
+            auto reserved = mmap(nullptr, total, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            auto base = static_cast<std::byte *>(reserved);
+            bool mapped = reserved != MAP_FAILED;
+            for (const auto &volume : volumes)
+            {
+                if (!mapped || volume.length == 0)
+                    continue;
+                mapped = mmap(base + volume.start, volume.length, PROT_READ, MAP_PRIVATE | MAP_FIXED, volume.fd, 0) !=
+                         MAP_FAILED;
+            }
+
+            if (mapped)
+            {
+                std::vector<int> fds;
+                for (const auto &volume : volumes)
+                    fds.push_back(volume.fd);
+                return std::make_unique<MappedSource>(std::move(fds), total, base, block);
+            }
+            if (reserved != MAP_FAILED)
+                munmap(reserved, total);
+        }
+
+        return std::make_unique<VolumeSource>(std::move(volumes), total, block);
+    }
+
+    /* hands out a block that was read ahead of time to look at, then carries on with the source it
+     * came from */
+    class PeekedSource final : public InputSource
+    {
+    public:
+        PeekedSource(std::unique_ptr<InputSource> source, std::span<const std::byte> first) :
+            source(std::move(source)), first(first)
+        {
+        }
+
+        std::expected<std::span<const std::byte>, std::string> read() override
+        {
+            if (pending)
+            {
+                pending = false;
+                return first;
+            }
+            return source->read();
+        }
+
+        std::expected<uint64_t, std::string> seek(int64_t offset, int whence) override
+        {
+            /* the source is already past the peeked block, so a relative seek starts further back */
+            if (pending && whence == SEEK_CUR)
+                offset -= static_cast<int64_t>(first.size());
+            pending = false;
+            return source->seek(offset, whence);
+        }
+
+        bool seekable() const override
+        {
+            return source->seekable();
+        }
+
+        std::optional<uint64_t> size() const override
+        {
+            return source->size();
+        }
+
+        uint64_t position() const override
+        {
+            return source->position() - (pending ? first.size() : 0);
+        }
+
+        int descriptor() const override
+        {
+            return source->descriptor();
+        }
+
+        std::string_view kind() const override
+        {
+            return source->kind();
+        }
+
+    private:
+        std::unique_ptr<InputSource> source;
+        std::span<const std::byte> first;
+        bool pending = true;
+    };
+
+    /* a window onto another input, starting `offset` bytes in */
+    class OffsetSource final : public InputSource
+    {
+    public:
+        OffsetSource(std::unique_ptr<InputSource> source, uint64_t offset, std::optional<uint64_t> length) :
+            source(std::move(source)), offset(offset)
+        {
+            auto whole = this->source->size();
+            if (whole)
+                this->length = *whole - std::min(*whole, offset);
+            if (length)
+                this->length = this->length ? std::min(*this->length, *length) : *length;
+        }
+
+        std::expected<std::span<const std::byte>, std::string> read() override
+        {
+            if (!started)
+            {
+                started = true;
+                if (source->seekable())
+                {
+                    if (auto moved = source->seek(static_cast<int64_t>(offset), SEEK_SET); !moved)
+                        return std::unexpected(moved.error());
+                }
+            }
+
+            while (true)
+            {
+                auto start = source->position();
+                auto block = source->read();
+                if (!block || block->empty())
+                    return block;
+
+                /* still short of the window when the input had to be read up to it */
+                auto end = start + block->size();
+                if (end <= offset)
+                    continue;
+                if (start < offset)
+                    *block = block->subspan(offset - start);
+                start = std::max(start, offset);
+
+                if (length)
+                {
+                    auto left = *length - std::min(*length, start - offset);
+                    *block = block->first(std::min<uint64_t>(block->size(), left));
+                }
+                return block;
+            }
+        }
+
+        std::expected<uint64_t, std::string> seek(int64_t where, int whence) override
+        {
+            started = true;
+            auto target = resolve_seek(where, whence, position(), length);
+            if (!target)
+                return target;
+            auto moved = source->seek(static_cast<int64_t>(offset + *target), SEEK_SET);
+            if (!moved)
+                return moved;
+            return *moved - std::min(*moved, offset);
+        }
+
+        bool seekable() const override
+        {
+            return source->seekable();
+        }
+
+        std::optional<uint64_t> size() const override
+        {
+            return length;
+        }
+
+        uint64_t position() const override
+        {
+            auto at = started ? source->position() : offset;
+            return at - std::min(at, offset);
+        }
+
+        std::optional<std::span<const std::byte>> contents() const override
+        {
+            auto all = source->contents();
+            if (!all)
+                return std::nullopt;
+            auto window = all->subspan(std::min<uint64_t>(offset, all->size()));
+            return length ? window.first(std::min<uint64_t>(window.size(), *length)) : window;
+        }
+
+        std::string_view kind() const override
+        {
+            return source->kind();
+        }
+
+    private:
+        std::unique_ptr<InputSource> source;
+        uint64_t offset;
+        std::optional<uint64_t> length;
+        bool started = false;
+    };
+
+    /* a whole input held in memory, for a stream that has to be read out of order */
+    class MemorySource final : public InputSource
+    {
+    public:
+        explicit MemorySource(std::vector<std::byte> data) :
+            data(std::move(data))
+        {
+        }
+
+        std::expected<std::span<const std::byte>, std::string> read() override
+        {
+            auto size = std::min<uint64_t>(MIN_BLOCK, data.size() - cursor);
+            std::span<const std::byte> out(data.data() + cursor, size);
+            cursor += size;
+            return out;
+        }
+
+        std::expected<uint64_t, std::string> seek(int64_t offset, int whence) override
+        {
+            auto target = resolve_seek(offset, whence, cursor, data.size());
+            if (!target)
+                return target;
+            cursor = *target;
+            return cursor;
+        }
+
+        bool seekable() const override
+        {
+            return true;
+        }
+
+        std::optional<uint64_t> size() const override
+        {
+            return data.size();
+        }
+
+        uint64_t position() const override
+        {
+            return cursor;
+        }
+
+        std::optional<std::span<const std::byte>> contents() const override
+        {
+            return std::span<const std::byte>(data);
+        }
+
+        std::string_view kind() const override
+        {
+            return "memory";
+        }
+
+    private:
+        std::vector<std::byte> data;
+        uint64_t cursor = 0;
+    };
+
+    la_ssize_t read_callback(archive *a, void *client, const void **buffer)
+    {
+        auto block = static_cast<InputSource *>(client)->read();
+        if (!block)
+        {
+            archive_set_error(a, EIO, "%s", block.error().c_str());
+            return ARCHIVE_FATAL;
+        }
+
+        *buffer = block->data();
+        return static_cast<la_ssize_t>(block->size());
+    }
+
+    la_int64_t skip_callback(archive *, void *client, la_int64_t request)
+    {
+        auto source = static_cast<InputSource *>(client);
+        auto before = source->seek(0, SEEK_CUR);
+        auto after = source->seek(request, SEEK_CUR);
+        if (!before || !after)
+            return 0;
+        return static_cast<la_int64_t>(*after - *before);
+    }
+
+    la_int64_t seek_callback(archive *a, void *client, la_int64_t offset, int whence)
+    {
+        auto position = static_cast<InputSource *>(client)->seek(offset, whence);
+        if (!position)
+        {
+            archive_set_error(a, EINVAL, "%s", position.error().c_str());
+            return ARCHIVE_FATAL;
+        }
+        return static_cast<la_int64_t>(*position);
+    }
+}
+
+HashingSource::HashingSource(std::unique_ptr<InputSource> source, Sha256 &hasher) :
+    source(std::move(source)), hasher(hasher)
+{
+}
+
+std::expected<std::span<const std::byte>, std::string> HashingSource::read()
+{
+    auto start = source->position();
+    auto block = source->read();
+    if (!block)
+        return block;
+
+    /* only a block that continues the hashed prefix can be hashed now */
+    auto end = start + block->size();
+    if (start <= hashed && end > hashed)
+    {
+        hasher.update(block->subspan(hashed - start));
+        hashed = end;
+    }
+    return block;
+}
+
+std::expected<uint64_t, std::string> HashingSource::seek(int64_t offset, int whence)
+{
+    return source->seek(offset, whence);
+}
+
+bool HashingSource::seekable() const
+{
+    return source->seekable();
+}
+
+std::optional<uint64_t> HashingSource::size() const
+{
+    return source->size();
+}
+
+uint64_t HashingSource::position() const
+{
+    return source->position();
+}
+
+std::optional<std::span<const std::byte>> HashingSource::contents() const
+{
+    return source->contents();
+}
+
+int HashingSource::descriptor() const
+{
+    return source->descriptor();
+}
+
+std::string_view HashingSource::kind() const
+{
+    return source->kind();
+}
+
+std::expected<void, std::string> HashingSource::finish()
+{
+    /* a mapped file is still in the page cache, so catching up costs no I/O */
+    if (auto all = source->contents())
+    {
+        if (hashed < all->size())
+            hasher.update(all->subspan(hashed));
+        hashed = all->size();
+        return {};
+    }
+
+    if (source->seekable())
+    {
+        if (auto moved = source->seek(static_cast<int64_t>(hashed), SEEK_SET); !moved)
+            return std::unexpected(moved.error());
+    }
+
+    while (true)
+    {
+        auto block = read();
+        if (!block)
+            return std::unexpected(block.error());
+        if (block->empty())
+            return {};
+    }
+}
+
+std::vector<fs::path> archive_volumes(const fs::path &path)
+{
+    std::vector<fs::path> volumes{ path };
+    auto suffix = names::volume_suffix(names::filename(path)).size();
+    if (suffix == 0 || !is_first_volume(names::filename(path).substr(names::filename(path).size() - suffix)))
+        return volumes;
+
+    std::error_code ec;
+    for (auto name = next_volume(path.filename().string(), suffix); !name.empty(); name = next_volume(name, suffix))
+    {
+        auto next = path.parent_path() / name;
+        if (!fs::is_regular_file(next, ec))
+            break;
+        volumes.push_back(std::move(next));
+    }
+    return volumes;
+}
+
+std::expected<std::unique_ptr<InputSource>, std::string> open_input(const fs::path &path)
+{
+    if (auto volumes = archive_volumes(path); volumes.size() > 1)
+        return open_volumes(volumes);
+
+    /* a duplicate, so the source can close its descriptor like any other without closing stdin */
+    auto piped = is_standard_input(path);
+    int fd = piped ? fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 0) : open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return std::unexpected(std::format("Failed to open {}: {}", piped ? "standard input" : path.string(),
+                std::strerror(errno)));
+
+    struct stat st = {};
+    if (fstat(fd, &st) != 0)
+    {
+        auto err = std::format("Failed to stat {}: {}", path.string(), std::strerror(errno));
+        close(fd);
+        return std::unexpected(err);
+    }
+
+    auto block = preferred_block_size(st);
+    /* a redirected file that something has already read from starts where it was left, which only a
+     * plain `read` respects */
+    auto regular = S_ISREG(st.st_mode) && (!piped || lseek(fd, 0, SEEK_CUR) == 0);
+    auto length = static_cast<uint64_t>(st.st_size);
+
+    if (regular && length > 0)
+    {
+        auto base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (base != MAP_FAILED)
+            return std::make_unique<MappedSource>(std::vector{ fd }, length, static_cast<const std::byte *>(base),
+                    block);
+    }
+
+    /* filesystems that cannot map, and anything that is not a regular file */
+    auto alignment = std::max<size_t>(static_cast<size_t>(sysconf(_SC_PAGESIZE)), static_cast<size_t>(st.st_blksize));
+    return std::make_unique<PrefetchSource>(fd, regular ? std::optional(length) : std::nullopt, regular, block,
+            alignment);
+}
+
+std::expected<std::span<const std::byte>, std::string> peek_input(std::unique_ptr<InputSource> &source)
+{
+    if (auto all = source->contents())
+        return *all;
+
+    auto first = source->read();
+    if (!first)
+        return first;
+    source = std::make_unique<PeekedSource>(std::move(source), *first);
+    return first;
+}
+
+std::unique_ptr<InputSource> offset_input(std::unique_ptr<InputSource> source, uint64_t offset,
+        std::optional<uint64_t> length)
+{
+    return std::make_unique<OffsetSource>(std::move(source), offset, length);
+}
+
+std::expected<std::unique_ptr<InputSource>, std::string> buffer_input(std::unique_ptr<InputSource> source)
+{
+    if (source->contents())
+        return source;
+
+    std::vector<std::byte> data;
+    if (auto size = source->size())
+        data.reserve(*size);
+
+    while (true)
+    {
+        auto block = source->read();
+        if (!block)
+            return std::unexpected(block.error());
+        if (block->empty())
+            break;
+        data.insert(data.end(), block->begin(), block->end());
+    }
+
+    return std::make_unique<MemorySource>(std::move(data));
+}
+
+int archive_read_open_source(archive *a, InputSource &source)
+{
+    archive_read_set_callback_data(a, &source);
+    archive_read_set_read_callback(a, read_callback);
+    if (source.seekable())
+    {
+        archive_read_set_skip_callback(a, skip_callback);
+        archive_read_set_seek_callback(a, seek_callback);
+    }
+    return archive_read_open1(a);
+}
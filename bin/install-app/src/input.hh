@@ -0,0 +1,106 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "sha256.hh"
+
+struct archive;
+
+/* where libarchive gets its compressed input from. blocks are handed out by pointer, so a source can
+ * serve them straight from a mapping or from buffers filled ahead of time */
+class InputSource
+{
+public:
+    virtual ~InputSource() = default;
+
+    /* the next block of input, valid until the following call. empty at the end */
+    virtual std::expected<std::span<const std::byte>, std::string> read() = 0;
+    /* moves the read position like `lseek` and returns the new one. only called when `seekable()` */
+    virtual std::expected<uint64_t, std::string> seek(int64_t offset, int whence) = 0;
+    virtual bool seekable() const = 0;
+    virtual std::optional<uint64_t> size() const = 0;
+    /* how far `read()` has got. sources that decode another one report the position in the file
+     * underneath, which is what `size()` and progress are measured against */
+    virtual uint64_t position() const = 0;
+    /* the whole input at once, for sources that already have it in memory */
+    virtual std::optional<std::span<const std::byte>> contents() const
+    {
+        return std::nullopt;
+    }
+    /* the file `contents()` comes from, for copies the kernel can do without us touching the data */
+    virtual int descriptor() const
+    {
+        return -1;
+    }
+    virtual std::string_view kind() const = 0;
+};
+
+/* feeds the input underneath into `hasher` in file order as blocks are read through it, so checking an
+ * archive's digest does not take a second pass over the file. whatever the reader skipped or seeked
+ * past, and the tail it never asked for, is caught up by `finish()` */
+class HashingSource final : public InputSource
+{
+public:
+    HashingSource(std::unique_ptr<InputSource> source, Sha256 &hasher);
+
+    std::expected<std::span<const std::byte>, std::string> read() override;
+    std::expected<uint64_t, std::string> seek(int64_t offset, int whence) override;
+    bool seekable() const override;
+    std::optional<uint64_t> size() const override;
+    uint64_t position() const override;
+    std::optional<std::span<const std::byte>> contents() const override;
+    int descriptor() const override;
+    std::string_view kind() const override;
+
+    /* hashes the rest of the input. the hasher then holds the digest of the whole file */
+    std::expected<void, std::string> finish();
+
+private:
+    std::unique_ptr<InputSource> source;
+    Sha256 &hasher;
+    uint64_t hashed = 0;
+};
+
+/* `-` in place of an archive path, for an archive piped in on standard input */
+inline bool is_standard_input(const std::filesystem::path &path)
+{
+    return path == "-";
+}
+
+/* `path` and the volumes after it when it is the first piece of a split archive (`.001`, `.part-aa`),
+ * up to the first one missing. just `path` otherwise */
+std::vector<std::filesystem::path> archive_volumes(const std::filesystem::path &path);
+
+/* maps `path` when it is a regular file, falling back to a read-ahead thread otherwise. either way the
+ * block size follows the file's `st_blksize` and the device it lives on. `-` opens standard input, which
+ * is mapped too when it was redirected from a file. the first volume of a split archive opens all of
+ * them as one input, mapped back to back when the volumes are whole pages */
+std::expected<std::unique_ptr<InputSource>, std::string> open_input(const std::filesystem::path &path);
+
+/* the first block of `source` without consuming it: `source` is replaced by one that hands the same
+ * block out again on its first `read()`. for pipes, which cannot seek back to look twice. the span stays
+ * valid until that read */
+std::expected<std::span<const std::byte>, std::string> peek_input(std::unique_ptr<InputSource> &source);
+
+/* the part of `source` from `offset` on, `length` bytes of it when that is known, as an input of its
+ * own: positions, `size()` and `contents()` are all relative to `offset`. for an archive that sits
+ * inside a larger file. an input that cannot seek is read up to `offset` and the bytes dropped */
+std::unique_ptr<InputSource> offset_input(std::unique_ptr<InputSource> source, uint64_t offset,
+        std::optional<uint64_t> length = std::nullopt);
+
+/* reads all of `source` into memory, for formats that need to seek in an input that cannot. the result
+ * has `contents()` and is seekable, and its positions are those of the input */
+std::expected<std::unique_ptr<InputSource>, std::string> buffer_input(std::unique_ptr<InputSource> source);
+
+/* opens `a` on `source` through libarchive's client callbacks. `source` must outlive the archive */
+int archive_read_open_source(archive *a, InputSource &source);
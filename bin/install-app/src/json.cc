@@ -0,0 +1,264 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <charconv>
+#include "json.hh"
+
+namespace
+{
+    class Parser
+    {
+    public:
+        explicit Parser(std::string_view text) :
+            text(text)
+        {
+        }
+
+        std::optional<JsonValue> document()
+        {
+            auto value = parse_value(0);
+            skip_whitespace();
+            if (!value || pos != text.size())
+                return std::nullopt;
+            return value;
+        }
+
+    private:
+        static constexpr int max_depth = 64;
+
+        std::string_view text;
+        size_t pos = 0;
+
+        void skip_whitespace()
+        {
+            while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r'))
+                ++pos;
+        }
+
+        bool consume(std::string_view token)
+        {
+            if (text.substr(pos, token.size()) != token)
+                return false;
+            pos += token.size();
+            return true;
+        }
+
+        std::optional<JsonValue> parse_value(int depth)
+        {
+            if (depth > max_depth)
+                return std::nullopt;
+
+            skip_whitespace();
+            if (pos >= text.size())
+                return std::nullopt;
+
+            switch (text[pos])
+            {
+                case '{':
+                    return parse_object(depth);
+                case '[':
+                    return parse_array(depth);
+                case '"':
+                {
+                    auto str = parse_string();
+                    if (!str)
+                        return std::nullopt;
+                    return JsonValue{ std::move(*str) };
+                }
+                case 't':
+                    return consume("true") ? std::optional(JsonValue{ true }) : std::nullopt;
+                case 'f':
+                    return consume("false") ? std::optional(JsonValue{ false }) : std::nullopt;
+                case 'n':
+                    return consume("null") ? std::optional(JsonValue{ nullptr }) : std::nullopt;
+                default:
+                    return parse_number();
+            }
+        }
+
+        std::optional<JsonValue> parse_number()
+        {
+            double number = 0;
+            auto [end, ec] = std::from_chars(text.data() + pos, text.data() + text.size(), number);
+            if (ec != std::errc())
+                return std::nullopt;
+
+            pos = static_cast<size_t>(end - text.data());
+            return JsonValue{ number };
+        }
+
+        std::optional<std::string> parse_string()
+        {
+            std::string out;
+            ++pos;
+
+            while (pos < text.size())
+            {
+                auto c = text[pos++];
+                if (c == '"')
+                    return out;
+                if (c != '\\')
+                {
+                    out += c;
+                    continue;
+                }
+
+                if (pos >= text.size())
+                    return std::nullopt;
+
+                switch (text[pos++])
+                {
+                    case '"':
+                        out += '"';
+                        break;
+                    case '\\':
+                        out += '\\';
+                        break;
+                    case '/':
+                        out += '/';
+                        break;
+                    case 'n':
+                        out += '\n';
+                        break;
+                    case 'r':
+                        out += '\r';
+                        break;
+                    case 't':
+                        out += '\t';
+                        break;
+                    case 'b':
+                        out += '\b';
+                        break;
+                    case 'f':
+                        out += '\f';
+                        break;
+                    case 'u':
+                    {
+                        unsigned code = 0;
+                        if (pos + 4 > text.size())
+                            return std::nullopt;
+                        auto [end, ec] = std::from_chars(text.data() + pos, text.data() + pos + 4, code, 16);
+                        if (ec != std::errc() || end != text.data() + pos + 4)
+                            return std::nullopt;
+                        pos += 4;
+
+                        /* surrogate pairs are not produced by our writers, so only the basic plane is decoded */
+                        if (code < 0x80)
+                        {
+                            out += static_cast<char>(code);
+                        }
+                        else if (code < 0x800)
+                        {
+                            out += static_cast<char>(0xc0 | (code >> 6));
+                            out += static_cast<char>(0x80 | (code & 0x3f));
+                        }
+                        else
+                        {
+                            out += static_cast<char>(0xe0 | (code >> 12));
+                            out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+                            out += static_cast<char>(0x80 | (code & 0x3f));
+                        }
+                        break;
+                    }
+                    default:
+                        return std::nullopt;
+                }
+            }
+
+            return std::nullopt;
+        }
+
+        std::optional<JsonValue> parse_array(int depth)
+        {
+            JsonValue::Array array;
+            ++pos;
+
+            skip_whitespace();
+            if (consume("]"))
+                return JsonValue{ std::move(array) };
+
+            while (true)
+            {
+                auto element = parse_value(depth + 1);
+                if (!element)
+                    return std::nullopt;
+                array.push_back(std::move(*element));
+
+                skip_whitespace();
+                if (consume("]"))
+                    return JsonValue{ std::move(array) };
+                if (!consume(","))
+                    return std::nullopt;
+            }
+        }
+
+        std::optional<JsonValue> parse_object(int depth)
+        {
+            JsonValue::Object object;
+            ++pos;
+
+            skip_whitespace();
+            if (consume("}"))
+                return JsonValue{ std::move(object) };
+
+            while (true)
+            {
+                skip_whitespace();
+                if (pos >= text.size() || text[pos] != '"')
+                    return std::nullopt;
+
+                auto key = parse_string();
+                skip_whitespace();
+                if (!key || !consume(":"))
+                    return std::nullopt;
+
+                auto element = parse_value(depth + 1);
+                if (!element)
+                    return std::nullopt;
+                object.insert_or_assign(std::move(*key), std::move(*element));
+
+                skip_whitespace();
+                if (consume("}"))
+                    return JsonValue{ std::move(object) };
+                if (!consume(","))
+                    return std::nullopt;
+            }
+        }
+    };
+}
+
+const JsonValue *JsonValue::find(std::string_view key) const
+{
+    auto obj = object();
+    if (!obj)
+        return nullptr;
+
+    auto it = obj->find(key);
+    return it != obj->end() ? &it->second : nullptr;
+}
+
+double JsonValue::number(double fallback) const
+{
+    auto n = std::get_if<double>(&value);
+    return n ? *n : fallback;
+}
+
+std::string_view JsonValue::string(std::string_view fallback) const
+{
+    auto s = std::get_if<std::string>(&value);
+    return s ? std::string_view(*s) : fallback;
+}
+
+const JsonValue::Array *JsonValue::array() const
+{
+    return std::get_if<Array>(&value);
+}
+
+const JsonValue::Object *JsonValue::object() const
+{
+    return std::get_if<Object>(&value);
+}
+
+std::optional<JsonValue> json_parse(std::string_view text)
+{
+    return Parser(text).document();
+}
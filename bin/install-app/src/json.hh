@@ -0,0 +1,63 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <format>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+inline std::string json_escape(std::string_view text)
+{
+    std::string out;
+    out.reserve(text.size() + 2);
+
+    for (auto c : text)
+    {
+        switch (c)
+        {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                    out += std::format("\\u{:04x}", static_cast<unsigned>(c));
+                else
+                    out += c;
+        }
+    }
+
+    return out;
+}
+
+/* a deliberately small json document model, enough to read back the files this tool writes */
+struct JsonValue
+{
+    using Array = std::vector<JsonValue>;
+    using Object = std::map<std::string, JsonValue, std::less<>>;
+
+    std::variant<std::nullptr_t, bool, double, std::string, Array, Object> value = nullptr;
+
+    const JsonValue *find(std::string_view key) const;
+    double number(double fallback = 0) const;
+    std::string_view string(std::string_view fallback = {}) const;
+    const Array *array() const;
+    const Object *object() const;
+};
+
+std::optional<JsonValue> json_parse(std::string_view text);
@@ -0,0 +1,438 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <optional>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "launch.hh"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    /* where the dynamic loader finds libraries when nothing in the app points it elsewhere */
+    constexpr std::array<std::string_view, 8> SYSTEM_LIBRARY_DIRS = {
+        "/lib64", "/usr/lib64", "/lib", "/usr/lib",
+        "/lib/x86_64-linux-gnu", "/usr/lib/x86_64-linux-gnu",
+        "/lib/aarch64-linux-gnu", "/usr/lib/aarch64-linux-gnu",
+    };
+
+    /* fields of an ELF file in its own byte order and word size. nullopt past the end of the file */
+    struct ElfReader
+    {
+        std::span<const std::byte> file;
+        bool big_endian;
+        bool wide;
+
+        std::optional<uint64_t> field(uint64_t offset, size_t width) const
+        {
+            if (offset > file.size() || file.size() - offset < width)
+                return std::nullopt;
+            uint64_t value = 0;
+            for (size_t i = 0; i < width; ++i)
+            {
+                auto byte = static_cast<uint64_t>(file[offset + (big_endian ? i : width - 1 - i)]);
+                value = (value << 8) | byte;
+            }
+            return value;
+        }
+
+        std::optional<uint64_t> word(uint64_t offset) const
+        {
+            return field(offset, wide ? 8 : 4);
+        }
+    };
+
+    struct Segment
+    {
+        uint64_t offset = 0;
+        uint64_t address = 0;
+        uint64_t size = 0;
+    };
+
+    std::string_view filename(std::string_view path)
+    {
+        return path.substr(path.rfind('/') + 1);
+    }
+
+    /* entry names as `EntryPaths` sees them: without leading `/` and `./` */
+    std::string_view trim(std::string_view name)
+    {
+        while (true)
+        {
+            if (name.starts_with('/'))
+                name.remove_prefix(1);
+            else if (name.starts_with("./"))
+                name.remove_prefix(2);
+            else if (name == ".")
+                return {};
+            else
+                return name;
+        }
+    }
+
+    bool is_executable_file(const fs::path &file)
+    {
+        struct stat st;
+        return stat(file.c_str(), &st) == 0 && S_ISREG(st.st_mode) && (st.st_mode & 0111) != 0;
+    }
+}
+
+std::vector<std::string_view> elf_needed(std::span<const std::byte> file)
+{
+    std::vector<std::string_view> names;
+    if (file.size() < EI_NIDENT || std::memcmp(file.data(), ELFMAG, SELFMAG) != 0)
+        return names;
+
+    auto elf_class = static_cast<uint8_t>(file[EI_CLASS]);
+    auto encoding = static_cast<uint8_t>(file[EI_DATA]);
+    if ((elf_class != ELFCLASS32 && elf_class != ELFCLASS64) || (encoding != ELFDATA2LSB && encoding != ELFDATA2MSB))
+        return names;
+
+    ElfReader read{ file, encoding == ELFDATA2MSB, elf_class == ELFCLASS64 };
+    bool wide = read.wide;
+    auto table_offset = read.word(wide ? 32 : 28);
+    auto entry_size = read.field(wide ? 54 : 42, 2);
+    auto entry_count = read.field(wide ? 56 : 44, 2);
+    if (!table_offset || !entry_size || !entry_count)
+        return names;
+
+    std::vector<Segment> loads;
+    std::optional<Segment> dynamic;
+    for (uint64_t i = 0; i < *entry_count; ++i)
+    {
+        auto at = *table_offset + i * *entry_size;
+        auto type = read.field(at, 4);
+        auto offset = read.word(at + (wide ? 8 : 4));
+        auto address = read.word(at + (wide ? 16 : 8));
+        auto size = read.word(at + (wide ? 32 : 16));
+        if (!type || !offset || !address || !size)
+            return names;
+
+        if (*type == PT_LOAD)
+            loads.push_back({ *offset, *address, *size });
+        else if (*type == PT_DYNAMIC)
+            dynamic = Segment{ *offset, *address, *size };
+    }
+    if (!dynamic || dynamic->offset > file.size())
+        return names;
+
+    std::vector<uint64_t> needed;
+    std::optional<uint64_t> strtab;
+    uint64_t pair = wide ? 16 : 8;
+    auto end = dynamic->offset + std::min<uint64_t>(dynamic->size, file.size() - dynamic->offset);
+    for (auto at = dynamic->offset; at + pair <= end; at += pair)
+    {
+        auto tag = read.word(at);
+        auto value = read.word(at + pair / 2);
+        if (!tag || !value || *tag == DT_NULL)
+            break;
+        if (*tag == DT_NEEDED)
+            needed.push_back(*value);
+        else if (*tag == DT_STRTAB)
+            strtab = *value;
+    }
+    if (!strtab)
+        return names;
+
+    /* DT_STRTAB is an address; the segment loaded there says where that is in the file */
+    std::optional<uint64_t> strings;
+    for (const auto &load : loads)
+    {
+        if (*strtab >= load.address && *strtab - load.address < load.size)
+        {
+            strings = load.offset + (*strtab - load.address);
+            break;
+        }
+    }
+    if (!strings || *strings >= file.size())
+        return names;
+
+    auto text = std::string_view(reinterpret_cast<const char *>(file.data() + *strings), file.size() - *strings);
+    for (auto offset : needed)
+    {
+        if (offset >= text.size())
+            continue;
+        auto name = text.substr(offset);
+        name = name.substr(0, name.find('\0'));
+        if (!name.empty() && name.size() < text.size() - offset)
+            names.push_back(name);
+    }
+    return names;
+}
+
+std::vector<std::string> elf_needed(const fs::path &file)
+{
+    std::vector<std::string> names;
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return names;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        auto size = static_cast<size_t>(st.st_size);
+        auto data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED)
+        {
+            for (auto name : elf_needed(std::span(static_cast<const std::byte *>(data), size)))
+                names.emplace_back(name);
+            munmap(data, size);
+        }
+    }
+    close(fd);
+    return names;
+}
+
+std::vector<fs::path> launch_files(const fs::path &executable, const fs::path &root)
+{
+    /* libraries are found by file name anywhere in the tree, which is what an rpath of
+     * `$ORIGIN/../lib` and the like comes down to */
+    std::unordered_map<std::string, fs::path> libraries;
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(root, ec); !ec && it != fs::recursive_directory_iterator();
+            it.increment(ec))
+    {
+        auto name = it->path().filename().string();
+        if (name.find(".so") != std::string::npos && !it->is_directory(ec))
+            libraries.try_emplace(std::move(name), it->path());
+    }
+
+    std::vector<fs::path> files;
+    std::unordered_set<std::string> seen;
+    auto add = [&](const fs::path &path) {
+        /* symlinks such as `libfoo.so.1` stand for the file behind them */
+        std::error_code ec;
+        auto target = fs::canonical(path, ec);
+        if (!ec && fs::is_regular_file(target, ec) && seen.insert(target.string()).second)
+            files.push_back(std::move(target));
+    };
+
+    add(executable);
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        for (const auto &name : elf_needed(files[i]))
+        {
+            if (auto library = libraries.find(name); library != libraries.end())
+                add(library->second);
+        }
+    }
+    return files;
+}
+
+LaunchPlan::LaunchPlan(std::string_view app_name, const std::vector<std::string> &executables,
+        const std::vector<std::string> &profile) :
+    explicit_executables(!executables.empty()), profile(profile.begin(), profile.end())
+{
+    if (explicit_executables)
+    {
+        for (const auto &executable : executables)
+            candidates.emplace_back(trim(executable));
+    }
+    else
+    {
+        std::string app(app_name);
+        candidates = { app, "bin/" + app, app + ".sh", "bin/" + app + ".sh" };
+    }
+}
+
+void LaunchPlan::set_contents(std::span<const std::string_view> names)
+{
+    /* the same test as the install makes afterwards: one directory holding everything */
+    std::optional<std::string_view> top;
+    bool single = true;
+    for (auto name : names)
+    {
+        name = trim(name);
+        if (name.empty())
+            continue;
+        auto slash = name.find('/');
+        auto first = name.substr(0, slash);
+        if (slash == std::string_view::npos || (top && *top != first))
+        {
+            single = false;
+            break;
+        }
+        top = first;
+    }
+
+    prefix = single && top ? std::string(*top) + "/" : std::string();
+    prefix_known = prefix_certain = true;
+    contents_known = true;
+    for (auto name : names)
+    {
+        auto relative = strip(name);
+        if (relative.empty() || relative.ends_with('/'))
+            continue;
+        contents.emplace(relative);
+        content_names.emplace(filename(relative));
+    }
+}
+
+std::string_view LaunchPlan::strip(std::string_view name, bool &outside)
+{
+    outside = false;
+    name = trim(name);
+    if (!prefix_known)
+    {
+        if (name.empty())
+            return name;
+        /* a guess: an archive made with `tar czf app.tar.gz app-1.0` names its directory first */
+        auto slash = name.find('/');
+        prefix = slash == std::string_view::npos ? std::string() : std::string(name.substr(0, slash + 1));
+        prefix_known = true;
+    }
+
+    if (prefix.empty())
+        return name;
+    if (name.starts_with(prefix))
+        return name.substr(prefix.size());
+    if (name.empty() || name == std::string_view(prefix).substr(0, prefix.size() - 1))
+        return {};
+
+    outside = !prefix_certain;
+    return name;
+}
+
+std::string_view LaunchPlan::strip(std::string_view name)
+{
+    bool outside;
+    return strip(name, outside);
+}
+
+std::string LaunchPlan::drop_prefix()
+{
+    auto top = prefix.substr(0, prefix.size() - 1);
+    prefix.clear();
+    if (!main_executable.empty())
+        main_executable = top + "/" + main_executable;
+    return top;
+}
+
+std::string_view LaunchPlan::top_directory() const
+{
+    return std::string_view(prefix).substr(0, prefix.empty() ? 0 : prefix.size() - 1);
+}
+
+bool LaunchPlan::wants(std::string_view relative) const
+{
+    if (relative.empty())
+        return false;
+    return std::ranges::find(candidates, relative) != candidates.end() || profile.contains(relative) ||
+           needed.contains(filename(relative));
+}
+
+uint64_t LaunchPlan::generation() const
+{
+    return changes;
+}
+
+bool LaunchPlan::written(std::string_view relative, const fs::path &file, std::string_view link_target)
+{
+    if (is_ready)
+        return false;
+
+    auto name = filename(relative);
+    if (name.find(".so") != std::string_view::npos)
+    {
+        if (link_target.empty())
+            libraries.insert_or_assign(std::string(name), file.string());
+        else
+            links.insert_or_assign(std::string(name), std::string(filename(link_target)));
+    }
+    if (!wants(relative))
+        return false;
+
+    /* the other `--link` binaries are written early too, but only the first one is what gets launched */
+    bool candidate = explicit_executables ? relative == candidates.front() :
+            std::ranges::find(candidates, relative) != candidates.end();
+    if (main_executable.empty() && candidate && (!link_target.empty() || is_executable_file(file)))
+        main_executable = relative;
+
+    written_paths.emplace(relative);
+    written_names.emplace(name);
+
+    /* `bin/app -> ../lib/app/app` or `libfoo.so.1 -> libfoo.so.1.2`: the file it points at is what runs */
+    if (!link_target.empty())
+        need(filename(link_target));
+    else
+    {
+        for (const auto &name : elf_needed(file))
+            need(name);
+    }
+
+    if (!settled())
+        return false;
+    is_ready = true;
+    return true;
+}
+
+bool LaunchPlan::ready() const
+{
+    return is_ready;
+}
+
+const std::string &LaunchPlan::executable() const
+{
+    return main_executable;
+}
+
+void LaunchPlan::need(std::string_view soname)
+{
+    if (soname.empty() || !needed.emplace(soname).second)
+        return;
+    ++changes;
+
+    /* written before anything asked for it, so what it needs in turn is only found out now */
+    if (auto link = links.find(soname); link != links.end())
+        need(link->second);
+    else if (auto library = libraries.find(soname); library != libraries.end())
+    {
+        for (const auto &name : elf_needed(library->second))
+            need(name);
+    }
+}
+
+bool LaunchPlan::settled() const
+{
+    if (main_executable.empty())
+        return false;
+
+    /* a library the archive does not ship comes from the system. a streamed archive's contents are not
+     * known in advance, so there a library the system has is not waited for either */
+    for (const auto &name : needed)
+    {
+        if (written_names.contains(name) || libraries.contains(name) || links.contains(name))
+            continue;
+        if (contents_known ? !content_names.contains(name) : on_system(name))
+            continue;
+        return false;
+    }
+
+    if (contents_known)
+    {
+        for (const auto &path : profile)
+        {
+            if (contents.contains(path) && !written_paths.contains(path))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool LaunchPlan::on_system(const std::string &soname) const
+{
+    if (auto it = system_libraries.find(soname); it != system_libraries.end())
+        return it->second;
+
+    bool found = std::ranges::any_of(SYSTEM_LIBRARY_DIRS, [&](std::string_view dir) {
+        return access((fs::path(dir) / soname).c_str(), F_OK) == 0;
+    });
+    system_libraries.emplace(soname, found);
+    return found;
+}
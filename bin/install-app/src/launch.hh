@@ -0,0 +1,102 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/* the sonames an ELF file's dynamic section lists as DT_NEEDED, as views into `file`. empty for
+ * anything that is not a dynamically linked ELF file */
+std::vector<std::string_view> elf_needed(std::span<const std::byte> file);
+/* the same for a file on disk */
+std::vector<std::string> elf_needed(const std::filesystem::path &file);
+
+/* `executable` and the libraries below `root` that it loads, following DT_NEEDED from library to
+ * library, each as the regular file behind any symlinks */
+std::vector<std::filesystem::path> launch_files(const std::filesystem::path &executable,
+        const std::filesystem::path &root);
+
+/* what an app needs in order to start, so that launch-first extraction can write it before everything
+ * else: the main executable, the libraries from the archive it links against (followed through their
+ * own DT_NEEDED entries, and through symlinks such as `libfoo.so.1 -> libfoo.so.1.2`), and the files a
+ * recorded startup profile lists. paths are relative to the install, that is without the archive's
+ * top-level directory, which is left out as it is being extracted */
+class LaunchPlan
+{
+public:
+    /* `executables` are the `--link` binaries, the first being the main one. without any, whichever of
+     * `<app>`, `bin/<app>`, `<app>.sh` and `bin/<app>.sh` is extracted first and is executable */
+    LaunchPlan(std::string_view app_name, const std::vector<std::string> &executables,
+            const std::vector<std::string> &profile);
+
+    /* every entry name, when the archive lists them up front (zip). the top-level directory is then
+     * known for certain, and libraries and profile files the archive does not have are not waited for */
+    void set_contents(std::span<const std::string_view> names);
+
+    /* `name` without the archive's top-level directory. a streamed archive's first name decides what that
+     * directory is; `outside` is set for a later name that is not in it, after which `drop_prefix()`
+     * must be called before going on */
+    std::string_view strip(std::string_view name, bool &outside);
+    std::string_view strip(std::string_view name);
+    /* forgets the top-level directory, returning it, for when the guess turns out wrong */
+    std::string drop_prefix();
+    /* the directory being left out, empty when there is none */
+    std::string_view top_directory() const;
+
+    bool wants(std::string_view relative) const;
+    /* changes whenever `wants()` may answer yes to something new, so that a reader that reorders knows
+     * when to look again */
+    uint64_t generation() const;
+
+    /* a regular file or symlink has been written to `file`. true the one time this makes the plan ready */
+    bool written(std::string_view relative, const std::filesystem::path &file, std::string_view link_target);
+    bool ready() const;
+    /* the main executable, relative to the install */
+    const std::string &executable() const;
+
+private:
+    /* lookups by `string_view` without building a string */
+    struct Hash
+    {
+        using is_transparent = void;
+        size_t operator()(std::string_view text) const
+        {
+            return std::hash<std::string_view>()(text);
+        }
+    };
+    using Set = std::unordered_set<std::string, Hash, std::equal_to<>>;
+
+    void need(std::string_view soname);
+    bool settled() const;
+    bool on_system(const std::string &soname) const;
+
+    std::vector<std::string> candidates;
+    bool explicit_executables = false;
+    Set profile;
+    Set needed;
+
+    std::string prefix;
+    bool prefix_known = false;
+    bool prefix_certain = false;
+    bool contents_known = false;
+    Set contents;
+    Set content_names;
+
+    std::string main_executable;
+    Set written_paths;
+    Set written_names;
+    /* every library written so far, wanted or not, by file name: files with where they are, and symlinks
+     * with the name they point at. something may need them later */
+    std::unordered_map<std::string, std::string, Hash, std::equal_to<>> libraries;
+    std::unordered_map<std::string, std::string, Hash, std::equal_to<>> links;
+    uint64_t changes = 0;
+    bool is_ready = false;
+    mutable std::unordered_map<std::string, bool, Hash, std::equal_to<>> system_libraries;
+};
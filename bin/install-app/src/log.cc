@@ -0,0 +1,399 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "json.hh"
+#include "log.hh"
+
+using namespace std::chrono_literals;
+
+namespace
+{
+    /* how many copies of a repeated message are shown before the rest are folded into a count */
+    constexpr uint64_t burst = 3;
+    constexpr auto flush_interval = 50ms;
+
+    struct Record
+    {
+        uint64_t sequence = 0;
+        LogLevel level = LogLevel::INFO;
+        size_t offset = 0;
+        size_t length = 0;
+        int64_t timestamp_us = 0;
+    };
+
+    struct ThreadBuffer
+    {
+        std::mutex lock;
+        pid_t tid = 0;
+        std::string text;
+        std::vector<Record> records;
+    };
+
+    struct Run
+    {
+        bool active = false;
+        LogLevel level = LogLevel::INFO;
+        std::string message;
+        uint64_t count = 0;
+        uint64_t suppressed = 0;
+    };
+
+    std::string_view level_name(LogLevel level)
+    {
+        switch (level)
+        {
+            case LogLevel::INFO:
+                return "info";
+            case LogLevel::WARN:
+                return "warn";
+            case LogLevel::ERROR:
+                return "error";
+        }
+        return "info";
+    }
+
+    std::string_view level_color(LogLevel level)
+    {
+        switch (level)
+        {
+            case LogLevel::INFO:
+                return "\033[0;36m";
+            case LogLevel::WARN:
+                return "\033[0;33m";
+            case LogLevel::ERROR:
+                return "\033[0;31m";
+        }
+        return "";
+    }
+
+    class Logger
+    {
+    public:
+        ~Logger()
+        {
+            if (flusher.joinable())
+            {
+                flusher.request_stop();
+                wakeup.notify_all();
+                flusher.join();
+            }
+
+            flush();
+            if (json_fd >= 0)
+                close(json_fd);
+        }
+
+        ThreadBuffer &local()
+        {
+            thread_local ThreadBuffer *buffer = nullptr;
+            if (buffer)
+                return *buffer;
+
+            auto owned = std::make_unique<ThreadBuffer>();
+            owned->tid = gettid();
+            buffer = owned.get();
+
+            std::lock_guard guard(registry_lock);
+            buffers.push_back(std::move(owned));
+            return *buffer;
+        }
+
+        void commit(LogLevel level, std::string_view message)
+        {
+            std::call_once(started, [this]
+            {
+                flusher = std::jthread([this](std::stop_token token)
+                {
+                    run(token);
+                });
+            });
+
+            auto &buffer = local();
+            {
+                std::lock_guard guard(buffer.lock);
+                buffer.records.push_back(Record{
+                    .sequence = sequence.fetch_add(1, std::memory_order_relaxed),
+                    .level = level,
+                    .offset = buffer.text.size(),
+                    .length = message.size(),
+                    .timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::system_clock::now().time_since_epoch()).count(),
+                });
+                buffer.text.append(message);
+            }
+
+            if (sync_depth.load(std::memory_order_relaxed) > 0)
+                flush();
+            else if (level == LogLevel::ERROR)
+                wakeup.notify_all();
+        }
+
+        void flush()
+        {
+            std::lock_guard guard(output_lock);
+            drain();
+            close_run();
+            write_out();
+        }
+
+        void status(std::string_view line, bool last)
+        {
+            std::lock_guard guard(output_lock);
+            /* whatever was logged before it goes above it */
+            if (last)
+            {
+                drain();
+                write_out();
+            }
+            status_line.assign(line);
+            std::fputs("\r\033[K", stderr);
+            std::fwrite(status_line.data(), 1, status_line.size(), stderr);
+            if (last)
+            {
+                std::fputc('\n', stderr);
+                status_line.clear();
+            }
+            status_shown = !last;
+            std::fflush(stderr);
+        }
+
+        bool open_json(const std::filesystem::path &path)
+        {
+            std::lock_guard guard(output_lock);
+            int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if (fd < 0)
+                return false;
+            if (json_fd >= 0)
+                close(json_fd);
+            json_fd = fd;
+            return true;
+        }
+
+        std::atomic<int> sync_depth = 0;
+
+    private:
+        void run(std::stop_token token)
+        {
+            std::mutex wait_lock;
+            std::unique_lock wait_guard(wait_lock);
+
+            while (!token.stop_requested())
+            {
+                wakeup.wait_for(wait_guard, token, flush_interval, [] { return false; });
+
+                std::lock_guard guard(output_lock);
+                drain();
+                write_out();
+            }
+        }
+
+        /* takes every thread's pending records and replays them in logging order */
+        void drain()
+        {
+            {
+                std::lock_guard guard(registry_lock);
+                batch_texts.resize(buffers.size());
+                batch.clear();
+
+                for (size_t i = 0; i < buffers.size(); ++i)
+                {
+                    auto &buffer = *buffers[i];
+                    std::lock_guard buffer_guard(buffer.lock);
+
+                    batch_texts[i].clear();
+                    batch_texts[i].swap(buffer.text);
+                    for (const auto &record : buffer.records)
+                        batch.push_back({ record, i, buffer.tid });
+                    buffer.records.clear();
+                }
+            }
+
+            std::sort(batch.begin(), batch.end(), [](const auto &lhs, const auto &rhs)
+            {
+                return lhs.record.sequence < rhs.record.sequence;
+            });
+
+            for (const auto &[record, index, tid] : batch)
+            {
+                auto message = std::string_view(batch_texts[index]).substr(record.offset, record.length);
+                emit_json(record.level, message, tid, record.timestamp_us);
+
+                if (current.active && current.level == record.level && current.message == message)
+                {
+                    if (++current.count <= burst)
+                        emit_terminal(record.level, message);
+                    else
+                        current.suppressed++;
+                    continue;
+                }
+
+                close_run();
+                /* every error is shown, however often it repeats */
+                if (record.level != LogLevel::ERROR)
+                {
+                    current.active = true;
+                    current.level = record.level;
+                    current.message.assign(message);
+                    current.count = 1;
+                }
+                emit_terminal(record.level, message);
+            }
+        }
+
+        void close_run()
+        {
+            /* the sink has had every repeat already, so only the terminal hears how many it missed */
+            if (current.active && current.suppressed > 0)
+                emit_terminal(current.level, std::format("{} (x{} repeats suppressed)", current.message,
+                        current.suppressed));
+            /* the message's buffer is kept for the next run */
+            current.active = false;
+            current.count = 0;
+            current.suppressed = 0;
+        }
+
+        void emit_terminal(LogLevel level, std::string_view message)
+        {
+            auto &out = level == LogLevel::INFO ? stdout_text : stderr_text;
+            out += level_color(level);
+            out += message;
+            out += "\n\033[0m";
+        }
+
+        void emit_json(LogLevel level, std::string_view message, pid_t tid, int64_t timestamp_us)
+        {
+            if (json_fd < 0)
+                return;
+
+            json_text += std::format("{{\"ts\":{}.{:06},\"level\":\"{}\",\"tid\":{},\"message\":\"{}\"", timestamp_us / 1000000,
+                    timestamp_us % 1000000, level_name(level), tid, json_escape(message));
+            json_text += "}\n";
+        }
+
+        /* one write per stream per batch; stdio keeps ordering with direct prints on the same stream */
+        void write_out()
+        {
+            bool covering = status_shown && (!stdout_text.empty() || !stderr_text.empty());
+            if (covering)
+            {
+                std::fputs("\r\033[K", stderr);
+                std::fflush(stderr);
+            }
+
+            if (!stdout_text.empty())
+            {
+                std::fwrite(stdout_text.data(), 1, stdout_text.size(), stdout);
+                std::fflush(stdout);
+                stdout_text.clear();
+            }
+
+            if (!stderr_text.empty())
+            {
+                std::fwrite(stderr_text.data(), 1, stderr_text.size(), stderr);
+                std::fflush(stderr);
+                stderr_text.clear();
+            }
+
+            if (covering)
+            {
+                std::fwrite(status_line.data(), 1, status_line.size(), stderr);
+                std::fflush(stderr);
+            }
+
+            if (!json_text.empty())
+            {
+                auto written = write(json_fd, json_text.data(), json_text.size());
+                static_cast<void>(written);
+                json_text.clear();
+            }
+        }
+
+        struct Pending
+        {
+            Record record;
+            size_t buffer;
+            pid_t tid;
+        };
+
+        std::mutex registry_lock;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+        std::mutex output_lock;
+        std::condition_variable_any wakeup;
+        std::once_flag started;
+        std::jthread flusher;
+        std::atomic<uint64_t> sequence = 0;
+        int json_fd = -1;
+        Run current;
+        std::vector<Pending> batch;
+        std::vector<std::string> batch_texts;
+        std::string stdout_text;
+        std::string stderr_text;
+        std::string json_text;
+        std::string status_line;
+        bool status_shown = false;
+    };
+
+    Logger logger;
+
+    std::string &scratch()
+    {
+        thread_local std::string buffer;
+        return buffer;
+    }
+}
+
+namespace logging
+{
+    std::string &begin()
+    {
+        auto &buffer = scratch();
+        buffer.clear();
+        return buffer;
+    }
+
+    void commit(LogLevel level)
+    {
+        logger.commit(level, scratch());
+    }
+
+    void flush()
+    {
+        logger.flush();
+    }
+
+    bool open_json_sink(const std::filesystem::path &path)
+    {
+        return logger.open_json(path);
+    }
+
+    void status(std::string_view line)
+    {
+        logger.status(line, false);
+    }
+
+    void end_status(std::string_view line)
+    {
+        logger.status(line, true);
+    }
+
+    Sync::Sync()
+    {
+        logger.sync_depth.fetch_add(1, std::memory_order_relaxed);
+        logger.flush();
+    }
+
+    Sync::~Sync()
+    {
+        logger.sync_depth.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
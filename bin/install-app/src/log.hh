@@ -0,0 +1,68 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <filesystem>
+#include <format>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+enum class LogLevel
+{
+    INFO,
+    WARN,
+    ERROR
+};
+
+/* messages are formatted straight into a per-thread buffer and written out in batches by a background
+ * flusher, so logging from the extraction loop never blocks on the terminal. on the terminal, a message
+ * repeated word for word is collapsed into a count once it starts repeating; errors never are, and the
+ * JSON sink gets every message */
+namespace logging
+{
+    /* returns this thread's scratch buffer, cleared; `commit()` queues whatever was formatted into it */
+    std::string &begin();
+    void commit(LogLevel level);
+
+    /* drains every buffer synchronously; call before writing to the terminal directly or prompting */
+    void flush();
+    bool open_json_sink(const std::filesystem::path &path);
+
+    /* a line redrawn in place at the bottom of stderr, such as a progress display. messages written while
+     * it is up clear it first and draw it again below them. `end_status()` draws it one last time and
+     * leaves it where it is */
+    void status(std::string_view line);
+    void end_status(std::string_view line);
+
+    /* while alive, every message is flushed as soon as it is logged */
+    class Sync
+    {
+    public:
+        Sync();
+        Sync(const Sync &) = delete;
+        Sync &operator=(const Sync &) = delete;
+        ~Sync();
+    };
+}
+
+template<typename... Args>
+void error(std::format_string<Args...> fmt, Args&&... args)
+{
+    std::format_to(std::back_inserter(logging::begin()), fmt, std::forward<Args>(args)...);
+    logging::commit(LogLevel::ERROR);
+}
+
+template<typename... Args>
+void warn(std::format_string<Args...> fmt, Args&&... args)
+{
+    std::format_to(std::back_inserter(logging::begin()), fmt, std::forward<Args>(args)...);
+    logging::commit(LogLevel::WARN);
+}
+
+template<typename... Args>
+void info(std::format_string<Args...> fmt, Args&&... args)
+{
+    std::format_to(std::back_inserter(logging::begin()), fmt, std::forward<Args>(args)...);
+    logging::commit(LogLevel::INFO);
+}
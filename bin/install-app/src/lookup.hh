@@ -0,0 +1,169 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+/* a fixed table of strings known at compile time, laid out so that every key hashes to a slot of its
+ * own. the compiler searches for a seed that makes the layout collision-free, so a lookup is one hash,
+ * one slot and one comparison, and never allocates */
+template <typename Value>
+struct PerfectEntry
+{
+    std::string_view key;
+    Value value = {};
+};
+
+template <typename Value, size_t N>
+class PerfectMap
+{
+public:
+    using Entry = PerfectEntry<Value>;
+
+    consteval explicit PerfectMap(const std::array<Entry, N> &entries)
+    {
+        for (size_t i = 0; i < N; ++i)
+        {
+            for (size_t j = 0; j < i; ++j)
+            {
+                if (entries[i].key == entries[j].key || entries[i].key.empty())
+                    throw "keys must be unique and not empty";
+            }
+        }
+
+        for (seed = 0;; ++seed)
+        {
+            if (place(entries))
+                return;
+        }
+    }
+
+    constexpr const Value *find(std::string_view key) const
+    {
+        const auto &slot = slots[index(key)];
+        /* empty slots have an empty key, which is never a key of the table */
+        return !key.empty() && slot.key == key ? &slot.value : nullptr;
+    }
+
+    constexpr bool contains(std::string_view key) const
+    {
+        return find(key) != nullptr;
+    }
+
+private:
+    /* a quarter full keeps the seed search short */
+    static constexpr size_t SLOTS = std::bit_ceil(N * 4);
+    static constexpr int SHIFT = 64 - std::countr_zero(SLOTS);
+
+    constexpr size_t index(std::string_view key) const
+    {
+        /* FNV-1a keyed by the seed. short keys leave its top bits nearly untouched, so they are mixed
+         * down once before taking them */
+        uint64_t hash = 0xcbf29ce484222325ULL ^ seed;
+        for (auto c : key)
+            hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+        hash ^= hash >> 32;
+        hash *= 0xbf58476d1ce4e5b9ULL;
+        return static_cast<size_t>(hash >> SHIFT);
+    }
+
+    consteval bool place(const std::array<Entry, N> &entries)
+    {
+        slots = {};
+        for (const auto &entry : entries)
+        {
+            auto &slot = slots[index(entry.key)];
+            if (!slot.key.empty())
+                return false;
+            slot = entry;
+        }
+        return true;
+    }
+
+    std::array<Entry, SLOTS> slots = {};
+    uint64_t seed = 0;
+};
+
+/* `perfect_map<Kind>({ { "key", Kind::A }, ... })`, with the size taken from the list */
+template <typename Value, size_t N>
+consteval PerfectMap<Value, N> perfect_map(const PerfectEntry<Value> (&entries)[N])
+{
+    return PerfectMap<Value, N>(std::to_array(entries));
+}
+
+template <size_t N>
+consteval PerfectMap<bool, N> perfect_set(const std::string_view (&keys)[N])
+{
+    std::array<PerfectEntry<bool>, N> entries;
+    for (size_t i = 0; i < N; ++i)
+        entries[i] = { keys[i], true };
+    return PerfectMap<bool, N>(entries);
+}
+
+/* views into a path's own storage, so classifying a name never copies it */
+namespace names
+{
+    /* the last component, empty when the path ends in a separator */
+    inline std::string_view filename(const std::filesystem::path &path)
+    {
+        std::string_view native = path.native();
+        return native.substr(native.rfind('/') + 1);
+    }
+
+    /* from the last dot, as `path::extension()` splits it: a leading dot starts a name, not an
+     * extension */
+    inline std::string_view extension(std::string_view filename)
+    {
+        auto dot = filename.rfind('.');
+        if (dot == std::string_view::npos || dot == 0 || filename == "..")
+            return {};
+        return filename.substr(dot);
+    }
+
+    /* the last `parts` dot-separated suffixes, such as `.tar.gz` for two. empty when there are fewer */
+    inline std::string_view suffix(std::string_view filename, int parts)
+    {
+        auto dot = filename.size();
+        for (int i = 0; i < parts; ++i)
+        {
+            if (dot == 0)
+                return {};
+            dot = filename.rfind('.', dot - 1);
+            if (dot == std::string_view::npos)
+                return {};
+        }
+        return filename.substr(dot);
+    }
+
+    /* what numbers one piece of an archive cut up with `split` or 7-Zip: `.001`, or `.part-aa` and so
+     * on. empty for anything else. three digits at least, so a version such as `-3.12` is not taken
+     * for one */
+    inline std::string_view volume_suffix(std::string_view filename)
+    {
+        auto dot = filename.rfind('.');
+        if (dot == std::string_view::npos || dot == 0)
+            return {};
+
+        auto piece = filename.substr(dot + 1);
+        auto all_of = [](std::string_view text, auto test) {
+            for (auto c : text)
+            {
+                if (!test(c))
+                    return false;
+            }
+            return true;
+        };
+
+        if (piece.size() >= 3 && all_of(piece, [](char c) { return c >= '0' && c <= '9'; }))
+            return filename.substr(dot);
+        if (piece.starts_with("part-") && piece.size() >= 7 &&
+                all_of(piece.substr(5), [](char c) { return c >= 'a' && c <= 'z'; }))
+            return filename.substr(dot);
+        return {};
+    }
+}
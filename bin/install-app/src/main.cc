@@ -10,8 +10,25 @@
 #include <system_error>
 #include <fstream>
 #include <optional>
-#include <archive.h>
-#include <archive_entry.h>
+#include <chrono>
+#include <unordered_set>
+#include <charconv>
+#include "app.hh"
+#include "archive.hh"
+#include "history.hh"
+#include "input.hh"
+#include "json.hh"
+#include "launch.hh"
+#include "log.hh"
+#include "manifest.hh"
+#include "memstats.hh"
+#include "profile.hh"
+#include "progress.hh"
+#include "timings.hh"
+#include "trace.hh"
+#include "units.hh"
+#include "verify.hh"
+#include "warm.hh"
 
 namespace fs = std::filesystem;
 
@@ -35,223 +52,63 @@ struct Config
     bool no_link = false;
     bool force = false;
     bool create_desktop = false;
+    bool timings = false;
+    fs::path timings_json;
+    fs::path trace_file;
+    fs::path history_file;
+    fs::path metrics_textfile;
+    fs::path log_json;
+    bool stats = false;
+    std::string verify_app;
+    std::string profile_app;
+    std::chrono::seconds profile_limit{ 10 };
+    bool scrub = false;
+    bool no_manifest = false;
+    NestedArchives nested;
+    bool launch_first = false;
+    bool warm = false;
+    bool gentle = false;
+    std::optional<Sha256::Digest> expected_sha256;
+    fs::path checksums_file;
+    bool progress = true;
+    bool mem_stats = false;
     std::optional<DesktopEntryConfig> desktop_config;
 };
 
-enum class ArchiveFormat
+enum class Outcome
 {
-    TAR,
-    TAR_GZ,
-    TAR_BZ2,
-    TAR_XZ,
-    ZIP,
-    DEB,
-    RPM,
-    UNKNOWN
+    SUCCESS,
+    FAILED,
+    CANCELLED
 };
 
-template<typename... Args>
-void error(std::format_string<Args...> fmt, Args&&... args)
+struct InstallResult
 {
-    std::print(stderr, "\033[0;31m");
-    std::println(stderr, fmt, std::forward<Args>(args)...);
-    std::print(stderr, "\033[0m");
-}
-
-template<typename... Args>
-void warn(std::format_string<Args...> fmt, Args&&... args)
-{
-    std::print(stderr, "\033[0;33m");
-    std::println(stderr, fmt, std::forward<Args>(args)...);
-    std::print(stderr, "\033[0m");
-}
-
-template<typename... Args>
-void info(std::format_string<Args...> fmt, Args&&... args)
-{
-    std::print("\033[0;36m");
-    std::println(fmt, std::forward<Args>(args)...);
-    std::print("\033[0m");
-}
-
-std::expected<void, std::string> extract(const fs::path &archive_path, const fs::path &dest_path, ArchiveFormat format)
-{
-    archive *a = archive_read_new();
-    archive *ext = archive_write_disk_new();
-
-    if (!a || !ext)
-        return std::unexpected("Failed to create archive objects");
-
-    archive_write_disk_set_options(
-        ext, ARCHIVE_EXTRACT_TIME | ARCHIVE_EXTRACT_PERM | ARCHIVE_EXTRACT_ACL | ARCHIVE_EXTRACT_FFLAGS);
-
-    archive_read_support_format_all(a);
-    archive_read_support_filter_all(a);
-
-    auto r = archive_read_open_filename(a, archive_path.c_str(), 10240);
-    if (r != ARCHIVE_OK)
-    {
-        auto err = std::format("Failed to open archive because: {}", archive_error_string(a));
-        archive_read_free(a);
-        archive_write_free(ext);
-        return std::unexpected(err);
-    }
-
-    archive_entry *entry = {};
-    while (archive_read_next_header(a, &entry) == ARCHIVE_OK)
-    {
-        const char *current_file = archive_entry_pathname(entry);
-        auto full_path = dest_path / current_file;
-        archive_entry_set_pathname(entry, full_path.c_str());
-
-        r = archive_write_header(ext, entry);
-        if (r != ARCHIVE_OK)
-        {
-            warn("Archive write header: {}", archive_error_string(ext));
-        }
-        else
-        {
-            const void *buff;
-            size_t size;
-            la_int64_t offset;
-
-            while (archive_read_data_block(a, &buff, &size, &offset) == ARCHIVE_OK)
-            {
-                if (archive_write_data_block(ext, buff, size, offset) != ARCHIVE_OK)
-                    warn("Archive write data block: {}", archive_error_string(ext));
-            }
-        }
-
-        archive_write_finish_entry(ext);
-    }
-
-    archive_read_close(a);
-    archive_read_free(a);
-    archive_write_close(ext);
-    archive_write_free(ext);
-
-    return {};
-}
-
-ArchiveFormat detect_format(const fs::path &path)
-{
-    auto ext = path.extension().string();
-    auto filename = path.filename().string();
-
-    if (filename.ends_with(".tar.gz") || filename.ends_with(".tgz"))
-        return ArchiveFormat::TAR_GZ;
-    if (filename.ends_with(".tar.bz2") || filename.ends_with(".tbz2"))
-        return ArchiveFormat::TAR_BZ2;
-    if (filename.ends_with(".tar.xz") || filename.ends_with(".txz"))
-        return ArchiveFormat::TAR_XZ;
-    if (ext == ".tar")
-        return ArchiveFormat::TAR;
-    if (ext == ".zip")
-        return ArchiveFormat::ZIP;
-    if (ext == ".deb")
-        return ArchiveFormat::DEB;
-    if (ext == ".rpm")
-        return ArchiveFormat::RPM;
-
-    return ArchiveFormat::UNKNOWN;
-}
+    Outcome outcome = Outcome::FAILED;
+    ArchiveFormat format = ArchiveFormat::UNKNOWN;
+    ExtractStats stats;
+};
 
-std::string detect_app_name(const fs::path &archive_file)
+/* calls `leave` however the scope is left, by an exception too */
+template <typename Leave>
+class OnLeave
 {
-    auto name = archive_file.stem().string();
-
-    if (name.ends_with(".tar"))
-        name = name.substr(0, name.length() - 4);
-
-    auto dash_pos = name.find_last_of('-');
-    if (dash_pos != std::string::npos)
+public:
+    explicit OnLeave(Leave leave) : leave(std::move(leave))
     {
-        auto version_part = name.substr(dash_pos + 1);
-        if (!version_part.empty() && std::isdigit(version_part[0]))
-            name = name.substr(0, dash_pos);
     }
 
-    return name;
-}
-
-bool is_valid_executable(const fs::path &path)
-{
-    static const std::vector<std::string> excluded_extensions = {
-        ".so", ".a", ".o", ".la", ".dylib", ".dll",
-        ".sh", ".bash", ".zsh", ".fish", ".py", ".pl", ".rb",
-        ".txt", ".md", ".xml", ".json", ".conf", ".cfg"
-    };
-
-    auto filename = path.filename().string();
-    auto extension = path.extension().string();
-
-    for (const auto &ext : excluded_extensions)
+    ~OnLeave()
     {
-        if (extension == ext)
-            return false;
+        leave();
     }
 
-    if (filename.starts_with("."))
-        return false;
-
-    return true;
-}
+    OnLeave(const OnLeave &) = delete;
+    OnLeave &operator=(const OnLeave &) = delete;
 
-std::vector<fs::path> find_executables(const fs::path &dir, size_t max_results = 20)
-{
-    std::vector<fs::path> executables;
-
-    try
-    {
-        for (const auto &entry : fs::recursive_directory_iterator(dir))
-        {
-            if (entry.is_regular_file())
-            {
-                auto perms = entry.status().permissions();
-                if ((perms & fs::perms::owner_exec) == fs::perms::owner_exec)
-                {
-                    if (is_valid_executable(entry.path()))
-                    {
-                        executables.push_back(entry.path());
-                        if (executables.size() >= max_results)
-                            break;
-                    }
-                }
-            }
-        }
-    }
-    catch (const fs::filesystem_error &e)
-    {
-        warn("Filesystem error: {}", e.what());
-    }
-
-    return executables;
-}
-
-std::optional<fs::path> find_icon(const fs::path &install_dir, const std::string &app_name)
-{
-    std::vector<std::string> icon_patterns = {
-        "bin/" + app_name + ".svg",
-        "bin/" + app_name + ".png",
-        "share/icons/" + app_name + ".svg",
-        "share/icons/" + app_name + ".png",
-        "share/pixmaps/" + app_name + ".svg",
-        "share/pixmaps/" + app_name + ".png",
-        "icon.svg",
-        "icon.png",
-        app_name + ".svg",
-        app_name + ".png"
-    };
-
-    for (const auto &pattern : icon_patterns)
-    {
-        auto icon_path = install_dir / pattern;
-        if (fs::exists(icon_path))
-            return icon_path;
-    }
-
-    return std::nullopt;
-}
+private:
+    Leave leave;
+};
 
 void create_desktop_entry(const DesktopEntryConfig &config)
 {
@@ -329,7 +186,8 @@ void create_symlink(const fs::path &target, const fs::path &link)
 
 void print_usage(std::string_view program_name)
 {
-    info("Usage: {} <options> <archive-file>\n", program_name);
+    logging::Sync sync;
+    info("Usage: {} <options> <archive-file | ->\n", program_name);
     std::println("Install applications from various archive formats.\n");
     info("Available options:");
     std::println("    -d, --dir <path>       Installation directory. Default: /opt");
@@ -343,20 +201,75 @@ void print_usage(std::string_view program_name)
     std::println("    --comment <text>       Comment for desktop entry");
     std::println("    --categories <cats>    Categories for desktop entry (e.g., Development;IDE;)");
     std::println("    --terminal             Mark desktop entry as terminal application");
+    std::println("    --log-json <path>      Append log messages as JSON lines");
+    std::println("    --no-progress          Don't show extraction progress");
+    std::println("    --timings              Print a per-phase timing and resource report");
+    std::println("    --timings-json <path>  Write the timing report as JSON");
+    std::println("    --mem-stats            Print peak RSS and allocations per phase");
+    std::println("    --trace <path>         Write a per-entry Chrome/Perfetto trace");
+    std::println("    --history <path>       Install history file. Default: ~/.local/state/install-app/history.jsonl");
+    std::println("    --no-history           Don't record this run in the install history");
+    std::println("    --metrics-textfile <path>  Write node_exporter textfile metrics");
+    std::println("    --stats                Summarise install throughput by format from the history");
+    std::println("    --sha256 <hex>         Install only if the archive has this SHA-256 digest");
+    std::println("    --checksums <path>     Take the digest from a SHA256SUMS file");
+    std::println("    --nested               Extract members that are archives themselves, in place of the member");
+    std::println("    --nested-rule <glob>   Treat members matching this pattern as nested archives");
+    std::println("    --launch-first         Extract what the app needs to start first, in place, and say when it can run");
+    std::println("    --warm                 Read the executable and its libraries into the page cache after install");
+    std::println("    --gentle               With --warm, drop everything else the install touched from the cache");
+    std::println("    --profile-startup <app>  Run an installed app once and record the files it opens, to lay them out first");
+    std::println("    --profile-seconds <n>  How long --profile-startup lets the app run. Default: 10");
+    std::println("    --no-manifest          Don't record file hashes for later verification");
+    std::println("    --verify <app>         Re-hash an installed app and list files that changed since install");
+    std::println("    --scrub                Verify every installed app at idle priority");
     std::println("    -h, --help             Show this help message");
     std::println("    -v, --version          Show version\n");
     info("Supported formats:");
-    std::println("    .tar, .tar.gz, .tgz, .tar.bz2, .tar.xz, .zip, .deb, .rpm\n");
+    std::println("    .tar, .tar.gz, .tgz, .tar.bz2, .tar.xz, .zip, .deb, .rpm, .run (makeself),\n    single executables (bare, .gz, .xz, .bz2, .zst)\n");
     info("Examples:");
     std::println("    {} app-1.0.tar.gz", program_name);
     std::println("    {} -d /usr/local -n myapp app.tar.gz", program_name);
     std::println("    {} -l bin/app,bin/app-cli app.zip", program_name);
     std::println("    {} --desktop --categories \"Development;IDE;\" clion.tar.gz", program_name);
+    std::println("    curl -L https://example.com/app.tar.gz | {} -n app -", program_name);
+}
+
+/* the digest listed for `archive` in a `sha256sum` output file, matched on the file name */
+std::expected<Sha256::Digest, std::string> read_checksum(const fs::path &sums, const fs::path &archive)
+{
+    std::ifstream file(sums);
+    if (!file)
+        return std::unexpected(std::format("Could not read checksums: {}", sums.string()));
+
+    auto wanted = archive.filename().string();
+    std::string line;
+    while (std::getline(file, line))
+    {
+        /* `<digest>  <name>`, or `<digest> *<name>` for files hashed in binary mode */
+        std::string_view rest(line);
+        auto space = rest.find(' ');
+        if (space == std::string_view::npos || space + 1 >= rest.size())
+            continue;
+        auto digest = rest.substr(0, space);
+        auto name = rest.substr(space + 2);
+        if (rest[space + 1] != ' ' && rest[space + 1] != '*')
+            continue;
+
+        if (fs::path(name).filename() != wanted)
+            continue;
+        if (auto parsed = Sha256::parse(digest))
+            return *parsed;
+        return std::unexpected(std::format("Malformed checksum for {} in {}", wanted, sums.string()));
+    }
+
+    return std::unexpected(std::format("No checksum for {} in {}", wanted, sums.string()));
 }
 
 std::expected<Config, std::string> parse_args(std::span<char *> args)
 {
     Config config;
+    bool no_history = false;
 
     if (args.size() < 2)
         return std::unexpected("No archive file specified");
@@ -372,6 +285,7 @@ std::expected<Config, std::string> parse_args(std::span<char *> args)
         }
         else if (arg == "-v" || arg == "--version")
         {
+            logging::flush();
             std::println("install-app v1.0.0");
             std::exit(0);
         }
@@ -455,7 +369,126 @@ std::expected<Config, std::string> parse_args(std::span<char *> args)
                 config.desktop_config = DesktopEntryConfig{};
             config.desktop_config->terminal = true;
         }
-        else if (arg[0] == '-')
+        else if (arg == "--log-json")
+        {
+            if (i + 1 >= args.size())
+                return std::unexpected("Missing argument for --log-json");
+            config.log_json = args[++i];
+        }
+        else if (arg == "--no-progress")
+        {
+            config.progress = false;
+        }
+        else if (arg == "--timings")
+        {
+            config.timings = true;
+        }
+        else if (arg == "--timings-json")
+        {
+            if (i + 1 >= args.size())
+                return std::unexpected("Missing argument for --timings-json");
+            config.timings_json = args[++i];
+        }
+        else if (arg == "--mem-stats")
+        {
+            config.mem_stats = true;
+        }
+        else if (arg == "--trace")
+        {
+            if (i + 1 >= args.size())
+                return std::unexpected("Missing argument for --trace");
+            config.trace_file = args[++i];
+        }
+        else if (arg == "--history")
+        {
+            if (i + 1 >= args.size())
+                return std::unexpected("Missing argument for --history");
+            config.history_file = args[++i];
+            no_history = false;
+        }
+        else if (arg == "--no-history")
+        {
+            no_history = true;
+        }
+        else if (arg == "--metrics-textfile")
+        {
+            if (i + 1 >= args.size())
+                return std::unexpected("Missing argument for --metrics-textfile");
+            config.metrics_textfile = args[++i];
+        }
+        else if (arg == "--stats")
+        {
+            config.stats = true;
+        }
+        else if (arg == "--sha256")
+        {
+            if (i + 1 >= args.size())
+                return std::unexpected("Missing argument for --sha256");
+            config.expected_sha256 = Sha256::parse(args[++i]);
+            if (!config.expected_sha256)
+                return std::unexpected(std::format("Invalid SHA-256 digest: {}", args[i]));
+        }
+        else if (arg == "--checksums")
+        {
+            if (i + 1 >= args.size())
+                return std::unexpected("Missing argument for --checksums");
+            config.checksums_file = args[++i];
+        }
+        else if (arg == "--nested")
+        {
+            config.nested.by_name = true;
+        }
+        else if (arg == "--nested-rule")
+        {
+            if (i + 1 >= args.size())
+                return std::unexpected("Missing argument for --nested-rule");
+            config.nested.patterns.emplace_back(args[++i]);
+        }
+        else if (arg == "--launch-first")
+        {
+            config.launch_first = true;
+        }
+        else if (arg == "--warm")
+        {
+            config.warm = true;
+        }
+        else if (arg == "--gentle")
+        {
+            config.warm = true;
+            config.gentle = true;
+        }
+        else if (arg == "--no-manifest")
+        {
+            config.no_manifest = true;
+        }
+        else if (arg == "--verify")
+        {
+            if (i + 1 >= args.size())
+                return std::unexpected("Missing argument for --verify");
+            config.verify_app = args[++i];
+        }
+        else if (arg == "--scrub")
+        {
+            config.scrub = true;
+        }
+        else if (arg == "--profile-startup")
+        {
+            if (i + 1 >= args.size())
+                return std::unexpected("Missing argument for --profile-startup");
+            config.profile_app = args[++i];
+        }
+        else if (arg == "--profile-seconds")
+        {
+            if (i + 1 >= args.size())
+                return std::unexpected("Missing argument for --profile-seconds");
+            int seconds = 0;
+            std::string_view text = args[++i];
+            auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), seconds);
+            if (ec != std::errc() || end != text.data() + text.size() || seconds <= 0)
+                return std::unexpected(std::format("Invalid number of seconds: {}", text));
+            config.profile_limit = std::chrono::seconds(seconds);
+        }
+        else if (arg[0] == '-' && arg != "-")
         {
             return std::unexpected(std::format("Unknown option: {}", arg));
         }
@@ -465,90 +498,476 @@ std::expected<Config, std::string> parse_args(std::span<char *> args)
         }
     }
 
+    if (no_history)
+        config.history_file.clear();
+    else if (config.history_file.empty())
+        config.history_file = default_history_path();
+
+    if (config.stats || config.scrub || !config.verify_app.empty() || !config.profile_app.empty())
+        return config;
+
     if (config.archive_file.empty())
         return std::unexpected("No archive file specified");
 
-    if (!fs::exists(config.archive_file))
+    /* launch-first has the app ready to run from the install before the archive is read to the end, and
+     * so before its digest is known */
+    if (config.launch_first && (config.expected_sha256 || !config.checksums_file.empty()))
+        return std::unexpected("--launch-first cannot be combined with --sha256 or --checksums, since the app "
+                "would be ready before the archive is verified");
+
+    /* a piped archive has no name to take the app name or a SHA256SUMS entry from */
+    if (is_standard_input(config.archive_file))
+    {
+        if (config.app_name.empty())
+            return std::unexpected("--name is required when reading the archive from standard input");
+        if (!config.checksums_file.empty() && !config.expected_sha256)
+            return std::unexpected("--checksums needs an archive file name; use --sha256 with standard input");
+    }
+    else if (!fs::exists(config.archive_file))
+    {
         return std::unexpected(std::format("File not found: {}", config.archive_file.string()));
+    }
 
     if (config.app_name.empty())
         config.app_name = detect_app_name(config.archive_file);
 
+    if (!config.checksums_file.empty() && !config.expected_sha256)
+    {
+        auto digest = read_checksum(config.checksums_file, config.archive_file);
+        if (!digest)
+            return std::unexpected(digest.error());
+        config.expected_sha256 = *digest;
+    }
+
     return config;
 }
 
-int main(int argc, char *argv[])
+/* clears the way for a new install at `final_install_path`, asking first unless `--force`. false when
+ * the user said no. with `aside`, the old install is only moved there, for the caller to remove once the
+ * new one is in place or to move back if it fails */
+bool replace_existing(const Config &config, const fs::path &final_install_path, Timings &timings,
+        const fs::path &aside = {})
 {
-    auto config_result = parse_args(std::span(argv, argc));
+    if (!fs::exists(final_install_path))
+        return true;
 
-    if (!config_result)
+    if (!config.force)
     {
-        error("{}", config_result.error());
-        print_usage(argv[0]);
-        return 1;
+        logging::flush();
+        std::print("Installation directory already exists: {}\noverwrite? (y/N): ", final_install_path.string());
+        std::string response;
+        std::getline(std::cin, response);
+
+        if (response.empty() || (response[0] != 'y' && response[0] != 'Y'))
+        {
+            std::println("Installation cancelled");
+            return false;
+        }
     }
 
-    auto config = *config_result;
+    if (!aside.empty())
+    {
+        fs::rename(final_install_path, aside);
+        return true;
+    }
+
+    auto phase = timings.phase("remove_existing");
+    fs::remove_all(final_install_path);
+    return true;
+}
+
+/* `--warm`: the first launch reads the files of its startup profile, `executable` and the libraries it
+ * loads from memory instead of the disk. with `--gentle` they are all that is left in the page cache of
+ * the install and the archive */
+void warm_install(const Config &config, const fs::path &install_path, fs::path executable,
+        const std::vector<std::string> &startup, Timings &timings)
+{
+    if (!config.warm)
+        return;
+
+    auto phase = timings.phase("warm");
+    if (executable.empty())
+    {
+        auto found = find_executables(install_path, 1);
+        if (!found.empty())
+            executable = found[0];
+    }
+
+    /* in the order the app opened them, which is also how they were laid out */
+    std::vector<fs::path> files;
+    std::unordered_set<std::string> listed;
+    std::error_code ec;
+    for (const auto &file : startup)
+    {
+        auto path = fs::canonical(install_path / file, ec);
+        if (!ec && listed.insert(path.string()).second)
+            files.push_back(std::move(path));
+    }
+    if (!executable.empty())
+    {
+        for (auto &file : launch_files(executable, install_path))
+        {
+            if (listed.insert(file.string()).second)
+                files.push_back(std::move(file));
+        }
+    }
+
+    if (config.gentle)
+    {
+        cache::drop_tree(install_path, files);
+        if (!is_standard_input(config.archive_file))
+        {
+            for (const auto &volume : archive_volumes(config.archive_file))
+                cache::drop(volume);
+        }
+    }
+
+    if (files.empty())
+    {
+        warn("No executable to warm the page cache for");
+        return;
+    }
+
+    auto warmed = cache::warm(files);
+    info("Warming the page cache for the first launch: {} files, {}", warmed.files, human_bytes(warmed.bytes));
+}
+
+/* a single executable skips extraction, staging in /tmp, the copy and the executable search: it is
+ * decompressed straight into a staging directory beside the install and renamed into place. nullopt when
+ * the file turns out to hold something else, which then goes through the ordinary path */
+std::optional<InstallResult> install_binary(const Config &config, Timings &timings)
+{
+    InstallResult result;
+    result.format = ArchiveFormat::BINARY;
+
+    auto final_install_path = config.install_dir / config.app_name;
+    auto staging = config.install_dir / std::format(".{}.install-app-{}", config.app_name, getpid());
+    auto relative = fs::path("bin") / config.app_name;
+    fs::create_directories(staging / "bin");
+
+    std::optional<Sha256> archive_hash;
+    if (config.expected_sha256)
+        archive_hash.emplace();
+    Sha256 file_hash;
+    bool not_binary = false;
+    std::expected<ExtractStats, std::string> extracted;
+    {
+        auto phase = timings.phase("extract");
+        ProgressReporter reporter("Decompressing", config.progress);
+        extracted = extract_binary(config.archive_file, staging / relative, not_binary,
+                config.no_manifest ? nullptr : &file_hash, archive_hash ? &*archive_hash : nullptr);
+    }
+
+    if (!extracted)
+    {
+        auto phase = timings.phase("cleanup");
+        fs::remove_all(staging);
+        if (not_binary)
+            return std::nullopt;
+        error("{}", extracted.error());
+        return result;
+    }
+    result.stats = *extracted;
+    timings.add_files(extracted->files);
 
-    auto format = detect_format(config.archive_file);
-    if (format == ArchiveFormat::UNKNOWN)
+    if (archive_hash)
+    {
+        auto digest = archive_hash->finish();
+        if (digest != *config.expected_sha256)
+        {
+            error("Checksum mismatch for {}: expected {}, got {}", config.archive_file.string(),
+                    Sha256::hex(*config.expected_sha256), Sha256::hex(digest));
+            auto phase = timings.phase("cleanup");
+            fs::remove_all(staging);
+            return result;
+        }
+        info("Checksum verified: {}", Sha256::hex(digest));
+    }
+
+    if (!replace_existing(config, final_install_path, timings))
+    {
+        auto phase = timings.phase("cleanup");
+        fs::remove_all(staging);
+        result.outcome = Outcome::CANCELLED;
+        return result;
+    }
+
+    info("Installing to: {}", final_install_path.string());
+    {
+        auto phase = timings.phase("copy");
+        fs::rename(staging, final_install_path);
+    }
+
+    auto binary = final_install_path / relative;
+    if (!config.no_manifest)
+    {
+        auto dir = default_manifest_dir();
+        Manifest manifest{ final_install_path, std::string(format_name(result.format)),
+            { { relative.string(), extracted->bytes, file_hash.finish() } } };
+        if (!dir.empty() && !write_manifest(manifest_path(dir, config.app_name), manifest))
+            warn("Could not write install manifest: {}", manifest_path(dir, config.app_name).string());
+    }
+
+    /* the one executable there is, so there is nothing to ask about. `--link` can only name the link */
+    if (!config.no_link)
+    {
+        auto phase = timings.phase("link");
+        auto link_name = fs::path(config.app_name);
+        if (!config.link_binaries.empty())
+        {
+            if (auto name = fs::path(config.link_binaries[0]).filename(); !name.empty())
+                link_name = name;
+            if (config.link_binaries.size() > 1)
+                warn("{} is a single binary; linking it as {} only", config.archive_file.filename().string(),
+                        link_name.string());
+        }
+        fs::create_directories(config.bin_dir);
+        ::create_symlink(binary, config.bin_dir / link_name);
+    }
+
+    if (config.create_desktop && config.desktop_config)
+    {
+        auto phase = timings.phase("desktop");
+        auto desktop_cfg = *config.desktop_config;
+        if (desktop_cfg.name.empty())
+            desktop_cfg.name = config.app_name;
+        if (desktop_cfg.exec_path.empty())
+            desktop_cfg.exec_path = binary.string();
+        create_desktop_entry(desktop_cfg);
+    }
+
+    warm_install(config, final_install_path, binary, {}, timings);
+
+    logging::flush();
+    std::println("\nInstallation complete!");
+    std::println("Application installed to: {}", final_install_path.string());
+
+    result.outcome = Outcome::SUCCESS;
+    return result;
+}
+
+InstallResult install(Config &config, Timings &timings)
+{
+    InstallResult result;
+    {
+        auto phase = timings.phase("detect");
+        result.format = detect_format(config.archive_file);
+        if (result.format == ArchiveFormat::UNKNOWN && !is_standard_input(config.archive_file))
+            result.format = sniff_format(config.archive_file);
+    }
+
+    /* standard input is sniffed by `extract()` instead */
+    if (result.format == ArchiveFormat::UNKNOWN && !is_standard_input(config.archive_file))
     {
         error("Unable to detect archive format for: {}", config.archive_file.string());
-        return 1;
+        return result;
     }
 
     info("Detected app name: {}", config.app_name);
 
+    if (result.format == ArchiveFormat::BINARY)
+    {
+        if (auto installed = install_binary(config, timings))
+            return *installed;
+        /* a `.gz` holding a tarball, say. the probing reader works out what it is */
+        result.format = ArchiveFormat::UNKNOWN;
+    }
+
+    /* the archive is on stdin, so nothing is left there to answer the overwrite prompt with. refused
+     * before the pipe is drained rather than after */
+    if (is_standard_input(config.archive_file) && !config.force && fs::exists(config.install_dir / config.app_name))
+    {
+        error("Installation directory already exists: {} (use --force when reading from standard input)",
+                (config.install_dir / config.app_name).string());
+        return result;
+    }
+
+    /* the startup profile is kept from one install to the next */
+    std::vector<std::string> startup;
+    if (auto dir = default_manifest_dir(); !dir.empty())
+    {
+        if (auto previous = load_manifest(manifest_path(dir, config.app_name)))
+            startup = std::move(previous->startup);
+    }
+
+    auto final_install_path = config.install_dir / config.app_name;
     auto temp_dir = fs::temp_directory_path() / std::format("install-app-{}", getpid());
-    fs::create_directories(temp_dir);
+    auto extract_dir = config.launch_first ? final_install_path : temp_dir;
+    /* where launch-first moves its extraction to take a late top-level directory out of it */
+    auto unwrapping = final_install_path;
+    unwrapping += std::format(".install-app-{}", getpid());
+
+    /* launch-first extracts straight into the install directory, so that the app starts from where it
+     * stays, and the old install has to make way before extraction instead of after. it is only moved
+     * aside until the new one is complete, and comes back if extraction fails */
+    std::optional<LaunchPlan> launch;
+    fs::path previous_install;
+    if (config.launch_first)
+    {
+        auto aside = final_install_path;
+        aside += std::format(".install-app-old-{}", getpid());
+        if (fs::exists(final_install_path))
+            previous_install = aside;
+        if (!replace_existing(config, final_install_path, timings, previous_install))
+        {
+            result.outcome = Outcome::CANCELLED;
+            return result;
+        }
+        info("Installing to: {}", final_install_path.string());
+        launch.emplace(config.app_name, config.link_binaries, startup);
+    }
+
+    /* takes away what a failed install has written and puts back the install launch-first moved aside.
+     * it also runs when a filesystem error leaves by exception, so it does not throw one itself */
+    bool settled = false;
+    auto discard = [&] {
+        if (settled)
+            return;
+        settled = true;
+        auto phase = timings.phase("cleanup");
+        std::error_code ec;
+        fs::remove_all(extract_dir, ec);
+        if (launch)
+            fs::remove_all(unwrapping, ec);
+        if (previous_install.empty())
+            return;
+        fs::rename(previous_install, final_install_path, ec);
+        if (ec)
+            error("Could not restore the previous install, which is left at {}: {}", previous_install.string(),
+                    ec.message());
+        else
+            info("Restored the previous install at {}", final_install_path.string());
+    };
+    OnLeave leave(discard);
+
+    fs::create_directories(extract_dir);
 
     info("Extracting archive...");
-    auto extract_result = extract(config.archive_file, temp_dir, format);
+    std::expected<ExtractStats, std::string> extract_result;
+    std::vector<ManifestFile> files;
+    std::optional<Sha256> archive_hash;
+    if (config.expected_sha256)
+        archive_hash.emplace();
+    {
+        auto phase = timings.phase("extract");
+        ProgressReporter reporter("Extracting", config.progress);
+        extract_result = extract(config.archive_file, extract_dir, result.format,
+                config.no_manifest ? nullptr : &files, archive_hash ? &*archive_hash : nullptr, &config.nested,
+                launch ? &*launch : nullptr);
+        if (extract_result)
+            timings.add_files(extract_result->files);
+    }
 
     if (!extract_result)
     {
         error("{}", extract_result.error());
-        fs::remove_all(temp_dir);
-        return 1;
+        discard();
+        return result;
     }
 
-    fs::path source_dir = temp_dir;
+    /* the extraction is still in staging, so a mismatch leaves the existing install untouched. launch-first
+     * never gets here, as it is not taken together with a digest */
+    if (archive_hash)
+    {
+        auto digest = archive_hash->finish();
+        if (digest != *config.expected_sha256)
+        {
+            error("Checksum mismatch for {}: expected {}, got {}", config.archive_file.string(),
+                    Sha256::hex(*config.expected_sha256), Sha256::hex(digest));
+            discard();
+            return result;
+        }
+        info("Checksum verified: {}", Sha256::hex(digest));
+    }
+
+    result.stats = *extract_result;
+    if (result.format == ArchiveFormat::UNKNOWN)
+        result.format = extract_result->format;
+
+    fs::path source_dir = extract_dir;
     size_t entry_count = 0;
     fs::path first_dir;
 
-    for (const auto &entry : fs::directory_iterator(temp_dir))
     {
-        entry_count++;
-        if (entry_count == 1 && entry.is_directory())
-            first_dir = entry.path();
+        auto phase = timings.phase("scan");
+        for (const auto &entry : fs::directory_iterator(extract_dir))
+        {
+            entry_count++;
+            if (entry_count == 1 && entry.is_directory())
+                first_dir = entry.path();
+        }
     }
 
-    if (entry_count == 1 && !first_dir.empty())
+    /* launch-first has left one out already, and an install only ever loses one */
+    if (entry_count == 1 && !first_dir.empty() && (!launch || launch->top_directory().empty()))
+    {
         source_dir = first_dir;
 
-    auto final_install_path = config.install_dir / config.app_name;
+        /* the manifest is relative to what ends up in the install directory */
+        auto prefix = first_dir.filename().string() + "/";
+        for (auto &file : files)
+        {
+            if (file.path.starts_with(prefix))
+                file.path.erase(0, prefix.size());
+        }
+    }
 
-    if (fs::exists(final_install_path))
+    if (launch)
     {
-        if (!config.force)
+        /* launch-first leaves the top-level directory out as it goes. one that only shows at the end,
+         * such as that of a nested archive, is taken out now */
+        if (source_dir != extract_dir)
         {
-            std::print("Installation directory already exists: {}\noverwrite? (y/N): ", final_install_path.string());
-            std::string response;
-            std::getline(std::cin, response);
+            auto phase = timings.phase("copy");
+            fs::rename(final_install_path, unwrapping);
+            fs::rename(unwrapping / first_dir.filename(), final_install_path);
+            fs::remove(unwrapping);
+        }
 
-            if (response.empty() || (response[0] != 'y' && response[0] != 'Y'))
+        /* the new install is in place, and whatever happens from here leaves it there */
+        settled = true;
+        if (!previous_install.empty())
+        {
+            auto phase = timings.phase("remove_existing");
+            fs::remove_all(previous_install);
+        }
+    }
+    else
+    {
+        if (!replace_existing(config, final_install_path, timings))
+        {
+            discard();
+            result.outcome = Outcome::CANCELLED;
+            return result;
+        }
+
+        info("Installing to: {}", final_install_path.string());
+        {
+            auto phase = timings.phase("copy");
+            fs::create_directories(final_install_path.parent_path());
+            /* the startup profile goes first, one preallocated file after another, so that the files the
+             * app opens as it starts sit together on disk in the order it opens them */
+            auto options = fs::copy_options::recursive | fs::copy_options::copy_symlinks;
+            if (!startup.empty())
             {
-                std::println("Installation cancelled");
-                fs::remove_all(temp_dir);
-                return 0;
+                fs::create_directory(final_install_path, source_dir);
+                for (const auto &file : startup)
+                    copy_preallocated(source_dir, final_install_path, file);
+                options |= fs::copy_options::skip_existing;
             }
+            /* `fs::copy()` does not say how many it wrote; the extract phase has counted the files already */
+            fs::copy(source_dir, final_install_path, options);
         }
-        fs::remove_all(final_install_path);
+        settled = true;
     }
 
-    info("Installing to: {}", final_install_path.string());
-    fs::create_directories(final_install_path.parent_path());
-    fs::copy(source_dir, final_install_path, fs::copy_options::recursive);
+    if (!config.no_manifest)
+    {
+        auto dir = default_manifest_dir();
+        Manifest manifest{ final_install_path, std::string(format_name(result.format)), std::move(files), startup };
+        if (!dir.empty() && !write_manifest(manifest_path(dir, config.app_name), manifest))
+            warn("Could not write install manifest: {}", manifest_path(dir, config.app_name).string());
+    }
 
     fs::path primary_executable;
 
@@ -558,6 +977,7 @@ int main(int argc, char *argv[])
 
         if (!config.link_binaries.empty())
         {
+            auto phase = timings.phase("link");
             for (const auto &binary : config.link_binaries)
             {
                 auto binary_path = final_install_path / binary;
@@ -578,10 +998,15 @@ int main(int argc, char *argv[])
         else
         {
             info("Searching for executables...");
-            auto executables = find_executables(final_install_path);
+            std::vector<fs::path> executables;
+            {
+                auto phase = timings.phase("find_executables");
+                executables = find_executables(final_install_path);
+            }
 
             if (!executables.empty())
             {
+                logging::flush();
                 std::println("Found executables:");
                 for (size_t i = 0; i < executables.size(); ++i)
                 {
@@ -595,6 +1020,7 @@ int main(int argc, char *argv[])
 
                 if (!response.empty() && (response[0] == 'y' || response[0] == 'Y'))
                 {
+                    auto phase = timings.phase("link");
                     for (const auto &exe : executables)
                     {
                         ::create_symlink(exe, config.bin_dir / exe.filename());
@@ -621,34 +1047,320 @@ int main(int argc, char *argv[])
             }
             else
             {
-                auto executables = find_executables(final_install_path, 1);
+                std::vector<fs::path> executables;
+                {
+                    auto phase = timings.phase("find_executables");
+                    executables = find_executables(final_install_path, 1);
+                }
+
                 if (!executables.empty())
                     desktop_cfg.exec_path = executables[0].string();
                 else
-                {
                     warn("No executable found for desktop entry");
-                    fs::remove_all(temp_dir);
-                    std::println("\nInstallation complete!");
-                    std::println("Application installed to: {}", final_install_path.string());
-                    return 0;
-                }
             }
         }
 
-        if (desktop_cfg.icon.empty())
+        /* without an executable there is no entry, but the install is still complete */
+        if (!desktop_cfg.exec_path.empty())
         {
-            auto found_icon = find_icon(final_install_path, config.app_name);
-            if (found_icon)
-                desktop_cfg.icon = found_icon->string();
+            auto phase = timings.phase("desktop");
+            if (desktop_cfg.icon.empty())
+            {
+                auto found_icon = find_icon(final_install_path, config.app_name);
+                if (found_icon)
+                    desktop_cfg.icon = found_icon->string();
+            }
+
+            create_desktop_entry(desktop_cfg);
         }
+    }
 
-        create_desktop_entry(desktop_cfg);
+    {
+        auto phase = timings.phase("cleanup");
+        fs::remove_all(temp_dir);
     }
 
-    fs::remove_all(temp_dir);
+    /* staging is gone by now, so its copy of every page is too */
+    if (primary_executable.empty() && launch && !launch->executable().empty())
+        primary_executable = final_install_path / launch->executable();
+    warm_install(config, final_install_path, primary_executable, startup, timings);
 
+    logging::flush();
     std::println("\nInstallation complete!");
     std::println("Application installed to: {}", final_install_path.string());
 
+    result.outcome = Outcome::SUCCESS;
+    return result;
+}
+
+/* true when the install still matches its manifest */
+bool report_verify(std::string_view app, const VerifyReport &report)
+{
+    logging::flush();
+    for (const auto &drift : report.drift)
+        std::println("{}: {}: {}", app, drift_name(drift.kind), drift.path);
+
+    auto rate = report.seconds > 0 ? report.bytes / report.seconds / (1024 * 1024) : 0;
+    std::println("{}: {} files, {} bytes checked in {:.2f}s ({:.0f} MiB/s), {} changed", app, report.files,
+            report.bytes, report.seconds, rate, report.drift.size());
+    return report.drift.empty();
+}
+
+int verify(const Config &config)
+{
+    auto manifest = load_manifest(manifest_path(default_manifest_dir(), config.verify_app));
+    if (!manifest)
+    {
+        error("{}", manifest.error());
+        return 1;
+    }
+
+    return report_verify(config.verify_app, verify_install(*manifest)) ? 0 : 1;
+}
+
+int scrub()
+{
+    /* a scrub is background work: one thread, idle priority, and no trace left in the page cache */
+    enter_idle_priority();
+
+    auto manifests = list_manifests(default_manifest_dir());
+    if (manifests.empty())
+        info("No install manifests to scrub");
+
+    size_t failed = 0;
+    for (const auto &path : manifests)
+    {
+        auto app = path.stem().string();
+        auto manifest = load_manifest(path);
+        if (!manifest)
+        {
+            error("{}", manifest.error());
+            ++failed;
+            continue;
+        }
+
+        if (!report_verify(app, verify_install(*manifest, { .threads = 1, .drop_cache = true })))
+            ++failed;
+    }
+
+    return failed ? 1 : 0;
+}
+
+/* the executable `--profile-startup` runs: the first `--link` binary, else what the app's symlink in the
+ * bin directory points at, else the first executable in the install */
+fs::path startup_executable(const Config &config, const fs::path &root)
+{
+    if (!config.link_binaries.empty())
+        return root / config.link_binaries[0];
+
+    std::error_code ec;
+    auto linked = fs::canonical(config.bin_dir / config.profile_app, ec);
+    auto base = fs::canonical(root, ec);
+    if (!ec && !linked.empty())
+    {
+        auto relative = linked.lexically_relative(base);
+        if (!relative.empty() && *relative.begin() != "..")
+            return linked;
+    }
+
+    auto found = find_executables(root, 1);
+    return found.empty() ? fs::path() : found[0];
+}
+
+int profile_startup(const Config &config)
+{
+    auto path = manifest_path(default_manifest_dir(), config.profile_app);
+    auto manifest = load_manifest(path);
+    if (!manifest)
+    {
+        error("{}", manifest.error());
+        return 1;
+    }
+
+    auto executable = startup_executable(config, manifest->root);
+    if (executable.empty())
+    {
+        error("No executable to profile in {}", manifest->root.string());
+        return 1;
+    }
+
+    info("Recording the startup of {} for up to {}s...", executable.string(), config.profile_limit.count());
+    logging::flush();
+    auto profile = record_startup(executable, manifest->root, config.profile_limit);
+    if (!profile)
+    {
+        error("{}", profile.error());
+        return 1;
+    }
+    if (profile->stopped)
+        info("Stopped {} after {}s", executable.filename().string(), config.profile_limit.count());
+    if (profile->files.empty())
+    {
+        warn("{} opened nothing in {}; keeping the previous profile", executable.string(),
+                manifest->root.string());
+        return 1;
+    }
+
+    manifest->startup = std::move(profile->files);
+    if (!write_manifest(path, *manifest))
+    {
+        error("Could not write install manifest: {}", path.string());
+        return 1;
+    }
+    info("Recorded {} files opened during startup; later installs of {} write them first",
+            manifest->startup.size(), config.profile_app);
     return 0;
 }
+
+void report_timings(const Config &config, const Timings &timings, const InstallResult &result)
+{
+    if (config.timings)
+    {
+        logging::flush();
+        std::println(stderr, "");
+        timings.print(stderr);
+    }
+
+    if (config.mem_stats)
+    {
+        logging::flush();
+        std::println(stderr, "");
+        timings.print_memory(stderr);
+    }
+
+    if (config.timings_json.empty())
+        return;
+
+    std::ofstream file(config.timings_json);
+    if (!file)
+    {
+        warn("Could not write timings to: {}", config.timings_json.string());
+        return;
+    }
+
+    file << std::format("{{\"app\":\"{}\",\"archive\":\"{}\",\"format\":\"{}\",\"entries\":{},\"files\":{},"
+                        "\"bytes\":{},\"perf\":{},\"timings\":{}}}\n",
+            json_escape(config.app_name), json_escape(config.archive_file.string()), format_name(result.format),
+            result.stats.entries, result.stats.files, result.stats.bytes, timings.has_perf(), timings.json());
+}
+
+void record_history(const Config &config, const Timings &timings, const InstallResult &result)
+{
+    HistoryRecord record;
+    record.timestamp = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    record.app = config.app_name;
+    record.archive = is_standard_input(config.archive_file) ? "-" : fs::absolute(config.archive_file).string();
+    record.format = format_name(result.format);
+    record.bytes = result.stats.bytes;
+    record.files = result.stats.files;
+    record.entries = result.stats.entries;
+    record.duration_seconds = timings.total().wall_ms / 1000.0;
+
+    switch (result.outcome)
+    {
+        case Outcome::SUCCESS:
+            record.outcome = "success";
+            break;
+        case Outcome::FAILED:
+            record.outcome = "failed";
+            break;
+        case Outcome::CANCELLED:
+            record.outcome = "cancelled";
+            break;
+    }
+
+    /* all the volumes of a split archive */
+    record.archive_bytes = 0;
+    for (const auto &volume : archive_volumes(config.archive_file))
+    {
+        std::error_code ec;
+        auto size = fs::file_size(volume, ec);
+        record.archive_bytes += ec ? 0 : size;
+    }
+
+    for (const auto &phase : timings.phases())
+        record.phases.emplace_back(phase.name, phase.wall_ms / 1000.0);
+
+    std::vector<HistoryRecord> records;
+    if (!config.history_file.empty())
+    {
+        if (!append_history(config.history_file, record))
+            warn("Could not append to install history: {}", config.history_file.string());
+        if (!config.metrics_textfile.empty())
+            records = load_history(config.history_file);
+    }
+
+    if (records.empty())
+        records.push_back(record);
+
+    if (!config.metrics_textfile.empty() && !write_metrics_textfile(config.metrics_textfile, records))
+        warn("Could not write metrics textfile: {}", config.metrics_textfile.string());
+}
+
+int main(int argc, char *argv[])
+{
+    auto config_result = parse_args(std::span(argv, argc));
+
+    if (!config_result)
+    {
+        error("{}", config_result.error());
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    auto config = *config_result;
+
+    if (!config.log_json.empty() && !logging::open_json_sink(config.log_json))
+        warn("Could not open JSON log: {}", config.log_json.string());
+
+    if (config.stats)
+    {
+        print_history_stats(load_history(config.history_file));
+        return 0;
+    }
+
+    if (!config.verify_app.empty())
+        return verify(config);
+
+    if (config.scrub)
+        return scrub();
+
+    if (!config.profile_app.empty())
+        return profile_startup(config);
+
+    if (config.mem_stats)
+        memstats::enable();
+
+    auto report = config.timings || config.mem_stats || !config.timings_json.empty();
+    auto track = !config.history_file.empty() || !config.metrics_textfile.empty();
+    Timings timings(report || track, config.timings || !config.timings_json.empty());
+    if (!config.trace_file.empty())
+        trace::enable();
+
+    InstallResult result;
+    try
+    {
+        result = install(config, timings);
+    }
+    catch (const fs::filesystem_error &e)
+    {
+        error("Filesystem error: {}", e.what());
+        /* the compiler may have had `install()` build its result in place, so what is there is not to be
+         * trusted once it has thrown */
+        result = InstallResult{};
+    }
+
+    timings.finish();
+
+    if (report)
+        report_timings(config, timings, result);
+
+    if (track)
+        record_history(config, timings, result);
+
+    if (trace::enabled() && !trace::write(config.trace_file))
+        warn("Could not write trace to: {}", config.trace_file.string());
+
+    return result.outcome == Outcome::FAILED ? 1 : 0;
+}
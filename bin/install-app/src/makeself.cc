@@ -0,0 +1,93 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <algorithm>
+#include <charconv>
+#include <string_view>
+#include "makeself.hh"
+
+namespace
+{
+    constexpr size_t TAR_MAGIC_OFFSET = 257;
+    /* scripts are a few tens of KiB even with a licence pasted in; nothing past this is searched */
+    constexpr size_t SCAN_LIMIT = 16 * 1024 * 1024;
+
+    bool has(std::string_view data, size_t at, std::string_view magic)
+    {
+        return at <= data.size() && data.size() - at >= magic.size() && data.compare(at, magic.size(), magic) == 0;
+    }
+
+    /* the compressed tarballs makeself can append. encrypted and base64 payloads are not among them,
+     * so they are never mistaken for one */
+    bool is_compressed(std::string_view data, size_t at)
+    {
+        using namespace std::string_view_literals;
+        if (has(data, at, "\x1f\x8b\x08"sv) || has(data, at, "\xfd" "7zXZ\0"sv) || has(data, at, "\x28\xb5\x2f\xfd"sv))
+            return true;
+        return has(data, at, "BZh"sv) && at + 3 < data.size() && data[at + 3] >= '1' && data[at + 3] <= '9' &&
+               has(data, at + 4, "1AY&SY"sv);
+    }
+
+    /* `--nocomp` appends the tarball as it is */
+    bool is_tar(std::string_view data, size_t at)
+    {
+        return has(data, at + TAR_MAGIC_OFFSET, "ustar");
+    }
+
+    /* the number after `key` somewhere in the script, such as the 713 in `skip="713"` */
+    std::optional<uint64_t> number_after(std::string_view script, std::string_view key)
+    {
+        for (auto at = script.find(key); at != std::string_view::npos; at = script.find(key, at + 1))
+        {
+            auto digits = script.substr(at + key.size());
+            uint64_t value = 0;
+            auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+            if (error == std::errc() && end != digits.data())
+                return value;
+        }
+        return std::nullopt;
+    }
+
+    /* the offset just past line `lines`, as `head -n <lines> | wc -c` counts it */
+    std::optional<uint64_t> skip_lines(std::string_view data, uint64_t lines)
+    {
+        size_t at = 0;
+        for (uint64_t i = 0; i < lines; ++i)
+        {
+            auto newline = data.find('\n', at);
+            if (newline == std::string_view::npos)
+                return std::nullopt;
+            at = newline + 1;
+        }
+        return at;
+    }
+}
+
+namespace makeself
+{
+    std::optional<Payload> find_payload(std::span<const std::byte> head)
+    {
+        std::string_view data(reinterpret_cast<const char *>(head.data()), std::min(head.size(), SCAN_LIMIT));
+        if (!data.starts_with("#!"))
+            return std::nullopt;
+
+        /* makeself 2.4 and later say `skip="N"`, older versions put the count straight into `head -n N` */
+        auto lines = number_after(data, "skip=\"");
+        if (!lines)
+            lines = number_after(data, "head -n ");
+        if (lines)
+        {
+            auto offset = skip_lines(data, *lines);
+            if (offset && (is_compressed(data, *offset) || is_tar(data, *offset)))
+                return Payload{ *offset, number_after(data, "filesizes=\"") };
+        }
+
+        /* the compressed formats' magic never occurs in script text, but `ustar` might, so a tar header
+         * is only looked for at the start of a line */
+        for (size_t at = data.find('\n') + 1; at != 0 && at < data.size(); ++at)
+        {
+            if (is_compressed(data, at) || (data[at - 1] == '\n' && is_tar(data, at)))
+                return Payload{ at, std::nullopt };
+        }
+        return std::nullopt;
+    }
+}
@@ -0,0 +1,26 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+/* self-extracting installers: a shell script with a compressed tarball appended, as makeself writes
+ * them (`.run`, and many `.bin`). the script is never run; only the offset of the tarball is read out
+ * of it */
+namespace makeself
+{
+    struct Payload
+    {
+        uint64_t offset = 0;
+        /* from the script's `filesizes`, when it has one */
+        std::optional<uint64_t> size;
+    };
+
+    /* where the archive after the script in `head` starts. makeself records it as a line count for
+     * `head -n`; scripts that do not are searched for the first gzip, xz, bzip2, zstd or tar header
+     * instead. either way the bytes found there must be one of those, and they must lie in `head` */
+    std::optional<Payload> find_payload(std::span<const std::byte> head);
+}
@@ -0,0 +1,203 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <algorithm>
+#include <charconv>
+#include <format>
+#include <fstream>
+#include <optional>
+#include <system_error>
+#include <unistd.h>
+#include "history.hh"
+#include "manifest.hh"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr std::string_view MAGIC = "install-app-manifest 2";
+    /* from before paths were escaped */
+    constexpr std::string_view MAGIC_UNESCAPED = "install-app-manifest 1";
+
+    /* splits off the text up to the next space */
+    std::string_view next_field(std::string_view &line)
+    {
+        auto space = line.find(' ');
+        auto field = line.substr(0, space);
+        line = space == std::string_view::npos ? std::string_view() : line.substr(space + 1);
+        return field;
+    }
+
+    /* a path stays on one line whatever an archive called its entry */
+    std::string escape(std::string_view path)
+    {
+        std::string out;
+        out.reserve(path.size());
+        for (char c : path)
+        {
+            auto byte = static_cast<unsigned char>(c);
+            if (c == '\\')
+                out += "\\\\";
+            else if (byte < 0x20 || byte == 0x7f)
+                out += std::format("\\x{:02x}", byte);
+            else
+                out += c;
+        }
+        return out;
+    }
+
+    std::optional<std::string> unescape(std::string_view text)
+    {
+        std::string out;
+        out.reserve(text.size());
+        for (size_t i = 0; i < text.size(); ++i)
+        {
+            if (text[i] != '\\')
+            {
+                out += text[i];
+                continue;
+            }
+            if (i + 1 < text.size() && text[i + 1] == '\\')
+            {
+                out += '\\';
+                ++i;
+                continue;
+            }
+            unsigned byte = 0;
+            auto digits = text.substr(std::min(i + 2, text.size()), 2);
+            auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), byte, 16);
+            if (i + 1 >= text.size() || text[i + 1] != 'x' || digits.size() != 2 || ec != std::errc() ||
+                    end != digits.data() + digits.size())
+                return std::nullopt;
+            out += static_cast<char>(byte);
+            i += 3;
+        }
+        return out;
+    }
+
+    /* the path is joined onto the install root, so it has to stay below it */
+    bool stays_below(std::string_view path)
+    {
+        fs::path relative(path);
+        if (path.empty() || relative.is_absolute())
+            return false;
+        return std::ranges::none_of(relative, [](const fs::path &part) { return part == ".."; });
+    }
+}
+
+fs::path default_manifest_dir()
+{
+    auto dir = default_state_dir();
+    return dir.empty() ? dir : dir / "manifests";
+}
+
+fs::path manifest_path(const fs::path &dir, std::string_view app)
+{
+    return dir / std::format("{}.manifest", app);
+}
+
+std::vector<fs::path> list_manifests(const fs::path &dir)
+{
+    std::vector<fs::path> paths;
+    std::error_code ec;
+    for (const auto &entry : fs::directory_iterator(dir, ec))
+    {
+        if (entry.path().extension() == ".manifest" && entry.is_regular_file(ec))
+            paths.push_back(entry.path());
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+bool write_manifest(const fs::path &path, const Manifest &manifest)
+{
+    std::string out;
+    out += std::format("{}\nroot {}\nformat {}\n", MAGIC, manifest.root.string(), manifest.format);
+    for (const auto &file : manifest.files)
+        out += std::format("file {} {} {}\n", Sha256::hex(file.digest), file.size, escape(file.path));
+    for (const auto &path : manifest.startup)
+        out += std::format("startup {}\n", escape(path));
+
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+
+    /* a verify running alongside must see either the old manifest or the new one */
+    auto temp = path;
+    temp += std::format(".{}.tmp", getpid());
+    {
+        std::ofstream file(temp);
+        if (!file || !(file << out))
+            return false;
+    }
+
+    fs::rename(temp, path, ec);
+    if (ec)
+    {
+        fs::remove(temp, ec);
+        return false;
+    }
+
+    return true;
+}
+
+std::expected<Manifest, std::string> load_manifest(const fs::path &path)
+{
+    std::ifstream file(path);
+    if (!file)
+        return std::unexpected(std::format("No manifest at {}", path.string()));
+
+    std::string line;
+    if (!std::getline(file, line) || (line != MAGIC && line != MAGIC_UNESCAPED))
+        return std::unexpected(std::format("{} is not an install-app manifest", path.string()));
+    bool escaped = line == MAGIC;
+
+    Manifest manifest;
+    size_t number = 1;
+    /* the path at the end of a `file` or `startup` line */
+    auto path_field = [&](std::string_view text) -> std::expected<std::string, std::string> {
+        auto decoded = escaped ? unescape(text) : std::optional<std::string>(text);
+        if (!decoded)
+            return std::unexpected(std::format("{}:{}: malformed path", path.string(), number));
+        if (!stays_below(*decoded))
+            return std::unexpected(std::format("{}:{}: path leaves the install: {}", path.string(), number, text));
+        return std::move(*decoded);
+    };
+    while (std::getline(file, line))
+    {
+        ++number;
+        std::string_view rest(line);
+        auto key = next_field(rest);
+
+        if (key == "root")
+            manifest.root = std::string(rest);
+        else if (key == "format")
+            manifest.format = rest;
+        else if (key == "file")
+        {
+            auto digest = Sha256::parse(next_field(rest));
+            auto size_text = next_field(rest);
+            ManifestFile entry;
+            auto [end, ec] = std::from_chars(size_text.data(), size_text.data() + size_text.size(), entry.size);
+            if (!digest || ec != std::errc() || end != size_text.data() + size_text.size() || rest.empty())
+                return std::unexpected(std::format("{}:{}: malformed file line", path.string(), number));
+
+            auto file_path = path_field(rest);
+            if (!file_path)
+                return std::unexpected(file_path.error());
+            entry.digest = *digest;
+            entry.path = std::move(*file_path);
+            manifest.files.push_back(std::move(entry));
+        }
+        else if (key == "startup" && !rest.empty())
+        {
+            auto startup_path = path_field(rest);
+            if (!startup_path)
+                return std::unexpected(startup_path.error());
+            manifest.startup.push_back(std::move(*startup_path));
+        }
+        /* lines this version does not know about are left for newer ones */
+    }
+
+    if (manifest.root.empty())
+        return std::unexpected(std::format("{} has no root", path.string()));
+    return manifest;
+}
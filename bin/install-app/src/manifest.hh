@@ -0,0 +1,51 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "sha256.hh"
+
+struct ManifestFile
+{
+    /* relative to the manifest's root */
+    std::string path;
+    uint64_t size = 0;
+    Sha256::Digest digest = {};
+};
+
+/* what an install put on disk, hashed while it was being extracted. kept as a text file in the state
+ * directory:
+ *
+ *     install-app-manifest 2
+ *     root /opt/app
+ *     format tar.gz
+ *     file <sha256> <size> <path>
+ *     startup <path>
+ *
+ * the path is the rest of the line, so it may contain spaces. a backslash is written as `\\` and
+ * control characters, newlines among them, as `\xHH`; version 1 manifests had neither escape. a path
+ * that is absolute or has a `..` in it makes the manifest unreadable, since those lines are joined onto
+ * the root. `startup` lines are the app's startup profile as `--profile-startup` recorded it, in the
+ * order the app opened them. later installs write those files before anything else and carry the
+ * lines over */
+struct Manifest
+{
+    std::filesystem::path root;
+    std::string format;
+    std::vector<ManifestFile> files;
+    std::vector<std::string> startup;
+};
+
+/* `manifests/` in the state directory. empty when there is no state directory */
+std::filesystem::path default_manifest_dir();
+std::filesystem::path manifest_path(const std::filesystem::path &dir, std::string_view app);
+std::vector<std::filesystem::path> list_manifests(const std::filesystem::path &dir);
+
+/* written atomically via rename */
+bool write_manifest(const std::filesystem::path &path, const Manifest &manifest);
+std::expected<Manifest, std::string> load_manifest(const std::filesystem::path &path);
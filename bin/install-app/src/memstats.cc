@@ -0,0 +1,264 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <malloc.h>
+#include <sys/resource.h>
+#include "memstats.hh"
+
+namespace
+{
+    std::atomic<bool> counting = false;
+    std::atomic<uint64_t> allocations = 0;
+    std::atomic<uint64_t> frees = 0;
+    std::atomic<uint64_t> allocated_bytes = 0;
+    std::atomic<int64_t> live_bytes = 0;
+    std::atomic<int64_t> peak_bytes = 0;
+
+    /* the innermost `Attribute` open on this thread */
+    thread_local memstats::Attribute *attributed = nullptr;
+
+    void raise_peak(std::atomic<int64_t> &peak, int64_t value)
+    {
+        auto seen = peak.load(std::memory_order_relaxed);
+        while (value > seen && !peak.compare_exchange_weak(seen, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    /* blocks allocated before counting started are freed all the same, so the total is kept from going
+     * below nothing */
+    void change_live(int64_t bytes)
+    {
+        auto live = live_bytes.load(std::memory_order_relaxed);
+        while (!live_bytes.compare_exchange_weak(live, std::max<int64_t>(live + bytes, 0), std::memory_order_relaxed))
+        {
+        }
+        raise_peak(peak_bytes, live + bytes);
+        memstats::Attribute::charge(bytes);
+    }
+
+    void on_alloc(void *ptr)
+    {
+        if (!ptr)
+            return;
+
+        auto size = static_cast<int64_t>(malloc_usable_size(ptr));
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        allocated_bytes.fetch_add(static_cast<uint64_t>(size), std::memory_order_relaxed);
+        change_live(size);
+    }
+
+    void on_free(void *ptr, int64_t size)
+    {
+        if (!ptr)
+            return;
+
+        frees.fetch_add(1, std::memory_order_relaxed);
+        change_live(-size);
+    }
+
+    bool is_counting()
+    {
+        return counting.load(std::memory_order_relaxed);
+    }
+}
+
+#ifdef __GLIBC__
+
+/* glibc routes its own internal allocations (strdup, fopen, ...) through these as well, and keeps the
+ * `__libc_*` entry points exported precisely so a replacement can delegate to them */
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void __libc_free(void *ptr);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+    void *__libc_memalign(size_t alignment, size_t size);
+    void *__libc_valloc(size_t size);
+    void *__libc_pvalloc(size_t size);
+
+    void *malloc(size_t size)
+    {
+        auto ptr = __libc_malloc(size);
+        if (is_counting())
+            on_alloc(ptr);
+        return ptr;
+    }
+
+    void free(void *ptr)
+    {
+        if (is_counting() && ptr)
+            on_free(ptr, static_cast<int64_t>(malloc_usable_size(ptr)));
+        __libc_free(ptr);
+    }
+
+    void *calloc(size_t count, size_t size)
+    {
+        auto ptr = __libc_calloc(count, size);
+        if (is_counting())
+            on_alloc(ptr);
+        return ptr;
+    }
+
+    void *realloc(void *ptr, size_t size)
+    {
+        if (!is_counting())
+            return __libc_realloc(ptr, size);
+
+        auto old_size = ptr ? static_cast<int64_t>(malloc_usable_size(ptr)) : 0;
+        auto result = __libc_realloc(ptr, size);
+        if (!result)
+        {
+            /* glibc frees the block for a size of zero and returns nothing */
+            if (size == 0)
+                on_free(ptr, old_size);
+            return result;
+        }
+
+        auto growth = static_cast<int64_t>(malloc_usable_size(result)) - old_size;
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        allocated_bytes.fetch_add(static_cast<uint64_t>(std::max<int64_t>(growth, 0)), std::memory_order_relaxed);
+        change_live(growth);
+        return result;
+    }
+
+    void *memalign(size_t alignment, size_t size)
+    {
+        auto ptr = __libc_memalign(alignment, size);
+        if (is_counting())
+            on_alloc(ptr);
+        return ptr;
+    }
+
+    void *aligned_alloc(size_t alignment, size_t size)
+    {
+        return memalign(alignment, size);
+    }
+
+    int posix_memalign(void **out, size_t alignment, size_t size)
+    {
+        if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0)
+            return EINVAL;
+
+        auto ptr = memalign(alignment, size);
+        if (!ptr && size != 0)
+            return ENOMEM;
+
+        *out = ptr;
+        return 0;
+    }
+
+    void *valloc(size_t size)
+    {
+        auto ptr = __libc_valloc(size);
+        if (is_counting())
+            on_alloc(ptr);
+        return ptr;
+    }
+
+    void *pvalloc(size_t size)
+    {
+        auto ptr = __libc_pvalloc(size);
+        if (is_counting())
+            on_alloc(ptr);
+        return ptr;
+    }
+}
+
+#endif
+
+namespace memstats
+{
+    void Gauge::add(int64_t net, int64_t peak)
+    {
+        raise_peak(high_water, value.fetch_add(net, std::memory_order_relaxed) + std::max(net, peak));
+    }
+
+    int64_t Gauge::current() const
+    {
+        return value.load(std::memory_order_relaxed);
+    }
+
+    int64_t Gauge::peak() const
+    {
+        return high_water.load(std::memory_order_relaxed);
+    }
+
+    std::string_view Gauge::name() const
+    {
+        return label;
+    }
+
+    void enable()
+    {
+        counting.store(available(), std::memory_order_relaxed);
+    }
+
+    void disable()
+    {
+        counting.store(false, std::memory_order_relaxed);
+    }
+
+    bool enabled()
+    {
+        return is_counting();
+    }
+
+    bool available()
+    {
+#ifdef __GLIBC__
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    Snapshot snapshot()
+    {
+        return Snapshot{
+            .allocations = allocations.load(std::memory_order_relaxed),
+            .frees = frees.load(std::memory_order_relaxed),
+            .allocated_bytes = allocated_bytes.load(std::memory_order_relaxed),
+            .live_bytes = live_bytes.load(std::memory_order_relaxed),
+            .peak_bytes = peak_bytes.load(std::memory_order_relaxed),
+        };
+    }
+
+    void reset_peak()
+    {
+        peak_bytes.store(live_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    uint64_t peak_rss_bytes()
+    {
+        rusage usage = {};
+        getrusage(RUSAGE_SELF, &usage);
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+    }
+
+    Attribute::Attribute(Gauge &gauge) :
+        gauge(is_counting() ? &gauge : nullptr), outer(attributed)
+    {
+        if (this->gauge)
+            attributed = this;
+    }
+
+    Attribute::~Attribute()
+    {
+        if (!gauge)
+            return;
+        attributed = outer;
+        gauge->add(net, peak);
+    }
+
+    void Attribute::charge(int64_t bytes)
+    {
+        auto *scope = attributed;
+        if (!scope)
+            return;
+        scope->net += bytes;
+        scope->peak = std::max(scope->peak, scope->net);
+    }
+}
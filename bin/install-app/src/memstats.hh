@@ -0,0 +1,77 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+
+/* allocation accounting. the process-wide malloc family is replaced by a thin counting layer over
+ * glibc's allocator, so libarchive's buffers are seen as well as our own. counting only happens
+ * between `enable()` and `disable()`; otherwise the hooks cost one relaxed load */
+namespace memstats
+{
+    struct Snapshot
+    {
+        uint64_t allocations = 0;
+        uint64_t frees = 0;
+        uint64_t allocated_bytes = 0;
+        int64_t live_bytes = 0;
+        int64_t peak_bytes = 0;
+    };
+
+    /* net heap retained by one side of the pipeline: what the calls attributed to it allocated, on the
+     * thread that made them, less what they freed */
+    class Gauge
+    {
+    public:
+        explicit constexpr Gauge(std::string_view name) :
+            label(name)
+        {
+        }
+
+        /* `net` is what one scope retained, and `peak` the most it held at any point along the way */
+        void add(int64_t net, int64_t peak);
+        int64_t current() const;
+        int64_t peak() const;
+        std::string_view name() const;
+
+    private:
+        std::string_view label;
+        std::atomic<int64_t> value = 0;
+        std::atomic<int64_t> high_water = 0;
+    };
+
+    inline Gauge decompression("decompression");
+    inline Gauge pipeline("pipeline");
+
+    void enable();
+    void disable();
+    bool enabled();
+    bool available();
+
+    Snapshot snapshot();
+    /* restarts the peak so the next `snapshot()` reports the high-water mark since this call */
+    void reset_peak();
+    uint64_t peak_rss_bytes();
+
+    /* charges what this thread allocates and frees inside a scope to `gauge`, buffers that come and go
+     * within it included. a scope opened inside another takes the charges until it closes */
+    class Attribute
+    {
+    public:
+        explicit Attribute(Gauge &gauge);
+        Attribute(const Attribute &) = delete;
+        Attribute &operator=(const Attribute &) = delete;
+        ~Attribute();
+
+        /* called by the allocation hooks with the bytes the current thread gained or gave back */
+        static void charge(int64_t bytes);
+
+    private:
+        Gauge *gauge;
+        Attribute *outer;
+        int64_t net = 0;
+        int64_t peak = 0;
+    };
+}
@@ -0,0 +1,230 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <algorithm>
+#include <cstring>
+#include "paths.hh"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr size_t ARENA_CHUNK = 64 * 1024;
+
+    std::string_view parent_of(std::string_view relative)
+    {
+        auto slash = relative.rfind('/');
+        return slash == std::string_view::npos ? std::string_view() : relative.substr(0, slash);
+    }
+
+    /* calls `visit` with each non-empty component of `path` and whether it is the last one */
+    template<typename Visit>
+    auto for_each_component(std::string_view path, Visit visit) -> decltype(visit(path, false))
+    {
+        size_t i = 0;
+        while (i < path.size())
+        {
+            if (path[i] == '/')
+            {
+                ++i;
+                continue;
+            }
+
+            auto end = std::min(path.find('/', i), path.size());
+            auto last = path.find_first_not_of('/', end) == std::string_view::npos;
+            if (auto result = visit(path.substr(i, end - i), last); !result)
+                return result;
+            i = end;
+        }
+        return {};
+    }
+}
+
+std::string_view PathArena::store(std::string_view text)
+{
+    if (text.size() > left)
+    {
+        auto size = std::max(ARENA_CHUNK, text.size());
+        chunks.push_back(std::make_unique<char[]>(size));
+        cursor = chunks.back().get();
+        left = size;
+    }
+
+    std::memcpy(cursor, text.data(), text.size());
+    std::string_view stored(cursor, text.size());
+    cursor += text.size();
+    left -= text.size();
+    return stored;
+}
+
+PathInterner::PathInterner(PathArena &arena) :
+    arena(arena)
+{
+}
+
+bool PathInterner::contains(std::string_view path) const
+{
+    return paths.contains(path);
+}
+
+std::string_view PathInterner::intern(std::string_view path)
+{
+    if (auto it = paths.find(path); it != paths.end())
+        return *it;
+    return *paths.insert(arena.store(path)).first;
+}
+
+bool PathInterner::empty() const
+{
+    return paths.empty();
+}
+
+void PathInterner::clear()
+{
+    paths.clear();
+}
+
+void PathInterner::prefix(std::string_view dir)
+{
+    std::unordered_set<std::string_view> moved;
+    std::string joined;
+    for (auto path : paths)
+    {
+        joined.assign(dir);
+        joined += '/';
+        joined += path;
+        moved.insert(arena.store(joined));
+    }
+    paths = std::move(moved);
+}
+
+EntryPaths::EntryPaths(const fs::path &dest_path) :
+    symlinks(arena), checked_dirs(arena)
+{
+    path = dest_path.string();
+    if (!path.ends_with('/'))
+        path += '/';
+    root_length = path.size();
+
+    /* long enough for nearly every entry name, so the buffers are not regrown per entry */
+    path.reserve(root_length + 4096);
+    link = path;
+    link.reserve(path.capacity());
+    scratch.reserve(4096);
+}
+
+std::expected<void, std::string_view> EntryPaths::normalise(std::string_view name, std::string &out)
+{
+    out.resize(root_length);
+
+    return for_each_component(name, [&](std::string_view component, bool) -> std::expected<void, std::string_view> {
+        if (component == ".")
+            return {};
+        if (component == "..")
+            return std::unexpected("contains '..'");
+
+        if (out.size() > root_length)
+            out += '/';
+        out += component;
+        return {};
+    });
+}
+
+bool EntryPaths::crosses_symlink(std::string_view relative) const
+{
+    for (size_t slash = relative.find('/'); slash != std::string_view::npos; slash = relative.find('/', slash + 1))
+    {
+        if (symlinks.contains(relative.substr(0, slash)))
+            return true;
+    }
+    return !relative.empty() && symlinks.contains(relative);
+}
+
+std::expected<const char *, std::string_view> EntryPaths::resolve(std::string_view name)
+{
+    if (auto normalised = normalise(name, path); !normalised)
+        return std::unexpected(normalised.error());
+
+    if (symlinks.empty())
+        return path.c_str();
+
+    auto dir = parent_of(relative());
+    if (!dir.empty() && !checked_dirs.contains(dir))
+    {
+        if (crosses_symlink(dir))
+            return std::unexpected("would be written through a symlink");
+        checked_dirs.intern(dir);
+    }
+
+    return path.c_str();
+}
+
+std::expected<const char *, std::string_view> EntryPaths::resolve_link(std::string_view target)
+{
+    if (auto normalised = normalise(target, link); !normalised)
+        return std::unexpected(normalised.error());
+
+    auto relative = std::string_view(link).substr(root_length);
+    if (relative.empty())
+        return std::unexpected("links to the extraction directory");
+    if (!symlinks.empty() && crosses_symlink(parent_of(relative)))
+        return std::unexpected("links through a symlink");
+
+    return link.c_str();
+}
+
+std::expected<void, std::string_view> EntryPaths::add_symlink(std::string_view target)
+{
+    auto name = relative();
+    if (name.empty())
+        return std::unexpected("replaces the extraction directory");
+    if (target.empty())
+        return std::unexpected("has an empty target");
+    if (target.front() == '/')
+        return std::unexpected("points to an absolute path");
+
+    /* resolve the target lexically from the link's directory; going through another symlink would make
+     * that meaningless, so it is refused rather than followed */
+    scratch.assign(parent_of(name));
+    auto resolved = for_each_component(target,
+            [&](std::string_view component, bool last) -> std::expected<void, std::string_view> {
+                if (component == ".")
+                    return {};
+                if (component == "..")
+                {
+                    if (scratch.empty())
+                        return std::unexpected("points outside the extraction directory");
+                    scratch.resize(parent_of(scratch).size());
+                    return {};
+                }
+
+                if (!scratch.empty())
+                    scratch += '/';
+                scratch += component;
+                if (!last && symlinks.contains(scratch))
+                    return std::unexpected("points through another symlink");
+                return {};
+            });
+    if (!resolved)
+        return resolved;
+
+    symlinks.intern(name);
+    /* a directory checked before this link existed may now lead through it */
+    checked_dirs.clear();
+    return {};
+}
+
+void EntryPaths::rebase(std::string_view dir)
+{
+    symlinks.prefix(dir);
+    checked_dirs.clear();
+}
+
+std::string_view EntryPaths::relative() const
+{
+    return std::string_view(path).substr(root_length);
+}
+
+std::string_view EntryPaths::relative_link() const
+{
+    return std::string_view(link).substr(root_length);
+}
@@ -0,0 +1,82 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <cstddef>
+#include <expected>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+/* bump allocator for strings that live as long as one extraction. strings are never freed
+ * individually, so storing one is a pointer bump except when a new chunk is needed */
+class PathArena
+{
+public:
+    std::string_view store(std::string_view text);
+
+private:
+    std::vector<std::unique_ptr<char[]>> chunks;
+    char *cursor = nullptr;
+    size_t left = 0;
+};
+
+/* a set of strings kept in an arena. lookups take a `string_view` and never allocate */
+class PathInterner
+{
+public:
+    explicit PathInterner(PathArena &arena);
+
+    bool contains(std::string_view path) const;
+    std::string_view intern(std::string_view path);
+    bool empty() const;
+    void clear();
+    /* moves every path in the set below `dir` */
+    void prefix(std::string_view dir);
+
+private:
+    PathArena &arena;
+    std::unordered_set<std::string_view> paths;
+};
+
+/* turns archive entry names into paths below the extraction directory. the result is assembled in a
+ * buffer that is reused from entry to entry, and the name is normalised and checked in the same pass:
+ * `.` and empty components are dropped, leading slashes are stripped and `..` is refused. entries
+ * that would be written through a symlink extracted earlier, and symlinks pointing outside the
+ * directory, are refused as well. parent directories already checked are interned, so the usual run of
+ * entries in one directory costs a single hash lookup */
+class EntryPaths
+{
+public:
+    explicit EntryPaths(const std::filesystem::path &dest_path);
+    EntryPaths(const EntryPaths &) = delete;
+    EntryPaths &operator=(const EntryPaths &) = delete;
+
+    /* NUL terminated and valid until the next call. the error says why the entry was refused */
+    std::expected<const char *, std::string_view> resolve(std::string_view name);
+    /* the same for a hardlink target, in its own buffer so that both can be handed to libarchive */
+    std::expected<const char *, std::string_view> resolve_link(std::string_view target);
+    /* checks the target of the symlink entry last passed to `resolve()` and records it */
+    std::expected<void, std::string_view> add_symlink(std::string_view target);
+    /* everything resolved so far has been moved below `dir` in the extraction directory */
+    void rebase(std::string_view dir);
+
+    /* the last resolved entry and hardlink target, relative to the extraction directory */
+    std::string_view relative() const;
+    std::string_view relative_link() const;
+
+private:
+    std::expected<void, std::string_view> normalise(std::string_view name, std::string &out);
+    bool crosses_symlink(std::string_view relative) const;
+
+    std::string path;
+    std::string link;
+    std::string scratch;
+    size_t root_length = 0;
+    PathArena arena;
+    PathInterner symlinks;
+    PathInterner checked_dirs;
+};
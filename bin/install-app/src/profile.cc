@@ -0,0 +1,271 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "profile.hh"
+
+namespace fs = std::filesystem;
+
+extern char **environ;
+
+namespace
+{
+    /* how long a group that was asked to stop gets before it is killed */
+    constexpr auto STOP_GRACE = std::chrono::seconds(2);
+
+    class Watches
+    {
+    public:
+        Watches() : fd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+        {
+        }
+
+        ~Watches()
+        {
+            if (fd >= 0)
+                close(fd);
+        }
+
+        Watches(const Watches &) = delete;
+        Watches &operator=(const Watches &) = delete;
+
+        std::expected<void, std::string> add(const fs::path &root)
+        {
+            if (fd < 0)
+                return std::unexpected(std::format("Failed to start inotify: {}", std::strerror(errno)));
+
+            std::error_code ec;
+            if (auto failed = watch(root, ""))
+                return std::unexpected(*failed);
+            for (auto it = fs::recursive_directory_iterator(root, ec); !ec && it != fs::recursive_directory_iterator();
+                    it.increment(ec))
+            {
+                if (!it->is_directory(ec) || it->is_symlink(ec))
+                    continue;
+                if (auto failed = watch(it->path(), it->path().lexically_relative(root).string() + "/"))
+                    return std::unexpected(*failed);
+            }
+            if (ec)
+                return std::unexpected(std::format("Failed to walk {}: {}", root.string(), ec.message()));
+            return {};
+        }
+
+        /* takes in whatever events are queued, waiting up to `timeout` for the first */
+        void read(std::chrono::milliseconds timeout)
+        {
+            pollfd waiting{ fd, POLLIN, 0 };
+            if (poll(&waiting, 1, static_cast<int>(timeout.count())) <= 0)
+                return;
+
+            alignas(inotify_event) char buffer[64 * 1024];
+            for (;;)
+            {
+                ssize_t got = ::read(fd, buffer, sizeof buffer);
+                if (got <= 0)
+                    return;
+                for (ssize_t at = 0; at < got;)
+                {
+                    auto *event = reinterpret_cast<const inotify_event *>(buffer + at);
+                    at += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+                    /* events on a watched directory itself come without a name */
+                    if (event->len == 0 || (event->mask & IN_ISDIR))
+                        continue;
+                    auto dir = directories.find(event->wd);
+                    if (dir == directories.end())
+                        continue;
+                    std::string relative = dir->second + event->name;
+                    if (seen.insert(relative).second)
+                        files.push_back(std::move(relative));
+                }
+            }
+        }
+
+        std::vector<std::string> files;
+
+    private:
+        std::optional<std::string> watch(const fs::path &dir, std::string relative)
+        {
+            int wd = inotify_add_watch(fd, dir.c_str(), IN_OPEN | IN_ACCESS | IN_ONLYDIR | IN_DONT_FOLLOW);
+            if (wd < 0)
+            {
+                if (errno == ENOSPC)
+                    return std::format("Ran out of inotify watches after {} directories; raise "
+                            "fs.inotify.max_user_watches", directories.size());
+                return std::format("Failed to watch {}: {}", dir.string(), std::strerror(errno));
+            }
+            directories.emplace(wd, std::move(relative));
+            return std::nullopt;
+        }
+
+        int fd;
+        std::unordered_map<int, std::string> directories;
+        std::unordered_set<std::string> seen;
+    };
+
+    bool group_alive(pid_t group)
+    {
+        return kill(-group, 0) == 0 || errno == EPERM;
+    }
+}
+
+std::expected<StartupProfile, std::string> record_startup(const fs::path &executable, const fs::path &root,
+        std::chrono::milliseconds limit)
+{
+    Watches watches;
+    if (auto added = watches.add(root); !added)
+        return std::unexpected(added.error());
+
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attributes;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attributes, 0);
+
+    std::string program = executable.string();
+    char *argv[] = { program.data(), nullptr };
+    pid_t pid;
+    int spawned = posix_spawn(&pid, program.c_str(), &actions, &attributes, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+    if (spawned != 0)
+        return std::unexpected(std::format("Failed to start {}: {}", program, std::strerror(spawned)));
+
+    /* the group, not the process, is what is waited for, since launchers often start the app and return */
+    StartupProfile profile;
+    bool reaped = false;
+    auto reap = [&] {
+        if (!reaped && waitpid(pid, nullptr, WNOHANG) == pid)
+            reaped = true;
+        return reaped && !group_alive(pid);
+    };
+
+    auto deadline = std::chrono::steady_clock::now() + limit;
+    while (!reap())
+    {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (left <= std::chrono::milliseconds::zero())
+        {
+            profile.stopped = true;
+            break;
+        }
+        watches.read(std::min(left, std::chrono::milliseconds(100)));
+    }
+
+    if (profile.stopped)
+    {
+        /* what it opens while shutting down is not part of starting, so the events stop here */
+        watches.read(std::chrono::milliseconds::zero());
+        profile.files = std::move(watches.files);
+
+        kill(-pid, SIGTERM);
+        auto grace = std::chrono::steady_clock::now() + STOP_GRACE;
+        while (!reap() && std::chrono::steady_clock::now() < grace)
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        if (!reap())
+        {
+            kill(-pid, SIGKILL);
+            if (!reaped)
+                waitpid(pid, nullptr, 0);
+        }
+        return profile;
+    }
+
+    watches.read(std::chrono::milliseconds::zero());
+    profile.files = std::move(watches.files);
+    return profile;
+}
+
+void preallocate(const fs::path &file, uint64_t size)
+{
+    if (size == 0)
+        return;
+    int fd = open(file.c_str(), O_WRONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0)
+        return;
+    /* only a hint: file systems without it still get the data, just wherever it falls */
+    fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size));
+    close(fd);
+}
+
+bool copy_preallocated(const fs::path &source, const fs::path &root, const std::string &relative)
+{
+    auto from = source / relative;
+    auto to = root / relative;
+
+    /* a directory that has become a symlink is the recursive copy's to make, not this one's */
+    std::error_code ec;
+    auto dir = fs::path(relative).parent_path();
+    fs::path made;
+    for (const auto &part : dir)
+    {
+        made /= part;
+        if (fs::symlink_status(source / made, ec).type() != fs::file_type::directory)
+            return false;
+    }
+
+    int in = open(from.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (in < 0)
+        return false;
+    struct stat st;
+    if (fstat(in, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        close(in);
+        return false;
+    }
+
+    /* one directory at a time, each with the mode of the one it is copied from, as a recursive copy would */
+    made.clear();
+    for (const auto &part : dir)
+    {
+        made /= part;
+        if (!fs::exists(root / made, ec))
+            fs::create_directory(root / made, source / made, ec);
+    }
+
+    int out = open(to.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, st.st_mode & 07777);
+    if (out < 0)
+    {
+        close(in);
+        return false;
+    }
+    if (st.st_size > 0)
+        fallocate(out, 0, 0, st.st_size);
+
+    bool copied = true;
+    for (off_t left = st.st_size; left > 0;)
+    {
+        ssize_t sent = copy_file_range(in, nullptr, out, nullptr, static_cast<size_t>(left), 0);
+        if (sent <= 0)
+            sent = sendfile(out, in, nullptr, static_cast<size_t>(left));
+        if (sent <= 0)
+        {
+            copied = false;
+            break;
+        }
+        left -= sent;
+    }
+    /* the mode given to open() went through the umask; a recursive copy keeps it as it is */
+    fchmod(out, st.st_mode & 07777);
+    close(in);
+    close(out);
+    if (!copied)
+        fs::remove(to, ec);
+    return copied;
+}
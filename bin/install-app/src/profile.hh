@@ -0,0 +1,37 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/* the files below an install that its app reads while starting, in the order it first touches them.
+ * kept as the manifest's `startup` lines, so that later installs lay those files down first and next to
+ * each other, and `--warm` reads them back in one go */
+struct StartupProfile
+{
+    /* relative to the install */
+    std::vector<std::string> files;
+    /* whether the app was still running when the time ran out, and was stopped */
+    bool stopped = false;
+};
+
+/* runs `executable` once, with standard input from /dev/null and in a process group of its own, and
+ * records the IN_OPEN and IN_ACCESS events inotify reports on every directory below `root` until the
+ * group is gone or `limit` has passed. whatever is left of the group is then terminated */
+std::expected<StartupProfile, std::string> record_startup(const std::filesystem::path &executable,
+        const std::filesystem::path &root, std::chrono::milliseconds limit);
+
+/* reserves `size` bytes of blocks for `file` without changing its size, so that what is written into
+ * it next lands in one extent */
+void preallocate(const std::filesystem::path &file, uint64_t size);
+
+/* copies the regular file `source/relative` to `root/relative`, which must not exist yet, preallocated
+ * and with the same permissions. missing directories on the way are made like their counterparts below
+ * `source`. false when there is no such regular file to copy */
+bool copy_preallocated(const std::filesystem::path &source, const std::filesystem::path &root,
+        const std::string &relative);
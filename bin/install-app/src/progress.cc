@@ -0,0 +1,139 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <print>
+#include <unistd.h>
+#include "log.hh"
+#include "progress.hh"
+#include "units.hh"
+
+using namespace std::chrono_literals;
+
+namespace
+{
+    /* a quick install never shows a progress line at all */
+    constexpr auto tty_interval = 100ms;
+    constexpr auto tty_delay = 500ms;
+    constexpr auto plain_interval = 5s;
+}
+
+void progress::Counters::reset()
+{
+    bytes.store(0, std::memory_order_relaxed);
+    entries.store(0, std::memory_order_relaxed);
+    consumed.store(0, std::memory_order_relaxed);
+    total_input.store(0, std::memory_order_relaxed);
+    total_bytes.store(0, std::memory_order_relaxed);
+}
+
+ProgressReporter::ProgressReporter(std::string label, bool enabled) :
+    label(std::move(label))
+{
+    if (!enabled)
+        return;
+
+    tty = isatty(STDERR_FILENO);
+    started = std::chrono::steady_clock::now();
+    last_sample = started;
+    worker = std::jthread([this](std::stop_token token)
+    {
+        run(token);
+    });
+}
+
+ProgressReporter::~ProgressReporter()
+{
+    stop();
+}
+
+void ProgressReporter::stop()
+{
+    if (!worker.joinable())
+        return;
+
+    worker.request_stop();
+    wakeup.notify_all();
+    worker.join();
+
+    if (drawn)
+        draw(true);
+}
+
+void ProgressReporter::run(std::stop_token token)
+{
+    std::unique_lock guard(lock);
+    auto never = [] { return false; };
+
+    wakeup.wait_for(guard, token, tty ? tty_delay : plain_interval, never);
+    while (!token.stop_requested())
+    {
+        draw(false);
+        wakeup.wait_for(guard, token, tty ? tty_interval : plain_interval, never);
+    }
+}
+
+void ProgressReporter::draw(bool final)
+{
+    auto now = std::chrono::steady_clock::now();
+    auto &c = progress::counters;
+    auto consumed = c.consumed.load(std::memory_order_relaxed);
+    auto bytes = c.bytes.load(std::memory_order_relaxed);
+    auto entries = c.entries.load(std::memory_order_relaxed);
+    auto total_input = c.total_input.load(std::memory_order_relaxed);
+    auto total_bytes = c.total_bytes.load(std::memory_order_relaxed);
+
+    auto since_last = std::chrono::duration<double>(now - last_sample).count();
+    auto elapsed = std::chrono::duration<double>(now - started).count();
+
+    if (final)
+    {
+        input_rate = elapsed > 0 ? static_cast<double>(consumed) / elapsed : 0;
+        output_rate = elapsed > 0 ? static_cast<double>(bytes) / elapsed : 0;
+    }
+    else if (since_last > 0)
+    {
+        /* smoothed so the estimate does not jump around between a large file and a run of tiny ones */
+        auto input_now = static_cast<double>(consumed - last_consumed) / since_last;
+        auto output_now = static_cast<double>(bytes - last_bytes) / since_last;
+        input_rate = drawn ? 0.8 * input_rate + 0.2 * input_now : input_now;
+        output_rate = drawn ? 0.8 * output_rate + 0.2 * output_now : output_now;
+    }
+
+    last_sample = now;
+    last_consumed = consumed;
+    last_bytes = bytes;
+
+    auto line = std::format("{}: {} entries, {} written, {:.1f} MB/s", label, entries, human_bytes(bytes),
+            output_rate / 1e6);
+
+    /* the uncompressed total wins when known, otherwise compressed input consumed drives the ETA */
+    double fraction = -1;
+    double remaining = 0;
+    if (total_bytes > 0 && output_rate > 0)
+    {
+        fraction = static_cast<double>(bytes) / static_cast<double>(total_bytes);
+        remaining = static_cast<double>(total_bytes - std::min(bytes, total_bytes)) / output_rate;
+    }
+    else if (total_input > 0 && input_rate > 0)
+    {
+        fraction = static_cast<double>(consumed) / static_cast<double>(total_input);
+        remaining = static_cast<double>(total_input - std::min(consumed, total_input)) / input_rate;
+    }
+
+    if (final)
+        line += std::format(" in {}", human_duration(std::chrono::seconds(static_cast<int64_t>(elapsed))));
+    else if (fraction >= 0)
+        line += std::format(", {:.0f}%, ETA {}", std::min(fraction, 1.0) * 100,
+                human_duration(std::chrono::seconds(static_cast<int64_t>(remaining))));
+
+    /* the logger draws the tty line, so that messages logged meanwhile go above it instead of onto it */
+    if (tty && final)
+        logging::end_status(line);
+    else if (tty)
+        logging::status(line);
+    else
+    {
+        std::println(stderr, "{}", line);
+        std::fflush(stderr);
+    }
+    drawn = true;
+}
@@ -0,0 +1,59 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace progress
+{
+    /* written by the extraction workers with relaxed atomics; only the reporter thread reads them */
+    struct Counters
+    {
+        std::atomic<uint64_t> bytes = 0;
+        std::atomic<uint64_t> entries = 0;
+        std::atomic<uint64_t> consumed = 0;
+        std::atomic<uint64_t> total_input = 0;
+        /* what all of it comes to uncompressed, when the archive says so up front (a zip's directory) */
+        std::atomic<uint64_t> total_bytes = 0;
+
+        void reset();
+    };
+
+    inline Counters counters;
+}
+
+/* redraws a single status line on a tty, or prints a plain line every few seconds otherwise. all the
+ * formatting happens on its own thread so the extraction loop only pays for the counter updates */
+class ProgressReporter
+{
+public:
+    ProgressReporter(std::string label, bool enabled);
+    ProgressReporter(const ProgressReporter &) = delete;
+    ProgressReporter &operator=(const ProgressReporter &) = delete;
+    ~ProgressReporter();
+
+    void stop();
+
+private:
+    void run(std::stop_token token);
+    void draw(bool final);
+
+    std::string label;
+    bool tty = false;
+    bool drawn = false;
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point last_sample;
+    uint64_t last_consumed = 0;
+    uint64_t last_bytes = 0;
+    double input_rate = 0;
+    double output_rate = 0;
+    std::mutex lock;
+    std::condition_variable_any wakeup;
+    std::jthread worker;
+};
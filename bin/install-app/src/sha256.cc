@@ -0,0 +1,242 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <bit>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define INSTALL_APP_SHA_NI 1
+#endif
+#include "sha256.hh"
+
+namespace
+{
+    alignas(16) constexpr uint32_t K[64] = { 0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+        0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7,
+        0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967, 0x27b70a85,
+        0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+        0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116, 0x1e376c08, 0x2748774c,
+        0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+        0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2 };
+
+    using Compress = void (*)(uint32_t *state, const std::byte *data, size_t blocks);
+
+    uint32_t load_big_endian(const std::byte *data)
+    {
+        uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        if constexpr (std::endian::native == std::endian::little)
+            value = std::byteswap(value);
+        return value;
+    }
+
+    void compress_portable(uint32_t *state, const std::byte *data, size_t blocks)
+    {
+        for (; blocks > 0; --blocks, data += 64)
+        {
+            uint32_t w[64];
+            for (int i = 0; i < 16; ++i)
+                w[i] = load_big_endian(data + 4 * i);
+            for (int i = 16; i < 64; ++i)
+            {
+                auto s0 = std::rotr(w[i - 15], 7) ^ std::rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                auto s1 = std::rotr(w[i - 2], 17) ^ std::rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+            }
+
+            auto a = state[0], b = state[1], c = state[2], d = state[3];
+            auto e = state[4], f = state[5], g = state[6], h = state[7];
+            for (int i = 0; i < 64; ++i)
+            {
+                auto t1 = h + (std::rotr(e, 6) ^ std::rotr(e, 11) ^ std::rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+                auto t2 = (std::rotr(a, 2) ^ std::rotr(a, 13) ^ std::rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+                h = g;
+                g = f;
+                f = e;
+                e = d + t1;
+                d = c;
+                c = b;
+                b = a;
+                a = t1 + t2;
+            }
+
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+            state[4] += e;
+            state[5] += f;
+            state[6] += g;
+            state[7] += h;
+        }
+    }
+
+#ifdef INSTALL_APP_SHA_NI
+    /* the SHA extensions keep the state as ABEF/CDGH pairs and do two rounds per instruction; the
+     * message schedule runs four words at a time alongside */
+    __attribute__((target("sha,sse4.1,ssse3"))) void compress_sha_ni(uint32_t *state, const std::byte *data,
+            size_t blocks)
+    {
+        const auto byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+        auto cdab = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state)), 0xb1);
+        auto efgh = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state + 4)), 0x1b);
+        auto abef = _mm_alignr_epi8(cdab, efgh, 8);
+        auto cdgh = _mm_blend_epi16(efgh, cdab, 0xf0);
+
+        for (; blocks > 0; --blocks, data += 64)
+        {
+            auto abef_before = abef;
+            auto cdgh_before = cdgh;
+
+            __m128i w[4];
+            for (int i = 0; i < 4; ++i)
+                w[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16 * i)), byte_swap);
+
+#pragma GCC unroll 16
+            for (int i = 0; i < 16; ++i)
+            {
+                auto message = _mm_add_epi32(w[i & 3], _mm_load_si128(reinterpret_cast<const __m128i *>(K + 4 * i)));
+                cdgh = _mm_sha256rnds2_epu32(cdgh, abef, message);
+                if (i >= 3 && i <= 14)
+                {
+                    auto next = _mm_add_epi32(w[(i + 1) & 3], _mm_alignr_epi8(w[i & 3], w[(i + 3) & 3], 4));
+                    w[(i + 1) & 3] = _mm_sha256msg2_epu32(next, w[i & 3]);
+                }
+                abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(message, 0x0e));
+                if (i >= 1 && i <= 12)
+                    w[(i + 3) & 3] = _mm_sha256msg1_epu32(w[(i + 3) & 3], w[i & 3]);
+            }
+
+            abef = _mm_add_epi32(abef, abef_before);
+            cdgh = _mm_add_epi32(cdgh, cdgh_before);
+        }
+
+        auto feba = _mm_shuffle_epi32(abef, 0x1b);
+        auto dchg = _mm_shuffle_epi32(cdgh, 0xb1);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(state), _mm_blend_epi16(feba, dchg, 0xf0));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(state + 4), _mm_alignr_epi8(dchg, feba, 8));
+    }
+#endif
+
+    bool has_sha_ni()
+    {
+#ifdef INSTALL_APP_SHA_NI
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("ssse3");
+#else
+        return false;
+#endif
+    }
+
+    Compress select_compress()
+    {
+#ifdef INSTALL_APP_SHA_NI
+        if (has_sha_ni())
+            return compress_sha_ni;
+#endif
+        return compress_portable;
+    }
+
+    void compress(uint32_t *state, const std::byte *data, size_t blocks)
+    {
+        static const Compress selected = select_compress();
+        selected(state, data, blocks);
+    }
+}
+
+void Sha256::update(std::span<const std::byte> data)
+{
+    length += data.size();
+
+    if (buffered > 0)
+    {
+        auto take = std::min(data.size(), buffer.size() - buffered);
+        std::memcpy(buffer.data() + buffered, data.data(), take);
+        buffered += take;
+        data = data.subspan(take);
+        if (buffered < buffer.size())
+            return;
+        compress(state.data(), buffer.data(), 1);
+        buffered = 0;
+    }
+
+    if (auto blocks = data.size() / 64; blocks > 0)
+    {
+        compress(state.data(), data.data(), blocks);
+        data = data.subspan(blocks * 64);
+    }
+
+    std::memcpy(buffer.data(), data.data(), data.size());
+    buffered = data.size();
+}
+
+Sha256::Digest Sha256::finish()
+{
+    auto bits = length * 8;
+    buffer[buffered++] = std::byte{ 0x80 };
+    if (buffered > 56)
+    {
+        std::memset(buffer.data() + buffered, 0, buffer.size() - buffered);
+        compress(state.data(), buffer.data(), 1);
+        buffered = 0;
+    }
+    std::memset(buffer.data() + buffered, 0, 56 - buffered);
+    for (int i = 0; i < 8; ++i)
+        buffer[56 + i] = static_cast<std::byte>(bits >> (56 - 8 * i));
+    compress(state.data(), buffer.data(), 1);
+
+    Digest digest;
+    for (size_t i = 0; i < state.size(); ++i)
+    {
+        for (size_t j = 0; j < 4; ++j)
+            digest[4 * i + j] = static_cast<uint8_t>(state[i] >> (24 - 8 * j));
+    }
+    return digest;
+}
+
+std::string Sha256::hex(const Digest &digest)
+{
+    constexpr std::string_view digits = "0123456789abcdef";
+    std::string out;
+    out.reserve(digest.size() * 2);
+    for (auto byte : digest)
+    {
+        out += digits[byte >> 4];
+        out += digits[byte & 0xf];
+    }
+    return out;
+}
+
+std::optional<Sha256::Digest> Sha256::parse(std::string_view hex)
+{
+    if (hex.size() != 64)
+        return std::nullopt;
+
+    auto nibble = [](char c) -> int {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    };
+
+    Digest digest;
+    for (size_t i = 0; i < digest.size(); ++i)
+    {
+        auto high = nibble(hex[2 * i]);
+        auto low = nibble(hex[2 * i + 1]);
+        if (high < 0 || low < 0)
+            return std::nullopt;
+        digest[i] = static_cast<uint8_t>(high << 4 | low);
+    }
+    return digest;
+}
+
+std::string_view Sha256::implementation()
+{
+    static const bool sha_ni = has_sha_ni();
+    return sha_ni ? "sha-ni" : "portable";
+}
@@ -0,0 +1,34 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+/* incremental SHA-256. blocks are compressed with the SHA extensions where the CPU has them, and with
+ * plain C++ otherwise; the choice is made once, on first use */
+class Sha256
+{
+public:
+    using Digest = std::array<uint8_t, 32>;
+
+    void update(std::span<const std::byte> data);
+    Digest finish();
+
+    static std::string hex(const Digest &digest);
+    static std::optional<Digest> parse(std::string_view hex);
+    /* "sha-ni" or "portable" */
+    static std::string_view implementation();
+
+private:
+    std::array<uint32_t, 8> state = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c,
+        0x1f83d9ab, 0x5be0cd19 };
+    std::array<std::byte, 64> buffer = {};
+    size_t buffered = 0;
+    uint64_t length = 0;
+};
@@ -0,0 +1,365 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <algorithm>
+#include <charconv>
+#include <format>
+#include <print>
+#include <string_view>
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "json.hh"
+#include "memstats.hh"
+#include "timings.hh"
+#include "units.hh"
+
+namespace
+{
+    enum PerfIndex
+    {
+        PERF_CYCLES,
+        PERF_INSTRUCTIONS,
+        PERF_PAGE_FAULTS,
+        PERF_CONTEXT_SWITCHES
+    };
+
+    int open_perf_counter(uint32_t type, uint64_t config)
+    {
+        perf_event_attr attr = {};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.inherit = 1;
+        attr.exclude_hv = 1;
+        /* user-space only keeps hardware counters usable under the default `perf_event_paranoid` */
+        attr.exclude_kernel = type == PERF_TYPE_HARDWARE;
+
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+    }
+
+    std::optional<uint64_t> read_perf_counter(int fd)
+    {
+        if (fd < 0)
+            return std::nullopt;
+
+        uint64_t value = 0;
+        if (read(fd, &value, sizeof(value)) != sizeof(value))
+            return std::nullopt;
+        return value;
+    }
+
+    /* `/proc/self/io` accounts for the whole thread group, so worker threads are included */
+    void read_proc_io(ResourceSample &sample)
+    {
+        int fd = open("/proc/self/io", O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return;
+
+        char buffer[512];
+        auto n = read(fd, buffer, sizeof(buffer));
+        close(fd);
+        if (n <= 0)
+            return;
+
+        std::string_view text(buffer, static_cast<size_t>(n));
+        uint64_t syscr = 0;
+        uint64_t syscw = 0;
+
+        while (!text.empty())
+        {
+            auto eol = text.find('\n');
+            auto line = text.substr(0, eol);
+            text.remove_prefix(eol == std::string_view::npos ? text.size() : eol + 1);
+
+            auto colon = line.find(':');
+            if (colon == std::string_view::npos || colon + 2 > line.size())
+                continue;
+
+            auto key = line.substr(0, colon);
+            auto value = line.substr(colon + 2);
+            uint64_t parsed = 0;
+            std::from_chars(value.data(), value.data() + value.size(), parsed);
+
+            if (key == "rchar")
+                sample.bytes_in = parsed;
+            else if (key == "wchar")
+                sample.bytes_out = parsed;
+            else if (key == "syscr")
+                syscr = parsed;
+            else if (key == "syscw")
+                syscw = parsed;
+        }
+
+        sample.syscalls = syscr + syscw;
+    }
+
+    double to_ms(std::chrono::microseconds us)
+    {
+        return static_cast<double>(us.count()) / 1000.0;
+    }
+
+    std::string optional_count(const std::optional<uint64_t> &value)
+    {
+        return value ? std::format("{}", *value) : "-";
+    }
+
+    std::string optional_json(const std::optional<uint64_t> &value)
+    {
+        return value ? std::format("{}", *value) : "null";
+    }
+
+    void print_row(std::FILE *out, const PhaseTiming &phase)
+    {
+        std::println(out, "{:<18} {:>10.2f} {:>10.2f} {:>10.2f} {:>11} {:>11} {:>7} {:>9} {:>14} {:>14} {:>8} {:>7}",
+                phase.name, phase.wall_ms, phase.user_ms, phase.sys_ms, human_bytes(phase.bytes_in),
+                human_bytes(phase.bytes_out), phase.files_written, phase.syscalls, optional_count(phase.cycles),
+                optional_count(phase.instructions), phase.page_faults, phase.context_switches);
+    }
+
+    void print_memory_row(std::FILE *out, const PhaseTiming &phase)
+    {
+        std::println(out, "{:<18} {:>12} {:>12} {:>12} {:>12}", phase.name, phase.allocations,
+                human_bytes(phase.allocated_bytes), human_bytes(static_cast<uint64_t>(std::max<int64_t>(phase.peak_heap_bytes, 0))),
+                human_bytes(phase.max_rss_bytes));
+    }
+
+    std::string phase_json(const PhaseTiming &phase)
+    {
+        auto out = std::format("{{\"name\":\"{}\",\"wall_ms\":{:.3f},\"user_ms\":{:.3f},\"sys_ms\":{:.3f},"
+                               "\"bytes_in\":{},\"bytes_out\":{},\"files_written\":{},\"syscalls\":{},"
+                               "\"cycles\":{},\"instructions\":{},\"page_faults\":{},\"context_switches\":{},"
+                               "\"max_rss_bytes\":{}",
+                json_escape(phase.name), phase.wall_ms, phase.user_ms, phase.sys_ms, phase.bytes_in, phase.bytes_out,
+                phase.files_written, phase.syscalls, optional_json(phase.cycles), optional_json(phase.instructions),
+                phase.page_faults, phase.context_switches, phase.max_rss_bytes);
+
+        if (memstats::enabled())
+            out += std::format(",\"allocations\":{},\"allocated_bytes\":{},\"peak_heap_bytes\":{}", phase.allocations,
+                    phase.allocated_bytes, phase.peak_heap_bytes);
+
+        out += '}';
+        return out;
+    }
+}
+
+Timings::Scope::Scope(Timings *owner, size_t index) :
+    owner(owner), index(index)
+{
+    if (!owner)
+        return;
+
+    previous = owner->current;
+    owner->current = index;
+    memstats::reset_peak();
+    start = owner->sample();
+}
+
+Timings::Scope::~Scope()
+{
+    if (!owner)
+        return;
+
+    owner->accumulate(owner->phase_list[index], start, owner->sample());
+    owner->current = previous;
+}
+
+Timings::Timings(bool enabled, bool hardware_counters) :
+    is_enabled(enabled), perf_fds{ -1, -1, -1, -1 }
+{
+    overall.name = "total";
+    if (!is_enabled)
+        return;
+
+    if (hardware_counters)
+    {
+        perf_fds[PERF_CYCLES] = open_perf_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        perf_fds[PERF_INSTRUCTIONS] = open_perf_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        perf_fds[PERF_PAGE_FAULTS] = open_perf_counter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+        perf_fds[PERF_CONTEXT_SWITCHES] = open_perf_counter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES);
+    }
+
+    origin = sample();
+}
+
+Timings::~Timings()
+{
+    for (auto fd : perf_fds)
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+}
+
+Timings::Scope Timings::phase(std::string_view name)
+{
+    if (!is_enabled)
+        return Scope(nullptr, 0);
+
+    for (size_t i = 0; i < phase_list.size(); ++i)
+    {
+        if (phase_list[i].name == name)
+            return Scope(this, i);
+    }
+
+    phase_list.push_back(PhaseTiming{ .name = std::string(name) });
+    return Scope(this, phase_list.size() - 1);
+}
+
+void Timings::add_files(uint64_t count)
+{
+    if (!is_enabled)
+        return;
+
+    if (current)
+        phase_list[*current].files_written += count;
+    overall.files_written += count;
+}
+
+void Timings::finish()
+{
+    if (!is_enabled)
+        return;
+
+    auto files = overall.files_written;
+    overall = PhaseTiming{ .name = "total" };
+    accumulate(overall, origin, sample());
+    overall.files_written = files;
+
+    /* every phase restarts the heap peak, so the overall one is the largest of theirs */
+    for (const auto &phase : phase_list)
+        overall.peak_heap_bytes = std::max(overall.peak_heap_bytes, phase.peak_heap_bytes);
+}
+
+bool Timings::enabled() const
+{
+    return is_enabled;
+}
+
+bool Timings::has_perf() const
+{
+    return perf_fds[PERF_CYCLES] >= 0 || perf_fds[PERF_INSTRUCTIONS] >= 0;
+}
+
+const std::vector<PhaseTiming> &Timings::phases() const
+{
+    return phase_list;
+}
+
+const PhaseTiming &Timings::total() const
+{
+    return overall;
+}
+
+void Timings::print(std::FILE *out) const
+{
+    std::println(out, "{:<18} {:>10} {:>10} {:>10} {:>11} {:>11} {:>7} {:>9} {:>14} {:>14} {:>8} {:>7}", "phase",
+            "wall ms", "user ms", "sys ms", "read", "written", "files", "io calls", "cycles", "instructions",
+            "faults", "ctxsw");
+
+    for (const auto &phase : phase_list)
+        print_row(out, phase);
+    print_row(out, overall);
+
+    if (!has_perf())
+        std::println(out, "(hardware counters unavailable; check /proc/sys/kernel/perf_event_paranoid)");
+}
+
+void Timings::print_memory(std::FILE *out) const
+{
+    if (!memstats::enabled())
+    {
+        std::println(out, "(allocation accounting is unavailable on this C library)");
+        return;
+    }
+
+    std::println(out, "{:<18} {:>12} {:>12} {:>12} {:>12}", "phase", "allocations", "allocated", "peak heap",
+            "max rss");
+
+    for (const auto &phase : phase_list)
+        print_memory_row(out, phase);
+    print_memory_row(out, overall);
+
+    std::println(out, "peak RSS {}, peak heap {}, {} buffers high-water {}, {} buffers high-water {}",
+            human_bytes(memstats::peak_rss_bytes()), human_bytes(static_cast<uint64_t>(std::max<int64_t>(overall.peak_heap_bytes, 0))),
+            memstats::decompression.name(), human_bytes(static_cast<uint64_t>(std::max<int64_t>(memstats::decompression.peak(), 0))),
+            memstats::pipeline.name(), human_bytes(static_cast<uint64_t>(std::max<int64_t>(memstats::pipeline.peak(), 0))));
+}
+
+std::string Timings::json() const
+{
+    std::string out = "{\"phases\":[";
+
+    for (size_t i = 0; i < phase_list.size(); ++i)
+    {
+        if (i > 0)
+            out += ',';
+        out += phase_json(phase_list[i]);
+    }
+
+    out += "],\"total\":";
+    out += phase_json(overall);
+
+    if (memstats::enabled())
+    {
+        out += std::format(",\"memory\":{{\"peak_rss_bytes\":{},\"peak_heap_bytes\":{},\"buffers\":{{\"{}\":{},\"{}\":{}}}}}",
+                memstats::peak_rss_bytes(), overall.peak_heap_bytes, memstats::decompression.name(),
+                memstats::decompression.peak(), memstats::pipeline.name(), memstats::pipeline.peak());
+    }
+
+    out += '}';
+
+    return out;
+}
+
+ResourceSample Timings::sample() const
+{
+    ResourceSample s;
+    s.wall = std::chrono::steady_clock::now();
+
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    s.user_time = std::chrono::seconds(usage.ru_utime.tv_sec) + std::chrono::microseconds(usage.ru_utime.tv_usec);
+    s.sys_time = std::chrono::seconds(usage.ru_stime.tv_sec) + std::chrono::microseconds(usage.ru_stime.tv_usec);
+
+    read_proc_io(s);
+
+    s.cycles = read_perf_counter(perf_fds[PERF_CYCLES]);
+    s.instructions = read_perf_counter(perf_fds[PERF_INSTRUCTIONS]);
+
+    /* getrusage() is the fallback when the software counters cannot be opened */
+    auto faults = read_perf_counter(perf_fds[PERF_PAGE_FAULTS]);
+    auto switches = read_perf_counter(perf_fds[PERF_CONTEXT_SWITCHES]);
+    auto heap = memstats::snapshot();
+    s.allocations = heap.allocations;
+    s.allocated_bytes = heap.allocated_bytes;
+    s.peak_heap_bytes = heap.peak_bytes;
+    s.max_rss_bytes = static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+
+    s.page_faults = faults.value_or(static_cast<uint64_t>(usage.ru_minflt + usage.ru_majflt));
+    s.context_switches = switches.value_or(static_cast<uint64_t>(usage.ru_nvcsw + usage.ru_nivcsw));
+
+    return s;
+}
+
+void Timings::accumulate(PhaseTiming &phase, const ResourceSample &from, const ResourceSample &to) const
+{
+    phase.wall_ms += std::chrono::duration<double, std::milli>(to.wall - from.wall).count();
+    phase.user_ms += to_ms(to.user_time - from.user_time);
+    phase.sys_ms += to_ms(to.sys_time - from.sys_time);
+    phase.bytes_in += to.bytes_in - from.bytes_in;
+    phase.bytes_out += to.bytes_out - from.bytes_out;
+    phase.syscalls += to.syscalls - from.syscalls;
+    phase.page_faults += to.page_faults - from.page_faults;
+    phase.context_switches += to.context_switches - from.context_switches;
+    phase.allocations += to.allocations - from.allocations;
+    phase.allocated_bytes += to.allocated_bytes - from.allocated_bytes;
+    phase.peak_heap_bytes = std::max(phase.peak_heap_bytes, to.peak_heap_bytes);
+    phase.max_rss_bytes = std::max(phase.max_rss_bytes, to.max_rss_bytes);
+
+    if (from.cycles && to.cycles)
+        phase.cycles = phase.cycles.value_or(0) + (*to.cycles - *from.cycles);
+    if (from.instructions && to.instructions)
+        phase.instructions = phase.instructions.value_or(0) + (*to.instructions - *from.instructions);
+}
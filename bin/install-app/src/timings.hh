@@ -0,0 +1,100 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct ResourceSample
+{
+    std::chrono::steady_clock::time_point wall;
+    std::chrono::microseconds user_time{};
+    std::chrono::microseconds sys_time{};
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    uint64_t syscalls = 0;
+    uint64_t page_faults = 0;
+    uint64_t context_switches = 0;
+    std::optional<uint64_t> cycles;
+    std::optional<uint64_t> instructions;
+    uint64_t allocations = 0;
+    uint64_t allocated_bytes = 0;
+    int64_t peak_heap_bytes = 0;
+    uint64_t max_rss_bytes = 0;
+};
+
+struct PhaseTiming
+{
+    std::string name;
+    double wall_ms = 0;
+    double user_ms = 0;
+    double sys_ms = 0;
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    uint64_t files_written = 0;
+    uint64_t syscalls = 0;
+    uint64_t page_faults = 0;
+    uint64_t context_switches = 0;
+    std::optional<uint64_t> cycles;
+    std::optional<uint64_t> instructions;
+    uint64_t allocations = 0;
+    uint64_t allocated_bytes = 0;
+    int64_t peak_heap_bytes = 0;
+    uint64_t max_rss_bytes = 0;
+};
+
+/* collects per-phase wall/cpu time, i/o and perf counters. every method is a no-op when disabled so
+ * `main()` can scope its phases unconditionally */
+class Timings
+{
+public:
+    class Scope
+    {
+    public:
+        Scope(Timings *owner, size_t index);
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+        ~Scope();
+
+    private:
+        Timings *owner;
+        size_t index;
+        std::optional<size_t> previous;
+        ResourceSample start;
+    };
+
+    explicit Timings(bool enabled, bool hardware_counters = true);
+    Timings(const Timings &) = delete;
+    Timings &operator=(const Timings &) = delete;
+    ~Timings();
+
+    [[nodiscard]] Scope phase(std::string_view name);
+    void add_files(uint64_t count);
+    void finish();
+
+    bool enabled() const;
+    bool has_perf() const;
+    const std::vector<PhaseTiming> &phases() const;
+    const PhaseTiming &total() const;
+
+    void print(std::FILE *out) const;
+    void print_memory(std::FILE *out) const;
+    std::string json() const;
+
+private:
+    ResourceSample sample() const;
+    void accumulate(PhaseTiming &phase, const ResourceSample &from, const ResourceSample &to) const;
+
+    bool is_enabled;
+    std::array<int, 4> perf_fds;
+    std::vector<PhaseTiming> phase_list;
+    std::optional<size_t> current;
+    ResourceSample origin;
+    PhaseTiming overall;
+};
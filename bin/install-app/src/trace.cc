@@ -0,0 +1,174 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <unistd.h>
+#include "json.hh"
+#include "trace.hh"
+
+namespace
+{
+    struct EntryName
+    {
+        uint32_t id = 0;
+        std::string path;
+    };
+
+    struct ThreadBuffer
+    {
+        pid_t tid = 0;
+        std::vector<TraceEvent> events;
+        uint64_t written = 0;
+        std::vector<EntryName> names;
+        uint64_t names_written = 0;
+    };
+
+    std::mutex registry_lock;
+    std::vector<std::unique_ptr<ThreadBuffer>> registry;
+    size_t ring_capacity = 0;
+    uint64_t origin_ns = 0;
+    std::atomic<uint32_t> next_entry = 0;
+
+    ThreadBuffer &local_buffer()
+    {
+        thread_local ThreadBuffer *buffer = nullptr;
+        if (buffer)
+            return *buffer;
+
+        auto owned = std::make_unique<ThreadBuffer>();
+        owned->tid = gettid();
+        owned->events.resize(ring_capacity);
+        owned->names.resize(ring_capacity);
+        buffer = owned.get();
+
+        std::lock_guard lock(registry_lock);
+        registry.push_back(std::move(owned));
+        return *buffer;
+    }
+
+    std::string_view kind_name(TraceKind kind)
+    {
+        switch (kind)
+        {
+            case TraceKind::ENTRY:
+                return "entry";
+            case TraceKind::HEADER:
+                return "read header";
+            case TraceKind::DECODE:
+                return "decode";
+            case TraceKind::WRITE:
+                return "write";
+            case TraceKind::METADATA:
+                return "metadata";
+        }
+
+        return "unknown";
+    }
+
+    /* walks a ring oldest-first, skipping the slots that have already been overwritten */
+    template<typename T, typename F>
+    void for_each_in_ring(const std::vector<T> &ring, uint64_t written, F &&fn)
+    {
+        auto count = std::min<uint64_t>(written, ring.size());
+        for (auto i = written - count; i < written; ++i)
+            fn(ring[i % ring.size()]);
+    }
+}
+
+namespace trace
+{
+    void enable(size_t capacity)
+    {
+        ring_capacity = capacity;
+        origin_ns = now();
+        active.store(true, std::memory_order_relaxed);
+    }
+
+    uint64_t now()
+    {
+        auto since_epoch = std::chrono::steady_clock::now().time_since_epoch();
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch).count());
+    }
+
+    uint32_t begin_entry(std::string_view path)
+    {
+        auto id = next_entry.fetch_add(1, std::memory_order_relaxed);
+        if (!enabled())
+            return id;
+
+        auto &buffer = local_buffer();
+        auto &slot = buffer.names[buffer.names_written++ % buffer.names.size()];
+        slot.id = id;
+        slot.path.assign(path);
+        return id;
+    }
+
+    void record(TraceKind kind, uint64_t start_ns, uint64_t end_ns, uint32_t entry)
+    {
+        if (!enabled())
+            return;
+
+        auto &buffer = local_buffer();
+        buffer.events[buffer.written++ % buffer.events.size()] = TraceEvent{ start_ns, end_ns, entry, kind };
+    }
+
+    bool write(const std::filesystem::path &path)
+    {
+        std::ofstream file(path);
+        if (!file)
+            return false;
+
+        std::lock_guard lock(registry_lock);
+
+        std::unordered_map<uint32_t, std::string_view> names;
+        for (const auto &buffer : registry)
+        {
+            for_each_in_ring(buffer->names, buffer->names_written, [&](const EntryName &name)
+            {
+                names[name.id] = name.path;
+            });
+        }
+
+        auto pid = getpid();
+        bool first = true;
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+        for (const auto &buffer : registry)
+        {
+            file << (first ? "" : ",")
+                 << std::format("{{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":{},\"tid\":{},"
+                                "\"args\":{{\"name\":\"{}\"}}}}",
+                         pid, buffer->tid, buffer->tid == pid ? "main" : std::format("worker {}", buffer->tid));
+            first = false;
+
+            if (buffer->written > buffer->events.size())
+            {
+                file << std::format(",{{\"ph\":\"i\",\"s\":\"t\",\"name\":\"ring overflow\",\"pid\":{},\"tid\":{},"
+                                    "\"ts\":0,\"args\":{{\"dropped\":{}}}}}",
+                        pid, buffer->tid, buffer->written - buffer->events.size());
+            }
+
+            for_each_in_ring(buffer->events, buffer->written, [&](const TraceEvent &event)
+            {
+                auto ts = static_cast<double>(event.start_ns - origin_ns) / 1000.0;
+                auto dur = static_cast<double>(event.end_ns - event.start_ns) / 1000.0;
+                auto name = names.find(event.entry);
+                auto path = name != names.end() ? json_escape(name->second) : std::string();
+
+                file << std::format(",{{\"ph\":\"X\",\"cat\":\"extract\",\"name\":\"{}\",\"pid\":{},\"tid\":{},"
+                                    "\"ts\":{:.3f},\"dur\":{:.3f},\"args\":{{\"entry\":{},\"path\":\"{}\"}}}}",
+                        event.kind == TraceKind::ENTRY && !path.empty() ? path : std::string(kind_name(event.kind)),
+                        pid, buffer->tid, ts, dur, event.entry, path);
+            });
+        }
+
+        file << "]}\n";
+        return static_cast<bool>(file);
+    }
+}
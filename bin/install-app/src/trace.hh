@@ -0,0 +1,65 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+enum class TraceKind : uint8_t
+{
+    ENTRY,
+    HEADER,
+    DECODE,
+    WRITE,
+    METADATA
+};
+
+struct TraceEvent
+{
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint32_t entry;
+    TraceKind kind;
+};
+
+namespace trace
+{
+    inline std::atomic<bool> active = false;
+
+    /* each thread records into its own ring of `capacity` events; the oldest events are overwritten */
+    void enable(size_t capacity = 1 << 16);
+    uint64_t now();
+    uint32_t begin_entry(std::string_view path);
+    void record(TraceKind kind, uint64_t start_ns, uint64_t end_ns, uint32_t entry);
+    bool write(const std::filesystem::path &path);
+
+    inline bool enabled()
+    {
+        return active.load(std::memory_order_relaxed);
+    }
+}
+
+class TraceSpan
+{
+public:
+    TraceSpan(TraceKind kind, uint32_t entry) :
+        kind(kind), entry(entry), start(trace::enabled() ? trace::now() : 0)
+    {
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+    ~TraceSpan()
+    {
+        if (start != 0)
+            trace::record(kind, start, trace::now(), entry);
+    }
+
+private:
+    TraceKind kind;
+    uint32_t entry;
+    uint64_t start;
+};
@@ -0,0 +1,35 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+inline std::string human_bytes(uint64_t bytes)
+{
+    constexpr std::string_view units[] = { "B", "KiB", "MiB", "GiB", "TiB" };
+    auto value = static_cast<double>(bytes);
+    size_t unit = 0;
+
+    while (value >= 1024.0 && unit + 1 < std::size(units))
+    {
+        value /= 1024.0;
+        ++unit;
+    }
+
+    if (unit == 0)
+        return std::format("{} B", bytes);
+    return std::format("{:.1f} {}", value, units[unit]);
+}
+
+inline std::string human_duration(std::chrono::seconds duration)
+{
+    auto total = duration.count();
+    if (total >= 3600)
+        return std::format("{}:{:02}:{:02}", total / 3600, (total / 60) % 60, total % 60);
+    return std::format("{}:{:02}", total / 60, total % 60);
+}
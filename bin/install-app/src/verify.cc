@@ -0,0 +1,172 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <unordered_set>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "verify.hh"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    /* each read is one long sequential request, even on a spinning disk */
+    constexpr size_t READ_SIZE = 1024 * 1024;
+
+    int open_for_hashing(const fs::path &path)
+    {
+        /* O_NOATIME keeps verification from dirtying inodes, but only the owner may ask for it */
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOATIME);
+        if (fd < 0 && errno == EPERM)
+            fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        return fd;
+    }
+
+    std::optional<DriftKind> check_file(const fs::path &root, const ManifestFile &file, std::byte *buffer,
+            const VerifyOptions &options, uint64_t &bytes)
+    {
+        auto path = root / file.path;
+        int fd = open_for_hashing(path);
+        if (fd < 0)
+            return errno == ENOENT ? DriftKind::MISSING : DriftKind::UNREADABLE;
+
+        struct stat st = {};
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        {
+            close(fd);
+            return DriftKind::UNREADABLE;
+        }
+        if (static_cast<uint64_t>(st.st_size) != file.size)
+        {
+            close(fd);
+            return DriftKind::RESIZED;
+        }
+
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        Sha256 hasher;
+        std::optional<DriftKind> result;
+        while (true)
+        {
+            auto n = read(fd, buffer, READ_SIZE);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+            {
+                result = DriftKind::UNREADABLE;
+                break;
+            }
+            if (n == 0)
+                break;
+            hasher.update(std::span<const std::byte>(buffer, static_cast<size_t>(n)));
+            bytes += static_cast<uint64_t>(n);
+        }
+
+        if (!result && hasher.finish() != file.digest)
+            result = DriftKind::MODIFIED;
+
+        if (options.drop_cache)
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+        return result;
+    }
+
+    /* regular files below `root` that the manifest does not know about */
+    void find_added(const Manifest &manifest, std::vector<Drift> &drift)
+    {
+        std::unordered_set<std::string_view> known;
+        known.reserve(manifest.files.size());
+        for (const auto &file : manifest.files)
+            known.insert(file.path);
+
+        std::error_code ec;
+        fs::recursive_directory_iterator it(manifest.root, fs::directory_options::skip_permission_denied, ec);
+        for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+        {
+            if (!it->is_regular_file(ec) || it->is_symlink(ec))
+                continue;
+            auto relative = it->path().lexically_relative(manifest.root).string();
+            if (!known.contains(relative))
+                drift.push_back({ DriftKind::ADDED, std::move(relative) });
+        }
+    }
+}
+
+VerifyReport verify_install(const Manifest &manifest, const VerifyOptions &options)
+{
+    auto start = std::chrono::steady_clock::now();
+    VerifyReport report;
+    const auto &files = manifest.files;
+
+    auto threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>(files.size(), 1)));
+
+    /* workers take the next file as they finish one, so a few huge files do not leave the rest idle */
+    std::vector<std::optional<DriftKind>> results(files.size());
+    std::atomic<size_t> next = 0;
+    std::atomic<uint64_t> bytes = 0;
+    {
+        std::vector<std::jthread> pool;
+        for (unsigned i = 0; i < threads; ++i)
+        {
+            pool.emplace_back([&] {
+                auto buffer = std::make_unique_for_overwrite<std::byte[]>(READ_SIZE);
+
+                uint64_t hashed = 0;
+                for (auto index = next++; index < files.size(); index = next++)
+                    results[index] = check_file(manifest.root, files[index], buffer.get(), options, hashed);
+                bytes += hashed;
+            });
+        }
+    }
+
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        if (results[i])
+            report.drift.push_back({ *results[i], files[i].path });
+    }
+    find_added(manifest, report.drift);
+
+    report.files = files.size();
+    report.bytes = bytes;
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+std::string_view drift_name(DriftKind kind)
+{
+    switch (kind)
+    {
+        case DriftKind::MISSING:
+            return "missing";
+        case DriftKind::MODIFIED:
+            return "modified";
+        case DriftKind::RESIZED:
+            return "resized";
+        case DriftKind::UNREADABLE:
+            return "unreadable";
+        case DriftKind::ADDED:
+            return "added";
+    }
+    return "unknown";
+}
+
+void enter_idle_priority()
+{
+    sched_param param = {};
+    sched_setscheduler(0, SCHED_IDLE, &param);
+
+    /* glibc has no wrapper. class 3 is IOPRIO_CLASS_IDLE, shifted into place by IOPRIO_CLASS_SHIFT */
+    constexpr int IOPRIO_WHO_PROCESS = 1;
+    constexpr int IOPRIO_IDLE = 3 << 13;
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_IDLE);
+}
@@ -0,0 +1,49 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "manifest.hh"
+
+enum class DriftKind
+{
+    MISSING,
+    MODIFIED,
+    RESIZED,
+    UNREADABLE,
+    ADDED
+};
+
+struct Drift
+{
+    DriftKind kind;
+    std::string path;
+};
+
+struct VerifyReport
+{
+    uint64_t files = 0;
+    uint64_t bytes = 0;
+    double seconds = 0;
+    std::vector<Drift> drift;
+};
+
+struct VerifyOptions
+{
+    /* 0 picks one per CPU */
+    unsigned threads = 0;
+    /* drops each file from the page cache once it is hashed, so a background pass does not push out
+     * whatever the machine is actually working on */
+    bool drop_cache = false;
+};
+
+/* re-hashes every file in the manifest from the installed tree on a pool of threads, and lists files
+ * that changed, disappeared or appeared since. the archive is never needed */
+VerifyReport verify_install(const Manifest &manifest, const VerifyOptions &options = {});
+std::string_view drift_name(DriftKind kind);
+
+/* idle CPU scheduling and idle I/O class for this thread and every thread it starts afterwards */
+void enter_idle_priority();
@@ -0,0 +1,82 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <unordered_set>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "warm.hh"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    /* dirty pages are not dropped, so they are written back first. `sync_file_range()` does not commit
+     * the journal the way `fdatasync()` does, which adds up over a whole tree */
+    void write_back(const fs::path &file, unsigned flags, bool drop)
+    {
+        int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+        if (fd < 0)
+            return;
+        sync_file_range(fd, 0, 0, flags);
+        if (drop)
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+namespace cache
+{
+    Warmed warm(const std::vector<fs::path> &files)
+    {
+        Warmed warmed;
+        for (const auto &file : files)
+        {
+            int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                continue;
+
+            struct stat st;
+            if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+                    readahead(fd, 0, static_cast<size_t>(st.st_size)) == 0)
+            {
+                ++warmed.files;
+                warmed.bytes += static_cast<uint64_t>(st.st_size);
+            }
+            close(fd);
+        }
+        return warmed;
+    }
+
+    uint64_t drop_tree(const fs::path &root, const std::vector<fs::path> &keep)
+    {
+        std::unordered_set<std::string> kept;
+        for (const auto &file : keep)
+            kept.insert(file.string());
+
+        std::error_code ec;
+        auto base = fs::canonical(root, ec);
+        if (ec)
+            return 0;
+
+        std::vector<fs::path> files;
+        for (auto it = fs::recursive_directory_iterator(base, ec); !ec && it != fs::recursive_directory_iterator();
+                it.increment(ec))
+        {
+            if (it->is_regular_file(ec) && !it->is_symlink(ec) && !kept.contains(it->path().string()))
+                files.push_back(it->path());
+        }
+
+        /* the first pass only starts writeback, so the disk has every file queued by the time the
+         * second waits on each */
+        for (const auto &file : files)
+            write_back(file, SYNC_FILE_RANGE_WRITE, false);
+        for (const auto &file : files)
+            write_back(file, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER, true);
+        return files.size();
+    }
+
+    void drop(const fs::path &file)
+    {
+        write_back(file, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER, true);
+    }
+}
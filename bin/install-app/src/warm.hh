@@ -0,0 +1,26 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+/* the page cache after an install: what the first launch will read is pulled in ahead of it, and with
+ * `--gentle` everything else the install wrote or read is written back and let go */
+namespace cache
+{
+    struct Warmed
+    {
+        uint64_t files = 0;
+        uint64_t bytes = 0;
+    };
+
+    /* starts reading each file in whole; the kernel carries on in the background */
+    Warmed warm(const std::vector<std::filesystem::path> &files);
+
+    /* writes back and drops every regular file below `root` but those in `keep`, which must be
+     * canonical. returns how many were dropped */
+    uint64_t drop_tree(const std::filesystem::path &root, const std::vector<std::filesystem::path> &keep);
+    void drop(const std::filesystem::path &file);
+}
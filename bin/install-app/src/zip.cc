@@ -0,0 +1,240 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#include <algorithm>
+#include <ctime>
+#include <format>
+#include <sys/stat.h>
+#include "zip.hh"
+
+namespace
+{
+    constexpr uint32_t LOCAL_HEADER = 0x04034b50;
+    constexpr uint32_t CENTRAL_HEADER = 0x02014b50;
+    constexpr uint32_t END_OF_DIRECTORY = 0x06054b50;
+    constexpr uint32_t ZIP64_END_OF_DIRECTORY = 0x06064b50;
+    constexpr uint32_t ZIP64_LOCATOR = 0x07064b50;
+
+    constexpr size_t LOCAL_HEADER_SIZE = 30;
+    constexpr size_t CENTRAL_HEADER_SIZE = 46;
+    constexpr size_t END_OF_DIRECTORY_SIZE = 22;
+    constexpr size_t ZIP64_LOCATOR_SIZE = 20;
+    constexpr size_t ZIP64_END_OF_DIRECTORY_SIZE = 56;
+
+    constexpr uint16_t ZIP64_EXTRA = 0x0001;
+    constexpr uint16_t TIMESTAMP_EXTRA = 0x5455;
+
+    constexpr uint16_t FLAG_ENCRYPTED = 0x0001;
+    constexpr uint16_t FLAG_STRONG_ENCRYPTION = 0x0040;
+    /* the high byte of "version made by" */
+    constexpr uint8_t HOST_UNIX = 3;
+
+    /* little-endian fields at `offset`, which the caller has already checked is in bounds */
+    uint64_t field(std::span<const std::byte> data, size_t offset, size_t width)
+    {
+        uint64_t value = 0;
+        for (size_t i = 0; i < width; ++i)
+            value |= static_cast<uint64_t>(data[offset + i]) << (8 * i);
+        return value;
+    }
+
+    uint16_t u16(std::span<const std::byte> data, size_t offset)
+    {
+        return static_cast<uint16_t>(field(data, offset, 2));
+    }
+
+    uint32_t u32(std::span<const std::byte> data, size_t offset)
+    {
+        return static_cast<uint32_t>(field(data, offset, 4));
+    }
+
+    uint64_t u64(std::span<const std::byte> data, size_t offset)
+    {
+        return field(data, offset, 8);
+    }
+
+    /* MS-DOS date and time, in local time as libarchive reads them */
+    int64_t dos_time(uint16_t date, uint16_t time)
+    {
+        std::tm tm = {};
+        tm.tm_year = ((date >> 9) & 0x7f) + 80;
+        tm.tm_mon = ((date >> 5) & 0x0f) - 1;
+        tm.tm_mday = date & 0x1f;
+        tm.tm_hour = (time >> 11) & 0x1f;
+        tm.tm_min = (time >> 5) & 0x3f;
+        tm.tm_sec = (time << 1) & 0x3e;
+        tm.tm_isdst = -1;
+        return std::mktime(&tm);
+    }
+
+    /* the file type and permissions, from unix attributes when the archive was made on unix and from
+     * the DOS attributes as libarchive maps them otherwise */
+    uint32_t entry_mode(uint16_t made_by, uint32_t external, std::string_view name)
+    {
+        if (made_by >> 8 == HOST_UNIX && (external >> 16) != 0)
+        {
+            auto mode = external >> 16;
+            if ((mode & S_IFMT) == 0)
+                mode |= name.ends_with('/') ? S_IFDIR : S_IFREG;
+            return mode;
+        }
+
+        uint32_t mode = (external & 0x10) || name.ends_with('/') ? (S_IFDIR | 0775) : (S_IFREG | 0664);
+        if (external & 0x01)
+            mode &= ~0222u;
+        return mode;
+    }
+
+    /* fills in the zip64 sizes and offset, and the unix modification time, from the extra fields */
+    std::expected<void, std::string> read_extra(std::span<const std::byte> extra, zip::Entry &entry, bool wide_size,
+            bool wide_compressed, bool wide_offset)
+    {
+        while (extra.size() >= 4)
+        {
+            auto id = u16(extra, 0);
+            size_t length = u16(extra, 2);
+            if (length > extra.size() - 4)
+                break;
+            auto body = extra.subspan(4, length);
+
+            if (id == ZIP64_EXTRA)
+            {
+                /* only the fields that overflowed are present, in this order */
+                size_t at = 0;
+                for (auto [wide, value] : { std::pair{ wide_size, &entry.size },
+                             std::pair{ wide_compressed, &entry.compressed_size },
+                             std::pair{ wide_offset, &entry.header_offset } })
+                {
+                    if (!wide)
+                        continue;
+                    if (at + 8 > body.size())
+                        return std::unexpected("Truncated zip64 extra field");
+                    *value = u64(body, at);
+                    at += 8;
+                }
+                wide_size = wide_compressed = wide_offset = false;
+            }
+            else if (id == TIMESTAMP_EXTRA && body.size() >= 5 && (static_cast<uint8_t>(body[0]) & 0x01))
+            {
+                entry.mtime = static_cast<int32_t>(u32(body, 1));
+            }
+
+            extra = extra.subspan(4 + length);
+        }
+
+        if (wide_size || wide_compressed || wide_offset)
+            return std::unexpected("Missing zip64 extra field");
+        return {};
+    }
+
+    struct Directory
+    {
+        uint64_t entries = 0;
+        uint64_t size = 0;
+        uint64_t offset = 0;
+    };
+
+    std::expected<Directory, std::string> find_directory(std::span<const std::byte> file)
+    {
+        if (file.size() < END_OF_DIRECTORY_SIZE)
+            return std::unexpected("Too small to be a zip file");
+
+        /* the end record is followed by at most a 64 KiB comment */
+        auto earliest = file.size() - std::min<size_t>(file.size(), END_OF_DIRECTORY_SIZE + 0xffff);
+        size_t end = file.size() - END_OF_DIRECTORY_SIZE;
+        while (u32(file, end) != END_OF_DIRECTORY || end + END_OF_DIRECTORY_SIZE + u16(file, end + 20) != file.size())
+        {
+            if (end == earliest)
+                return std::unexpected("No zip end of central directory record");
+            --end;
+        }
+
+        if (u16(file, end + 4) != 0 || u16(file, end + 6) != 0)
+            return std::unexpected("Split zip archives are not supported");
+
+        Directory directory{ u16(file, end + 10), u32(file, end + 12), u32(file, end + 16) };
+        if (directory.entries == 0xffff || directory.size == 0xffffffff || directory.offset == 0xffffffff)
+        {
+            if (end < ZIP64_LOCATOR_SIZE || u32(file, end - ZIP64_LOCATOR_SIZE) != ZIP64_LOCATOR)
+                return std::unexpected("No zip64 end of central directory locator");
+            auto record = u64(file, end - ZIP64_LOCATOR_SIZE + 8);
+            if (file.size() < ZIP64_END_OF_DIRECTORY_SIZE || record > file.size() - ZIP64_END_OF_DIRECTORY_SIZE ||
+                    u32(file, record) != ZIP64_END_OF_DIRECTORY)
+                return std::unexpected("No zip64 end of central directory record");
+            directory = { u64(file, record + 32), u64(file, record + 40), u64(file, record + 48) };
+        }
+
+        if (directory.offset > file.size() || directory.size > file.size() - directory.offset)
+            return std::unexpected("Zip central directory is out of bounds");
+        return directory;
+    }
+}
+
+namespace zip
+{
+    std::expected<std::vector<Entry>, std::string> read_directory(std::span<const std::byte> file)
+    {
+        auto directory = find_directory(file);
+        if (!directory)
+            return std::unexpected(directory.error());
+
+        auto records = file.subspan(directory->offset, directory->size);
+        std::vector<Entry> entries;
+        entries.reserve(std::min<uint64_t>(directory->entries, records.size() / CENTRAL_HEADER_SIZE));
+
+        size_t at = 0;
+        for (uint64_t i = 0; i < directory->entries; ++i)
+        {
+            if (records.size() - at < CENTRAL_HEADER_SIZE || u32(records, at) != CENTRAL_HEADER)
+                return std::unexpected("Damaged zip central directory");
+
+            auto made_by = u16(records, at + 4);
+            auto flags = u16(records, at + 8);
+            size_t name_length = u16(records, at + 28);
+            size_t extra_length = u16(records, at + 30);
+            size_t comment_length = u16(records, at + 32);
+            if (records.size() - at - CENTRAL_HEADER_SIZE < name_length + extra_length + comment_length)
+                return std::unexpected("Damaged zip central directory");
+
+            Entry entry;
+            entry.method = u16(records, at + 10);
+            if (flags & (FLAG_ENCRYPTED | FLAG_STRONG_ENCRYPTION))
+                return std::unexpected("Encrypted zip entries are not supported");
+            if (entry.method != STORED && entry.method != DEFLATED)
+                return std::unexpected(std::format("Zip compression method {} is not supported", entry.method));
+
+            entry.crc = u32(records, at + 16);
+            entry.compressed_size = u32(records, at + 20);
+            entry.size = u32(records, at + 24);
+            entry.header_offset = u32(records, at + 42);
+            entry.name = std::string_view(reinterpret_cast<const char *>(records.data() + at + CENTRAL_HEADER_SIZE),
+                    name_length);
+            entry.mode = entry_mode(made_by, u32(records, at + 38), entry.name);
+            entry.mtime = dos_time(u16(records, at + 14), u16(records, at + 12));
+
+            auto extra = records.subspan(at + CENTRAL_HEADER_SIZE + name_length, extra_length);
+            auto read = read_extra(extra, entry, entry.size == 0xffffffff, entry.compressed_size == 0xffffffff,
+                    entry.header_offset == 0xffffffff);
+            if (!read)
+                return std::unexpected(read.error());
+
+            entries.push_back(entry);
+            at += CENTRAL_HEADER_SIZE + name_length + extra_length + comment_length;
+        }
+
+        return entries;
+    }
+
+    std::expected<std::span<const std::byte>, std::string> entry_data(std::span<const std::byte> file,
+            const Entry &entry)
+    {
+        auto offset = entry.header_offset;
+        if (offset > file.size() || file.size() - offset < LOCAL_HEADER_SIZE || u32(file, offset) != LOCAL_HEADER)
+            return std::unexpected("Damaged zip local header");
+
+        /* the local header's own name and extra field may differ in length from the central one's */
+        auto start = offset + LOCAL_HEADER_SIZE + u16(file, offset + 26) + u16(file, offset + 28);
+        if (start > file.size() || file.size() - start < entry.compressed_size)
+            return std::unexpected("Zip entry data is out of bounds");
+        return file.subspan(start, entry.compressed_size);
+    }
+}
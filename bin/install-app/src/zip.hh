@@ -0,0 +1,40 @@
+/* this project is licensed under the MIT license. see `LICENSE.txt` for more details */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* reads a zip file that is entirely in memory through its central directory, the way zip is meant to
+ * be read, instead of scanning local headers front to back. anything this reader does not handle
+ * (encryption, methods other than store and deflate, archives split over several disks) makes
+ * `read_directory()` fail, so that libarchive can take the file instead */
+namespace zip
+{
+    constexpr uint16_t STORED = 0;
+    constexpr uint16_t DEFLATED = 8;
+
+    struct Entry
+    {
+        /* points into the file */
+        std::string_view name;
+        uint16_t method = STORED;
+        uint32_t crc = 0;
+        uint64_t compressed_size = 0;
+        uint64_t size = 0;
+        uint64_t header_offset = 0;
+        /* st_mode bits, file type included */
+        uint32_t mode = 0;
+        int64_t mtime = 0;
+    };
+
+    std::expected<std::vector<Entry>, std::string> read_directory(std::span<const std::byte> file);
+    /* the entry's compressed data, found through its local header */
+    std::expected<std::span<const std::byte>, std::string> entry_data(std::span<const std::byte> file,
+            const Entry &entry);
+}